@@ -0,0 +1,94 @@
+#ifndef __AUTOSAVE_H__
+#define __AUTOSAVE_H__
+
+#include <stdint.h> /* int32_t, int64_t */
+#include <time.h> /* time_t */
+#include <pthread.h> /* pthread_t, pthread_mutex_t, pthread_cond_t */
+#include "minesweeper.h"
+
+/* Il salvataggio automatico scrive periodicamente lo stato completo della
+ * partita in un thread separato. Il thread dell'interfaccia si limita a
+ * copiare il campo in uno dei due buffer (msw_autosave_submit); il thread di
+ * salvataggio scrive l'altro buffer in un file temporaneo, ne forza la
+ * scrittura su disco e lo rinomina atomicamente sul file di salvataggio, così
+ * che il file contenga sempre uno stato completo.
+ */
+
+/* Costante per l'identificazione di un salvataggio automatico. */
+#define MSW_AUTOSAVE_MAGIC "MSWSAVE2"
+
+/* Costante per l'intervallo minimo tra due salvataggi non forzati, in
+ * secondi.
+ */
+#define MSW_AUTOSAVE_INTERVAL 5
+
+/* La struttura che rappresenta l'intestazione di un salvataggio automatico,
+ * seguita dagli indici delle celle contenenti una mina (mine_cnt interi a 64
+ * bit) e dal valore di visited di ogni cella, in ordine di riga (interi a 32
+ * bit). I numeri sono memorizzati nell'ordine dei byte della macchina;
+ * reserved è sempre 0.
+ */
+struct msw_autosave_header_struct {
+    char magic[8];
+    int32_t width, height, instance, lives;
+    int32_t undo_cnt, reserved;
+    int64_t mine_cnt;
+};
+
+/* La struttura che rappresenta un salvataggio automatico.
+ *
+ * thread, lock, cond
+ *     Il thread di salvataggio, il mutex che protegge i campi seguenti e la
+ *     condizione su cui il thread attende una nuova copia.
+ *
+ * path
+ *     Il percorso del file di salvataggio.
+ *
+ * pending, pending_lives, work, work_lives
+ *     L'ultima copia del campo (valida se submitted > taken) con il numero di
+ *     vite, e la copia che il thread sta scrivendo. Le due copie vengono
+ *     scambiate quando il thread prende in carico una copia.
+ *
+ * submitted, taken
+ *     Il numero di copie consegnate e il numero della copia presa in carico.
+ *
+ * last
+ *     L'istante dell'ultima copia.
+ *
+ * skipped, skipped_lives
+ *     Vero se una copia non forzata è stata rimandata perché troppo vicina
+ *     alla precedente, e il numero di vite di quella copia: il campo viene
+ *     copiato dalla prossima msw_autosave_tick trascorso l'intervallo.
+ *
+ * quit, failed
+ *     Vero se il thread deve terminare (dopo aver scritto l'ultima copia) e
+ *     vero se l'ultima scrittura non è riuscita.
+ */
+struct msw_autosave_struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char *path;
+    msw_field pending, work;
+    int pending_lives, work_lives;
+    unsigned long submitted, taken;
+    time_t last;
+    int skipped, skipped_lives;
+    int quit, failed;
+};
+
+typedef struct msw_autosave_struct *msw_autosave;
+
+int msw_autosave_create(msw_autosave*, const char*);
+
+void msw_autosave_destroy(msw_autosave*);
+
+int msw_autosave_submit(msw_autosave, msw_field, int, int);
+
+int msw_autosave_tick(msw_autosave, msw_field);
+
+int msw_autosave_failed(msw_autosave);
+
+int msw_autosave_load(msw_field*, const char*, int*);
+
+#endif /* __AUTOSAVE_H__ */
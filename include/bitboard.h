@@ -0,0 +1,84 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <stdint.h> /* uint64_t */
+#include "minesweeper.h"
+
+/* Il motore a bitboard è una versione specializzata del campo per gli schemi
+ * classici, in cui ogni riga della griglia è rappresentata da una maschera a
+ * 64 bit (il bit x corrisponde alla colonna x). La visita, il riempimento
+ * delle celle vuote e la verifica della vittoria sono operazioni bit a bit
+ * sulle righe, con la stessa semantica delle funzioni msw_* corrispondenti.
+ */
+
+/* Costanti per le dimensioni massime di un campo a bitboard. */
+#define MSW_BB_MAX_WIDTH 64
+#define MSW_BB_MAX_HEIGHT 32
+
+/* Costanti per gli schemi classici (larghezza, altezza, mine), da passare
+ * direttamente a msw_bb_create_random.
+ */
+#define MSW_BB_BEGINNER 9, 9, 10
+#define MSW_BB_INTERMEDIATE 16, 16, 40
+#define MSW_BB_EXPERT 30, 16, 99
+
+/* Costante per la dimensione del registro delle visite: ogni selezione
+ * registra le righe modificate seguite da una parola di intestazione e le
+ * righe modificate in totale non superano le celle del campo.
+ */
+#define MSW_BB_LOG_SIZE (2 * MSW_BB_MAX_WIDTH * MSW_BB_MAX_HEIGHT)
+
+/* La struttura che rappresenta un campo a bitboard.
+ *
+ * mine, zero, visited, flag
+ *     Le maschere delle righe delle celle contenenti una mina, delle celle
+ *     vuote (senza mine adiacenti), delle celle visitate e delle celle
+ *     marcate con una bandiera.
+ *
+ * row_mask
+ *     La maschera delle colonne esistenti di una riga.
+ *
+ * width, height, mine_cnt, flag_cnt, nmnv_cnt, instance, undo_cnt
+ *     Gli stessi campi di msw_field_struct.
+ *
+ * log_len, log
+ *     Il registro delle visite, usato da msw_bb_undo: per ogni istanza
+ *     contiene le righe delle celle visitate seguite da un'intestazione con
+ *     la prima riga (8 bit meno significativi) e il numero di righe.
+ */
+struct msw_bb_struct {
+    uint64_t mine[MSW_BB_MAX_HEIGHT], zero[MSW_BB_MAX_HEIGHT];
+    uint64_t visited[MSW_BB_MAX_HEIGHT], flag[MSW_BB_MAX_HEIGHT];
+    uint64_t row_mask;
+    int width, height, mine_cnt, flag_cnt, nmnv_cnt, instance, undo_cnt;
+    int log_len;
+    uint64_t log[MSW_BB_LOG_SIZE];
+};
+
+typedef struct msw_bb_struct *msw_bb;
+
+int msw_bb_create(msw_bb, int, int);
+
+int msw_bb_create_random(msw_bb, int, int, int);
+
+int msw_bb_cell_exists(msw_bb, int, int);
+
+int msw_bb_mine_cell(msw_bb, int, int);
+
+int msw_bb_get_content(msw_bb, int, int);
+
+int msw_bb_get_visited(msw_bb, int, int);
+
+int msw_bb_mark_cell(msw_bb, int, int);
+
+void msw_bb_mark_mine_cells(msw_bb);
+
+int msw_bb_select_cell(msw_bb, int, int);
+
+int msw_bb_undo(msw_bb, int);
+
+int msw_bb_undo_incremental(msw_bb);
+
+int msw_bb_to_field(msw_bb, msw_field*);
+
+#endif /* __BITBOARD_H__ */
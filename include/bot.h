@@ -0,0 +1,83 @@
+#ifndef __BOT_H__
+#define __BOT_H__
+
+/* Un giocatore automatico (bot) è una libreria condivisa, caricata con
+ * dlopen, che esporta le funzioni seguenti con i nomi indicati:
+ *
+ * const char *msw_bot_name(void)  (facoltativa)
+ *     Il nome del bot, usato nei resoconti al posto del percorso.
+ *
+ * void *msw_bot_start(const struct msw_bot_view_struct *view)  (facoltativa)
+ *     Chiamata all'inizio di ogni partita; il valore restituito viene passato
+ *     alle chiamate seguenti della stessa partita.
+ *
+ * int msw_bot_move(void *state, const struct msw_bot_view_struct *view,
+ *                  struct msw_bot_action_struct *action)
+ *     Chiamata ad ogni mossa: compila *action e restituisce vero, oppure
+ *     restituisce falso per abbandonare la partita.
+ *
+ * void msw_bot_end(void *state)  (facoltativa)
+ *     Chiamata alla fine di ogni partita, per liberare lo stato.
+ *
+ * Il bot vede il campo solamente attraverso la vista, che contiene lo stato
+ * visibile di ogni cella ed è in sola lettura: durante le chiamate le sue
+ * pagine sono protette, e ogni scrittura termina la partita. Questo file
+ * non dipende dal resto del gioco, così che un bot possa essere compilato
+ * separatamente.
+ */
+
+/* Nomi dei simboli esportati da un bot. */
+#define MSW_BOT_NAME "msw_bot_name"
+#define MSW_BOT_START "msw_bot_start"
+#define MSW_BOT_MOVE "msw_bot_move"
+#define MSW_BOT_END "msw_bot_end"
+
+/* Costanti per lo stato visibile di una cella, oltre ai numeri [0..8] delle
+ * celle visitate (gli stessi valori di STATE_HIDDEN e STATE_FLAG).
+ */
+#define BOT_HIDDEN 9
+#define BOT_FLAG 10
+
+/* Costanti per il tipo di una mossa. */
+#define BOT_REVEAL 1
+#define BOT_MARK 2
+#define BOT_CHORD 3
+
+/* La struttura che rappresenta la vista del campo passata a un bot.
+ *
+ * width, height
+ *     Le dimensioni del campo.
+ *
+ * mine_cnt, flag_cnt
+ *     Il numero totale di mine e il numero di celle marcate con una bandiera.
+ *
+ * cells
+ *     Lo stato visibile di ogni cella, in ordine di riga: quello della cella
+ *     (x, y) è cells[y * width + x].
+ */
+struct msw_bot_view_struct {
+    int width, height;
+    long mine_cnt, flag_cnt;
+    const unsigned char *cells;
+};
+
+/* La struttura che rappresenta una mossa di un bot.
+ *
+ * type
+ *     Il tipo della mossa: BOT_REVEAL per visitare la cella, BOT_MARK per
+ *     mettere o togliere una bandiera, BOT_CHORD per visitare le celle
+ *     adiacenti a un numero le cui bandiere sono complete.
+ *
+ * x, y
+ *     La cella su cui viene eseguita la mossa.
+ */
+struct msw_bot_action_struct {
+    int type, x, y;
+};
+
+typedef const char* (*msw_bot_name_fn)(void);
+typedef void* (*msw_bot_start_fn)(const struct msw_bot_view_struct*);
+typedef int (*msw_bot_move_fn)(void*, const struct msw_bot_view_struct*, struct msw_bot_action_struct*);
+typedef void (*msw_bot_end_fn)(void*);
+
+#endif /* __BOT_H__ */
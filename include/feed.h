@@ -0,0 +1,103 @@
+#ifndef __FEED_H__
+#define __FEED_H__
+
+#include <stdint.h> /* int32_t, uint64_t */
+#include <stddef.h> /* size_t */
+#include "minesweeper.h"
+
+/* Il canale degli spettatori trasmette una partita in corso ad altri processi
+ * della stessa macchina (spettatori, registratori) attraverso un segmento di
+ * memoria condivisa POSIX, con un solo scrittore e un numero qualsiasi di
+ * lettori. Lo scrittore (il processo di gioco) pubblica le modifiche di ogni
+ * mossa, nel formato di msw_apply (MSW_DELTA), in un buffer circolare, e le
+ * riporta sul fotogramma chiave, lo stato visibile di tutte le celle,
+ * protetto da un seqlock. Lo scrittore non attende mai i lettori: un lettore
+ * troppo lento viene doppiato (le modifiche che non ha ancora letto vengono
+ * sovrascritte), se ne accorge confrontando la sua posizione con quella dello
+ * scrittore e riparte dal fotogramma chiave. Il fotogramma chiave non viene
+ * scritto periodicamente, ma aggiornato ad ogni mossa con le sole celle
+ * modificate: il suo costo resta proporzionale alle modifiche e un lettore
+ * che riparte non deve attendere il prossimo fotogramma.
+ */
+
+/* Costanti per l'identificazione del segmento e per il nome predefinito. */
+#define MSW_FEED_MAGIC "MSWFEED1"
+#define MSW_FEED_NAME "/msw-feed"
+
+/* Costante per il numero di modifiche contenute nel buffer circolare (una
+ * potenza di 2). Un lettore viene considerato doppiato quando ha più di
+ * MSW_FEED_RING / 2 modifiche da leggere, poiché la metà restante del buffer
+ * può essere in corso di scrittura.
+ */
+#define MSW_FEED_RING 65536
+
+/* Costanti restituite da msw_feed_follow. */
+#define FEED_LAPPED -1
+#define FEED_CLOSED -2
+
+/* La struttura che rappresenta l'intestazione del segmento, seguita dal
+ * buffer circolare (MSW_FEED_RING interi a 64 bit) e dal fotogramma chiave
+ * (lo stato visibile di ogni cella, un byte per cella, in ordine di riga).
+ *
+ * head
+ *     Il numero di modifiche pubblicate: la modifica numero i si trova nella
+ *     posizione i % MSW_FEED_RING del buffer. Le modifiche di una mossa che
+ *     non entrano in mezzo buffer (o che msw_apply non ha potuto raccogliere
+ *     tutte) non vengono copiate: head avanza di un intero giro, così che
+ *     tutti i lettori si accorgano di essere stati doppiati.
+ *
+ * key_seq, key_head
+ *     Il contatore del seqlock del fotogramma chiave (dispari durante la
+ *     scrittura, 0 finché il segmento non è pronto) e il valore di head a cui
+ *     il fotogramma corrisponde.
+ *
+ * closed
+ *     Vero se la partita è terminata e il segmento sta per essere rimosso.
+ */
+struct msw_feed_header_struct {
+    char magic[8];
+    int32_t width, height;
+    uint64_t head;
+    uint64_t key_seq, key_head;
+    int32_t closed;
+};
+
+/* La struttura che rappresenta un capo del canale.
+ *
+ * header, ring, key, size
+ *     L'intestazione, il buffer circolare e il fotogramma chiave mappati, e
+ *     la dimensione della mappatura.
+ *
+ * name, writer
+ *     Il nome del segmento e vero per il capo dello scrittore, che rimuove il
+ *     segmento alla distruzione.
+ *
+ * position
+ *     Per lo scrittore, il numero di modifiche pubblicate; per un lettore, il
+ *     numero della prossima modifica da leggere.
+ */
+struct msw_feed_struct {
+    struct msw_feed_header_struct *header;
+    uint64_t *ring;
+    unsigned char *key;
+    size_t size;
+    char *name;
+    int writer;
+    uint64_t position;
+};
+
+typedef struct msw_feed_struct *msw_feed;
+
+int msw_feed_create(msw_feed*, const char*, msw_field);
+
+int msw_feed_attach(msw_feed*, const char*);
+
+void msw_feed_destroy(msw_feed*);
+
+void msw_feed_publish(msw_feed, msw_field, const struct msw_delta_buffer_struct*);
+
+int msw_feed_sync(msw_feed, msw_field*);
+
+long msw_feed_follow(msw_feed, msw_field, long*);
+
+#endif /* __FEED_H__ */
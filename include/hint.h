@@ -0,0 +1,118 @@
+#ifndef __HINT_H__
+#define __HINT_H__
+
+#include <pthread.h> /* pthread_t, pthread_mutex_t, pthread_cond_t */
+#include "minesweeper.h"
+#include "solver.h"
+
+/* Il suggeritore analizza il campo in un thread separato, mentre il giocatore
+ * decide la prossima mossa. Il thread dell'interfaccia consegna una copia del
+ * campo ad ogni modifica (msw_hint_submit) e il thread di analisi lavora
+ * solamente sulla propria copia, così che i due non accedano mai alla stessa
+ * griglia. Ogni consegna rende obsoleta l'analisi in corso, che viene
+ * interrotta al primo controllo e ricominciata sulla copia più recente.
+ * Ogni consegna copia solamente le righe modificate dalle mosse, ricavate dal
+ * loro buffer delle modifiche.
+ */
+
+/* Costanti per il tipo di suggerimento. */
+#define HINT_NONE 0
+#define HINT_SAFE 1
+#define HINT_MINE 2
+#define HINT_GUESS 3
+
+/* Costanti per i limiti del campionamento quando nessuna cella è
+ * determinata: il numero di schemi da contare e il tempo massimo in
+ * millisecondi.
+ */
+#define MSW_HINT_SAMPLES 20000
+#define MSW_HINT_SAMPLE_MS 250
+
+/* La struttura che rappresenta il risultato di un'analisi.
+ *
+ * kind
+ *     Il tipo di suggerimento: HINT_SAFE se la cella (x, y) è sicuramente
+ *     priva di mine, HINT_MINE se contiene sicuramente una mina e non è
+ *     marcata, HINT_GUESS se nessuna cella è determinata e (x, y) è quella con
+ *     il rischio stimato minore, HINT_NONE se non ci sono celle da suggerire.
+ *
+ * x, y
+ *     La cella suggerita.
+ *
+ * safe_cnt, mine_cnt
+ *     Il numero di celle non visitate sicuramente prive di mine e di celle
+ *     non visitate contenenti sicuramente una mina.
+ *
+ * risk
+ *     La probabilità stimata che la cella suggerita contenga una mina.
+ *
+ * error
+ *     Il margine di errore di risk se è stata stimata con il campionatore,
+ *     altrimenti -1.
+ */
+struct msw_hint_result_struct {
+    int kind, x, y;
+    long safe_cnt, mine_cnt;
+    double risk, error;
+};
+
+/* La struttura che rappresenta un suggeritore.
+ *
+ * thread, lock, cond
+ *     Il thread di analisi, il mutex che protegge i campi seguenti e la
+ *     condizione su cui il thread attende una nuova consegna.
+ *
+ * pending, work
+ *     L'ultima copia consegnata (valida se submitted > taken) e la copia su
+ *     cui lavora il thread di analisi. Le due copie vengono scambiate, senza
+ *     allocazioni, quando il thread prende in carico una consegna.
+ *
+ * pending_rows, work_rows, row_cnt
+ *     Per ognuna delle due copie, le righe del campo modificate dopo il suo
+ *     ultimo aggiornamento (scambiate insieme alle copie), e il numero di
+ *     righe dei due array.
+ *
+ * pending_deltas, work_deltas
+ *     Le modifiche del campo accumulate dalle consegne dopo l'ultima presa in
+ *     carico e quelle della copia di lavoro (scambiate insieme alle copie),
+ *     con cui il risolutore esamina solamente le celle modificate.
+ *
+ * submitted, taken
+ *     Il numero di consegne e il numero della consegna presa in carico.
+ *
+ * solver
+ *     Il risolutore usato dal thread di analisi.
+ *
+ * result, result_gen
+ *     L'ultimo risultato completo e il numero della consegna a cui si
+ *     riferisce.
+ *
+ * quit
+ *     Vero se il thread di analisi deve terminare.
+ */
+struct msw_hint_struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    msw_field pending, work;
+    unsigned char *pending_rows, *work_rows;
+    int row_cnt;
+    struct msw_delta_buffer_struct pending_deltas, work_deltas;
+    unsigned long submitted, taken;
+    msw_solver solver;
+    struct msw_hint_result_struct result;
+    unsigned long result_gen;
+    int quit;
+};
+
+typedef struct msw_hint_struct *msw_hint;
+
+int msw_hint_create(msw_hint*);
+
+void msw_hint_destroy(msw_hint*);
+
+int msw_hint_submit(msw_hint, msw_field, struct msw_delta_buffer_struct*);
+
+int msw_hint_get(msw_hint, struct msw_hint_result_struct*);
+
+#endif /* __HINT_H__ */
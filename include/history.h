@@ -0,0 +1,99 @@
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+#include <stdint.h> /* uint64_t */
+#include "minesweeper.h"
+
+/* La cronologia registra tutte le modifiche dello stato visibile di una
+ * partita, mossa per mossa, a partire dalle modifiche restituite da msw_apply,
+ * e permette di rivederla spostandosi in avanti e indietro su un campo di
+ * sola visualizzazione (view), senza toccare il campo della partita. Le mosse
+ * sono numerate in ordine di esecuzione (gli annullamenti sono mosse anche
+ * loro), poiché dopo un annullamento le istanze del campo si ripetono.
+ * Ogni modifica registra lo stato precedente e quello nuovo della cella, così
+ * che possa essere applicata in entrambe le direzioni; periodicamente viene
+ * salvato un fotogramma chiave (lo stato visibile di tutte le celle, 4 bit
+ * per cella), da cui si riparte quando è più vicino alla mossa cercata della
+ * posizione corrente. Il ripristino di un fotogramma scrive tutte le celle:
+ * uno spostamento costa quindi al più quanto le modifiche tra la mossa
+ * cercata e il fotogramma chiave più vicino, più la dimensione del campo.
+ */
+
+/* Costante per la frequenza dei fotogrammi chiave: un nuovo fotogramma chiave
+ * viene salvato quando le modifiche registrate dopo il precedente superano
+ * width * height / MSW_HISTORY_KEY_RATIO.
+ */
+#define MSW_HISTORY_KEY_RATIO 4
+
+/* Una modifica registrata occupa un intero a 64 bit: la posizione della
+ * cella nei bit alti, lo stato precedente nei bit 4-7 e quello nuovo nei
+ * bit 0-3.
+ */
+#define MSW_HISTORY_ENTRY(index, from, to) (((uint64_t) (index) << 8) | ((uint64_t) (from) << 4) | (uint64_t) (to))
+#define MSW_HISTORY_INDEX(entry) ((long) ((entry) >> 8))
+#define MSW_HISTORY_FROM(entry) ((int) (((entry) >> 4) & 15))
+#define MSW_HISTORY_TO(entry) ((int) ((entry) & 15))
+
+/* La struttura che rappresenta un fotogramma chiave: la mossa dopo la quale
+ * è stato salvato e lo stato visibile delle celle, due celle per byte.
+ */
+struct msw_history_key_struct {
+    long step;
+    unsigned char *states;
+};
+
+/* La struttura che rappresenta una cronologia.
+ *
+ * width, height
+ *     Le dimensioni del campo.
+ *
+ * log, log_cnt, log_cap
+ *     Le modifiche registrate (MSW_HISTORY_ENTRY), il loro numero e la
+ *     capacità dell'array.
+ *
+ * steps, step_cnt, step_cap
+ *     Per ogni mossa, la posizione in log dopo la sua ultima modifica: le
+ *     modifiche della mossa s (da 1 a step_cnt) sono quelle tra steps[s - 1]
+ *     e steps[s]; steps[0] vale 0 e corrisponde allo stato iniziale.
+ *
+ * keys, key_cnt, key_cap
+ *     I fotogrammi chiave, in ordine di mossa; il primo corrisponde allo stato
+ *     iniziale.
+ *
+ * head
+ *     Lo stato visibile di ogni cella dopo l'ultima mossa registrata (un byte
+ *     per cella).
+ *
+ * resync
+ *     Vero se una registrazione non è riuscita: la successiva confronta
+ *     l'intero campo con head anziché usare le modifiche di msw_apply.
+ *
+ * view, position
+ *     Il campo di sola visualizzazione e la mossa che mostra. Le celle
+ *     visitate della vista hanno istanza 1.
+ */
+struct msw_history_struct {
+    int width, height;
+    uint64_t *log;
+    long log_cnt, log_cap;
+    long *steps;
+    long step_cnt, step_cap;
+    struct msw_history_key_struct *keys;
+    long key_cnt, key_cap;
+    unsigned char *head;
+    int resync;
+    msw_field view;
+    long position;
+};
+
+typedef struct msw_history_struct *msw_history;
+
+int msw_history_create(msw_history*, msw_field);
+
+void msw_history_destroy(msw_history*);
+
+int msw_history_record(msw_history, msw_field, const struct msw_delta_buffer_struct*);
+
+void msw_history_seek(msw_history, long);
+
+#endif /* __HISTORY_H__ */
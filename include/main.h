@@ -6,6 +6,16 @@
  */
 #define SAVE_FILE_NAME "msw-save"
 
-void game();
+/* Costante che indica il nome del file usato per il salvataggio automatico
+ * della partita in corso.
+ */
+#define AUTOSAVE_FILE_NAME "msw-autosave"
+
+/* Costante per il tempo massimo, in millisecondi, dedicato all'apertura di
+ * una selezione tra un disegno del campo e l'altro.
+ */
+#define REVEAL_SLICE_MS 15
+
+void game(int);
 
 #endif /* __MAIN_H__ */
@@ -2,6 +2,7 @@
 #define __MINESWEEPER_H__
 
 #include <stdio.h> /* Gestione di files */
+#include <stdint.h> /* uint64_t */
 
 /* Costanti assegnabili a msw_cell_struct.content. */
 #define CONTENT_EMPTY 0
@@ -16,6 +17,52 @@
 #define RESULT_DEFEAT 2
 #define RESULT_VICTORY 3
 
+/* Costanti per lo stato visibile di una cella, oltre ai numeri [0..8] delle
+ * celle visitate non contenenti una mina.
+ */
+#define STATE_HIDDEN 9
+#define STATE_FLAG 10
+#define STATE_MINE 11
+
+/* Costante per il numero di simmetrie del campo (rotazioni e riflessioni). */
+#define SYMMETRY_CNT 8
+
+/* Costanti assegnabili a msw_field_struct.storage. */
+#define STORAGE_ALLOC 1
+#define STORAGE_BUFFER 2
+#define STORAGE_FORK 3
+#define STORAGE_MAP 4
+
+/* Costanti per la politica di piazzamento differito delle mine
+ * (msw_field_struct.lazy).
+ */
+#define LAZY_NONE 0
+#define LAZY_UNIFORM 1
+#define LAZY_PLAYER 2
+#define LAZY_HOUSE 3
+
+/* Costante per la dimensione dei blocchi letti da msw_create_from_stream. */
+#define MSW_READ_BLOCK 65536
+
+/* Costanti per l'espansione parallela delle aperture: il numero di celle
+ * visitate sequenzialmente prima di passare a più thread, il numero massimo
+ * di thread e il numero di celle visitate da un thread tra due controlli dei
+ * thread senza lavoro.
+ */
+#define MSW_PARALLEL_THRESHOLD 65536
+#define MSW_PARALLEL_MAX 16
+#define MSW_PARALLEL_SLICE 4096
+
+/* Costante per il numero massimo di celle visitate da un passo di
+ * msw_reveal_step quando il chiamante non pone un limite proprio.
+ */
+#define MSW_REVEAL_SLICE 16384
+
+/* Costante per il numero di righe delle strisce in cui msw_create_seeded
+ * divide il campo.
+ */
+#define MSW_STRIPE_ROWS 64
+
 /* La struttura che rappresenta una cella.
  *
  * content
@@ -38,6 +85,61 @@ struct msw_cell_struct {
 
 typedef struct msw_cell_struct *msw_cell, **msw_grid;
 
+/* Costanti per il tipo di un'azione eseguita da msw_apply. */
+#define MSW_ACTION_SELECT 1
+#define MSW_ACTION_MARK 2
+#define MSW_ACTION_UNDO 3
+#define MSW_ACTION_CHORD 4
+#define MSW_ACTION_FLAG_FORCED 5
+#define MSW_ACTION_MARK_MINES 6
+#define MSW_ACTION_SHOW_MINES 7
+
+/* La struttura che rappresenta un'azione eseguita da msw_apply.
+ *
+ * type, x, y
+ *     Il tipo dell'azione e la cella su cui viene eseguita; per
+ *     MSW_ACTION_UNDO, x è il numero di mosse da annullare e y è ignorato, per
+ *     MSW_ACTION_MARK_MINES e MSW_ACTION_SHOW_MINES entrambi sono ignorati.
+ *
+ * result, delta_end
+ *     Compilati da msw_apply: il valore restituito dalla funzione
+ *     corrispondente (msw_select_cell, msw_mark_cell, msw_undo,
+ *     msw_chord_cell o msw_flag_forced; 1 per msw_mark_mine_cells e
+ *     msw_show_mine_cells; 0 per un tipo sconosciuto) e il numero di
+ *     modifiche nel buffer dopo l'azione, così che le modifiche dell'azione i
+ *     siano quelle tra delta_end dell'azione i - 1 (0 per la prima) e il
+ *     proprio.
+ */
+struct msw_action_struct {
+    int type, x, y;
+    int result;
+    long delta_end;
+};
+
+/* Una modifica registrata da msw_apply occupa un intero a 64 bit: la
+ * posizione y * width + x della cella nei bit alti e il nuovo stato visibile
+ * (come restituito da msw_cell_state) nei 4 bit bassi.
+ */
+#define MSW_DELTA(index, state) (((uint64_t) (index) << 4) | (uint64_t) (state))
+#define MSW_DELTA_INDEX(delta) ((long) ((delta) >> 4))
+#define MSW_DELTA_STATE(delta) ((int) ((delta) & 15))
+
+/* La struttura che rappresenta il buffer, fornito dal chiamante, in cui
+ * msw_apply registra le modifiche dello stato visibile del campo.
+ *
+ * deltas, cap
+ *     L'array delle modifiche (MSW_DELTA) e la sua capacità.
+ *
+ * cnt, overflow
+ *     Compilati da msw_apply: il numero di modifiche registrate e vero se
+ *     almeno una modifica non è stata registrata per mancanza di spazio.
+ */
+struct msw_delta_buffer_struct {
+    uint64_t *deltas;
+    long cap, cnt;
+    int overflow;
+};
+
 /* La struttura che rappresenta un campo.
  *
  * grid
@@ -50,7 +152,9 @@ typedef struct msw_cell_struct *msw_cell, **msw_grid;
  *     L'altezza della griglia.
  *
  * mine_cnt
- *     Il numero di celle contenenti una mina presenti nel campo.
+ *     Il numero di celle contenenti una mina presenti nel campo; per i campi
+ *     con piazzamento differito, solo quelle già piazzate (il totale è dato
+ *     da msw_mine_total).
  *
  * flag_cnt
  *     Il numero di celle segnate con una bandiera presenti nel campo.
@@ -66,25 +170,165 @@ typedef struct msw_cell_struct *msw_cell, **msw_grid;
  *
  * undo_cnt
  *     Il numero di annullamenti effettuati.
+ *
+ * storage
+ *     La provenienza della memoria del campo: STORAGE_ALLOC se allocata dal
+ *     motore (con le funzioni impostate da msw_set_allocator), STORAGE_BUFFER
+ *     se fornita dal chiamante con msw_create_in_buffer, STORAGE_FORK se il
+ *     campo è una diramazione creata con msw_fork, STORAGE_MAP se la griglia
+ *     è mappata su file con msw_create_mapped.
+ *
+ * row_owned
+ *     Solo per le diramazioni, l'array che indica per ogni riga della griglia
+ *     se questa è privata (copiata alla prima modifica) oppure condivisa con
+ *     il campo di origine; NULL negli altri casi.
+ *
+ * hash
+ *     L'hash di Zobrist dello stato visibile del campo (celle visitate con il
+ *     loro contenuto e bandiere) per ognuna delle SYMMETRY_CNT simmetrie;
+ *     hash[0] corrisponde al campo non trasformato. Le simmetrie che
+ *     scambiano righe e colonne sono mantenute solo per i campi quadrati.
+ *
+ * map, map_size, map_fd
+ *     Solo per i campi mappati su file, l'indirizzo e la dimensione della
+ *     mappatura della griglia e il descrittore del file; NULL, 0 e -1 negli
+ *     altri casi.
+ *
+ * mines, mine_cap
+ *     L'indice delle celle contenenti una mina: le posizioni y * width + x
+ *     delle prime mine_cnt celle minate, nell'ordine di piazzamento, e la
+ *     capacità dell'array (0 se l'array è condiviso con il campo di origine
+ *     di una diramazione e va copiato prima di essere modificato).
+ *
+ * lazy, lazy_mines, committed, committed_cnt
+ *     Solo per i campi creati con msw_create_lazy, la politica di
+ *     piazzamento (LAZY_NONE se tutte le mine sono già piazzate), il numero
+ *     totale di mine da piazzare, la bitmap delle celle per cui è già stato
+ *     deciso se contengono una mina (un bit per cella, in ordine di riga) e
+ *     il numero di tali celle; committed è NULL negli altri casi.
+ *
+ * delta
+ *     Solo durante msw_apply, il buffer in cui vengono registrate le
+ *     modifiche dello stato visibile delle celle; NULL negli altri casi.
+ *
+ * I contatori di celle sono di tipo long, così da non traboccare sui campi
+ * con più di 2^31 celle; l'istanza resta un int, poiché è memorizzata in
+ * msw_cell_struct.visited e conta le mosse, non le celle.
  */
 struct msw_field_struct {
     msw_grid grid;
-    int width, height, mine_cnt, flag_cnt, nmnv_cnt, instance, undo_cnt;
+    int width, height;
+    long mine_cnt, flag_cnt, nmnv_cnt;
+    int instance, undo_cnt;
+    int storage;
+    unsigned char *row_owned;
+    uint64_t hash[SYMMETRY_CNT];
+    void *map;
+    size_t map_size;
+    int map_fd;
+    long *mines, mine_cap;
+    int lazy;
+    long lazy_mines;
+    uint64_t *committed;
+    long committed_cnt;
+    struct msw_delta_buffer_struct *delta;
 };
 
 typedef struct msw_field_struct *msw_field;
 
+/* La struttura che rappresenta una selezione eseguita a passi
+ * (msw_reveal_begin), per le aperture di milioni di celle: ogni passo visita
+ * un numero limitato di celle, così che l'interfaccia possa ridisegnare il
+ * campo e leggere l'input tra un passo e l'altro.
+ *
+ * field, buffer
+ *     Il campo e il buffer, fornito dal chiamante (o NULL), in cui vengono
+ *     registrate le modifiche di tutti i passi, come in msw_apply.
+ *
+ * stack, cnt, cap
+ *     Le celle vuote, già visitate, ancora da espandere (cnt coppie di
+ *     coordinate, spazio per cap coppie).
+ *
+ * result
+ *     Il risultato della visita della cella selezionata.
+ *
+ * start, visited
+ *     Il numero di celle non contenenti una mina e non visitate prima della
+ *     selezione e il numero di celle visitate finora, che indica
+ *     l'avanzamento.
+ */
+struct msw_reveal_struct {
+    msw_field field;
+    struct msw_delta_buffer_struct *buffer;
+    int *stack;
+    long cnt, cap;
+    int result;
+    long start, visited;
+};
+
+typedef struct msw_reveal_struct *msw_reveal;
+
+/* Funzioni di allocazione e deallocazione usate dal motore. */
+typedef void* (*msw_alloc_fn)(size_t);
+typedef void (*msw_free_fn)(void*);
+
+void msw_set_allocator(msw_alloc_fn, msw_free_fn);
+
+void msw_set_threads(int);
+
+int msw_thread_count(void);
+
+long msw_random(long);
+
+uint64_t msw_splitmix(uint64_t*);
+
+size_t msw_required_size(int, int);
+
+int msw_create_in_buffer(msw_field*, void*, size_t, int, int);
+
 int msw_create(msw_field*, int, int);
 
+int msw_create_mapped(msw_field*, int, int, const char*);
+
+void msw_reset(msw_field);
+
+int msw_fork(msw_field, msw_field*);
+
+int msw_copy(msw_field*, msw_field);
+
+int msw_copy_rows(msw_field*, msw_field, const unsigned char*);
+
 void msw_destroy(msw_field*);
 
 int msw_cell_exists(msw_field, int, int);
 
 msw_cell msw_get_cell(msw_field, int, int);
 
+msw_cell msw_get_cell_rw(msw_field, int, int);
+
+int msw_cell_state(msw_field, int, int);
+
+void msw_set_cell_state(msw_field, int, int, int);
+
+uint64_t msw_hash(msw_field);
+
+uint64_t msw_canonical_hash(msw_field);
+
+void msw_rehash(msw_field);
+
+long msw_mine_total(msw_field);
+
 int msw_mine_cell(msw_field, int, int);
 
-int msw_create_random(msw_field*, int, int, int);
+int msw_create_random(msw_field*, int, int, long);
+
+int msw_create_lazy(msw_field*, int, int, long, int);
+
+int msw_create_seeded(msw_field*, int, int, long, unsigned long);
+
+int msw_commit_all(msw_field);
+
+int msw_create_from_stream(msw_field*, FILE*, long*, long*);
 
 int msw_create_from_file(msw_field*, FILE*);
 
@@ -94,12 +338,32 @@ int msw_mark_cell(msw_field, int, int);
 
 void msw_mark_mine_cells(msw_field);
 
+void msw_show_mine_cells(msw_field);
+
 int msw_visit_adjacent_cells(msw_field, int, int);
 
 int msw_select_cell(msw_field, int, int);
 
+int msw_select_cells(msw_field, const int*, int);
+
+int msw_reveal_begin(msw_reveal*, msw_field, int, int, struct msw_delta_buffer_struct*);
+
+int msw_reveal_step(msw_reveal, long);
+
+int msw_reveal_finish(msw_reveal*);
+
+int msw_chord_cell(msw_field, int, int);
+
+int msw_flag_forced(msw_field, int, int);
+
+int msw_select_cell_shared(msw_field, int, int);
+
+int msw_mark_cell_shared(msw_field, int, int);
+
 int msw_undo(msw_field, int);
 
 int msw_undo_incremental(msw_field);
 
+int msw_apply(msw_field, struct msw_action_struct*, int, struct msw_delta_buffer_struct*);
+
 #endif /* __MINESWEEPER_H__ */
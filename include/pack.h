@@ -0,0 +1,114 @@
+#ifndef __PACK_H__
+#define __PACK_H__
+
+#include <stdint.h> /* uint64_t, int64_t, int32_t */
+#include <pthread.h> /* pthread_mutex_t */
+#include "minesweeper.h"
+
+/* Un pacchetto è un singolo file che raccoglie molti schemi. Il file inizia
+ * con un'intestazione, seguita dai record degli schemi (uno per schema, ognuno
+ * con la bitmap delle mine, il seed e le metriche precalcolate) e infine
+ * dall'indice, l'array degli offset dei record in ordine di identificativo.
+ * L'indice e l'intestazione definitiva vengono scritti alla chiusura del
+ * pacchetto: se la scrittura è stata interrotta, l'indice viene ricostruito in
+ * lettura scorrendo i record. I numeri sono memorizzati nell'ordine dei byte
+ * della macchina.
+ */
+
+/* Costante per l'identificazione di un pacchetto. */
+#define MSW_PACK_MAGIC "MSWPACK1"
+
+/* La struttura che rappresenta l'intestazione di un pacchetto.
+ *
+ * magic
+ *     I caratteri di MSW_PACK_MAGIC.
+ *
+ * board_cnt
+ *     Il numero di schemi nell'indice.
+ *
+ * index_offset
+ *     L'offset dell'indice, oppure 0 se il pacchetto non è stato chiuso.
+ */
+struct msw_pack_header_struct {
+    char magic[8];
+    uint64_t board_cnt, index_offset;
+};
+
+/* La struttura che rappresenta l'intestazione di un record, seguita dalla
+ * bitmap delle mine (un bit per cella, in ordine di riga, in parole a 64 bit).
+ *
+ * size
+ *     La dimensione del record in byte, compresa la bitmap.
+ *
+ * seed
+ *     Il seed con cui è stato generato lo schema.
+ *
+ * mine_cnt
+ *     Il numero di mine.
+ *
+ * bbbv
+ *     Il 3BV dello schema, il numero minimo di selezioni necessarie per
+ *     vincere: le aperture più le celle numerate non adiacenti ad alcuna
+ *     apertura.
+ *
+ * openings
+ *     Il numero di aperture, le regioni connesse di celle vuote.
+ *
+ * width, height
+ *     La dimensione dello schema.
+ */
+struct msw_pack_record_struct {
+    uint64_t size, seed;
+    int64_t mine_cnt, bbbv, openings;
+    int32_t width, height;
+};
+
+/* La struttura che rappresenta un pacchetto aperto in scrittura o in lettura.
+ *
+ * fd
+ *     Il descrittore del file.
+ *
+ * writable
+ *     Vero se il pacchetto è aperto in scrittura.
+ *
+ * lock
+ *     Il mutex che protegge end e l'indice durante la scrittura.
+ *
+ * end
+ *     L'offset della fine dei record (in scrittura, dove verrà scritto il
+ *     prossimo record).
+ *
+ * index, board_cnt, index_cap
+ *     L'indice degli offset dei record, il numero di schemi e la capacità
+ *     dell'indice (0 se l'indice si trova nella memoria mappata).
+ *
+ * map, map_size
+ *     La memoria mappata del file in lettura.
+ */
+struct msw_pack_struct {
+    int fd, writable;
+    pthread_mutex_t lock;
+    uint64_t end;
+    uint64_t *index;
+    long board_cnt, index_cap;
+    void *map;
+    size_t map_size;
+};
+
+typedef struct msw_pack_struct *msw_pack;
+
+int msw_pack_create(msw_pack*, const char*);
+
+int msw_pack_append(msw_pack, msw_field, uint64_t, long*);
+
+int msw_pack_open(msw_pack*, const char*);
+
+long msw_pack_count(msw_pack);
+
+const struct msw_pack_record_struct *msw_pack_record(msw_pack, long);
+
+int msw_pack_load(msw_pack, long, msw_field*);
+
+int msw_pack_close(msw_pack*);
+
+#endif /* __PACK_H__ */
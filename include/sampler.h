@@ -0,0 +1,108 @@
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <stdint.h> /* uint64_t */
+#include "minesweeper.h"
+
+/* Il campionatore stima, per ogni cella nascosta, la frequenza con cui
+ * contiene una mina tra tutti gli schemi coerenti con i numeri visibili e con
+ * il numero totale di mine, quando la frontiera (le celle nascoste adiacenti
+ * a un numero visibile) è troppo grande per enumerarli. Le celle nascoste
+ * lontane dai numeri sono indistinguibili: dato il numero k di mine nella
+ * frontiera, le restanti sono distribuite uniformemente tra di esse, e uno
+ * schema della frontiera pesa quanto il numero di modi di farlo,
+ * C(interior, mines - k). Basta quindi campionare gli schemi della frontiera.
+ *
+ * Ogni catena parte da uno schema coerente trovato con una ricerca in
+ * profondità con ritorno, con scelte casuali, e lo modifica con passi di
+ * Gibbs a blocchi: una variabile e alcune vicine, raggiunte in ampiezza
+ * attraverso i numeri condivisi, vengono riassegnate con uno degli schemi
+ * coerenti del blocco, estratto in proporzione al peso,
+ * così che la catena resti sempre tra gli schemi coerenti e, a regime, li
+ * visiti con la distribuzione cercata. Le catene hanno flussi casuali
+ * indipendenti derivati dal seme e sono divise tra più thread (quanti
+ * indicati da msw_set_threads); il confronto tra le loro stime dà il margine
+ * di errore, che comprende anche la lentezza di una catena ad allontanarsi
+ * dal punto di partenza.
+ */
+
+/* Costante per il numero massimo di variabili di un blocco: ogni passo
+ * enumera 2^MSW_SAMPLER_BLOCK schemi.
+ */
+#define MSW_SAMPLER_BLOCK 10
+
+/* Costante per il numero minimo di catene: almeno una per thread, e almeno
+ * MSW_SAMPLER_CHAINS per stimare il margine di errore.
+ */
+#define MSW_SAMPLER_CHAINS 8
+
+/* Costante per il numero di passate (aggiornamenti a blocchi che coprono in
+ * media ogni variabile una volta) iniziali di ogni catena i cui schemi non
+ * vengono contati.
+ */
+#define MSW_SAMPLER_BURN 32
+
+/* La struttura che rappresenta un campionatore.
+ *
+ * width, height
+ *     Le dimensioni del campo.
+ *
+ * mines, interior
+ *     Il numero di mine nascoste e il numero di celle nascoste lontane dai
+ *     numeri.
+ *
+ * var_cnt, var_cell
+ *     Il numero di celle della frontiera (le variabili) e la posizione nel
+ *     campo (y * width + x) di ognuna, in ordine crescente.
+ *
+ * var_con, var_con_start
+ *     I numeri adiacenti ad ogni variabile: quelli della variabile v sono
+ *     var_con[var_con_start[v]] ... var_con[var_con_start[v + 1] - 1].
+ *
+ * var_adj, var_adj_start
+ *     Allo stesso modo, le variabili che condividono un numero con ogni
+ *     variabile, da cui si formano i blocchi.
+ *
+ * con_cnt, con_value, con_var, con_var_start
+ *     Il numero di numeri visibili adiacenti alla frontiera, le mine
+ *     nascoste attorno ad ognuno e, allo stesso modo, le sue variabili.
+ *
+ * freq, interior_freq
+ *     Dopo msw_sampler_run, la frequenza stimata di ogni variabile e quella
+ *     di ogni cella lontana dai numeri.
+ *
+ * error
+ *     Dopo msw_sampler_run, il margine di errore delle frequenze: il doppio
+ *     del massimo errore standard tra le catene (circa il 95% di
+ *     confidenza), oppure 1 se meno di due catene hanno contato schemi.
+ *
+ * sample_cnt, chain_cnt
+ *     Dopo msw_sampler_run, il numero di schemi contati e il numero di
+ *     catene che ne hanno contato almeno uno.
+ */
+struct msw_sampler_struct {
+    int width, height;
+    long mines, interior;
+    int var_cnt;
+    long *var_cell;
+    int *var_con, *var_con_start;
+    int *var_adj, *var_adj_start;
+    int con_cnt;
+    int *con_value, *con_var, *con_var_start;
+    double *freq, interior_freq;
+    double error;
+    long sample_cnt;
+    int chain_cnt;
+};
+
+typedef struct msw_sampler_struct *msw_sampler;
+
+int msw_sampler_create(msw_sampler*, msw_field);
+
+void msw_sampler_destroy(msw_sampler*);
+
+int msw_sampler_run(msw_sampler, long, long, uint64_t);
+
+double msw_sampler_get(msw_sampler, int, int);
+
+#endif /* __SAMPLER_H__ */
@@ -0,0 +1,127 @@
+#ifndef __SOLVER_H__
+#define __SOLVER_H__
+
+#include <stdint.h> /* uint64_t */
+#include "minesweeper.h"
+
+/* Il risolutore deduce le celle sicure e le celle contenenti una mina a
+ * partire dallo stato visibile di un campo. Ogni numero visitato diventa
+ * un'equazione lineare sulle celle non visitate adiacenti (le variabili) e
+ * il sistema viene ridotto per eliminazione di Gauss, con i coefficienti
+ * [-1, 0, 1] di ogni riga rappresentati da due insiemi di bit (positivi e
+ * negativi) e combinati parola per parola. Una riga permette una deduzione
+ * quando il suo termine noto coincide con il massimo o il minimo ottenibile.
+ * Il sistema viene aggiornato incrementalmente ad ogni chiamata di
+ * msw_solver_update, aggiungendo solamente i numeri visitati nel frattempo:
+ * le celle da esaminare sono quelle del buffer delle modifiche di msw_apply,
+ * e l'intero campo viene scorso solo se il buffer manca o è incompleto.
+ */
+
+/* Costanti per il risultato della deduzione su una cella. */
+#define SOLVER_UNKNOWN 0
+#define SOLVER_SAFE 1
+#define SOLVER_MINE 2
+
+/* La struttura che rappresenta un'equazione del sistema.
+ *
+ * pos, neg
+ *     Gli insiemi di bit delle variabili con coefficiente 1 e -1.
+ *
+ * value
+ *     Il termine noto.
+ *
+ * pivot
+ *     La variabile pivot dell'equazione, oppure -1 se non ne ha una.
+ *
+ * lo, hi
+ *     L'intervallo delle parole degli insiemi di bit che possono essere non
+ *     nulle (lo > hi se l'equazione è vuota).
+ *
+ * dirty
+ *     Vero se l'equazione è stata modificata e deve essere rivalutata.
+ */
+struct msw_equation_struct {
+    uint64_t *pos, *neg;
+    int value, pivot, lo, hi, dirty;
+};
+
+/* La struttura che rappresenta un risolutore.
+ *
+ * width, height, instance, undo_cnt
+ *     Le dimensioni, l'istanza e il numero di annullamenti del campo al
+ *     momento dell'ultimo aggiornamento: se il campo torna indietro, il
+ *     sistema viene ricostruito.
+ *
+ * known
+ *     Per ogni cella, il risultato della deduzione (SOLVER_*).
+ *
+ * added
+ *     Per ogni cella, vero se la cella visitata è già stata aggiunta al
+ *     sistema.
+ *
+ * column, column_cell
+ *     La variabile associata ad ogni cella (-1 se nessuna) e la cella
+ *     associata ad ogni variabile (la posizione y * width + x).
+ *
+ * pivot_row
+ *     Per ogni variabile, l'equazione di cui è pivot (-1 se nessuna).
+ *
+ * col_cnt, col_cap, words
+ *     Il numero di variabili, la capacità e il numero di parole a 64 bit di
+ *     ogni insieme di bit (col_cap = words * 64).
+ *
+ * scratch
+ *     Un array di appoggio di col_cap elementi.
+ *
+ * rows, row_cnt, row_cap
+ *     Le equazioni del sistema.
+ *
+ * stack, stack_cnt
+ *     Le equazioni da rivalutare.
+ *
+ * global
+ *     Vero se l'equazione sul numero totale di mine è già stata aggiunta.
+ *
+ * known_mines
+ *     Il numero di celle di cui è stato dedotto che contengono una mina.
+ *
+ * unknown_cnt, interior_cnt
+ *     Il numero di celle non ancora dedotte e, tra queste, di quelle che non
+ *     sono variabili del sistema (lontane dai numeri visitati).
+ *
+ * synced
+ *     Vero se il sistema corrisponde al campo dell'ultimo aggiornamento, così
+ *     che il successivo possa limitarsi alle celle modificate; falso dopo
+ *     la creazione o una ricostruzione.
+ *
+ * Le posizioni delle celle e known_mines sono di tipo long, così da non
+ * traboccare sui campi con più di 2^31 celle; le variabili e le equazioni
+ * restano int, poiché corrispondono alle sole celle della frontiera.
+ */
+struct msw_solver_struct {
+    int width, height, instance, undo_cnt;
+    unsigned char *known, *added;
+    int *column;
+    long *column_cell;
+    int *pivot_row, *scratch;
+    int col_cnt, col_cap, words;
+    struct msw_equation_struct *rows;
+    int row_cnt, row_cap;
+    int *stack, stack_cnt;
+    int global;
+    long known_mines;
+    long unknown_cnt, interior_cnt;
+    int synced;
+};
+
+typedef struct msw_solver_struct *msw_solver;
+
+int msw_solver_create(msw_solver*, msw_field);
+
+void msw_solver_destroy(msw_solver*);
+
+int msw_solver_update(msw_solver, msw_field, const struct msw_delta_buffer_struct*);
+
+int msw_solver_get(msw_solver, int, int);
+
+#endif /* __SOLVER_H__ */
@@ -24,6 +24,11 @@
 #define INFO_Q 8
 #define INFO_W 16
 #define INFO_ENTER_PAUSE 32
+#define INFO_H 64
+#define INFO_E 128
+#define INFO_R 256
+#define INFO_REPLAY 512
+#define INFO_WATCH 1024
 
 /* Costanti per il tipo di menu di gioco. */
 #define GMENU_PAUSE 1
@@ -39,6 +44,28 @@
 #define ACTION_MARK 6
 #define ACTION_PAUSE 7
 #define ACTION_CONTINUE 8
+#define ACTION_HINT 9
+#define ACTION_RESUME 10
+#define ACTION_CHORD 11
+#define ACTION_REPLAY 12
+#define ACTION_SEEK 13
+
+/* Costanti per la modalità di ui_minesweeper. */
+#define UI_PLAY 0
+#define UI_DRAW 1
+#define UI_REPLAY 2
+#define UI_WATCH 3
+#define UI_REVEAL 4
+
+/* Costante per il numero di mosse percorse dai tasti Pag. Su/Pag. Giù nella
+ * modalità di revisione.
+ */
+#define UI_SEEK_PAGE 10
+
+/* Costante per l'intervallo minimo tra due disegni del campo, in
+ * millisecondi.
+ */
+#define UI_FRAME_MS 33
 
 /* Costanti per i simboli usati per il disegno del campo. */
 #define SYMBOL_UNUSED ACS_CKBOARD
@@ -73,9 +100,21 @@ void ui_message(char*);
 
 void ui_title();
 
+void ui_clock_reset();
+
+void ui_replay_position(long, long);
+
+long ui_seek_steps();
+
+void ui_set_watch(int (*)(msw_field, int*, int*));
+
+void ui_set_idle(void (*)(void));
+
+void ui_set_reveal(long (*)(msw_field));
+
 void ui_info(int);
 
-int ui_main_menu(int);
+int ui_main_menu(int, int);
 
 int ui_game_menu(int, int);
 
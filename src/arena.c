@@ -0,0 +1,521 @@
+#include <stdio.h> /* printf, fprintf, fflush, perror */
+#include <stdlib.h> /* malloc, realloc, free, strtol, strtoul, qsort */
+#include <string.h> /* memset, memcpy */
+#include <time.h> /* clock_gettime */
+#include <signal.h> /* SIGPROF, SIGALRM */
+#include <unistd.h> /* fork, getopt, sysconf, _exit */
+#include <dlfcn.h> /* dlopen, dlsym, dlclose, dlerror */
+#include <sys/mman.h> /* mmap, munmap, mprotect */
+#include <sys/time.h> /* setitimer */
+#include <sys/resource.h> /* getrusage */
+#include <sys/wait.h> /* wait4 */
+#include "minesweeper.h"
+#include "bot.h"
+
+/* L'arena confronta dei bot (vedi bot.h) senza interfaccia: ogni bot gioca
+ * lo stesso insieme di campi, generati con msw_create_seeded dai semi
+ * seed, seed + 1, ..., e aperti dall'arena sulla stessa cella vuota, così
+ * che nessuna partita si perda alla prima mossa. Ogni partita si svolge in
+ * un processo figlio, più partite in parallelo: un bot che termina in modo
+ * anomalo, scrive sulla vista o supera il tempo concesso perde solamente la
+ * partita in corso. Il tempo di CPU di ogni mossa è limitato da un timer
+ * ITIMER_PROF, il cui segnale termina il processo; un timer ITIMER_REAL più
+ * largo termina i bot che restano bloccati senza consumare CPU. Al termine
+ * viene stampato, per ogni bot, il numero di vittorie, il tempo medio di
+ * CPU per mossa, il 99-esimo percentile della latenza di una decisione e la
+ * memoria di picco di una partita.
+ */
+
+/* Costanti per l'esito di una partita. */
+#define ARENA_WON 0
+#define ARENA_LOST 1
+#define ARENA_RESIGNED 2
+#define ARENA_TIMEOUT 3
+#define ARENA_CRASHED 4
+#define ARENA_STALLED 5
+#define ARENA_OUTCOMES 6
+
+/* Costanti per i valori predefiniti delle opzioni: un campo esperto, 100
+ * partite e un secondo di CPU per mossa.
+ */
+#define ARENA_GAMES 100
+#define ARENA_WIDTH 30
+#define ARENA_HEIGHT 16
+#define ARENA_MINES 99
+#define ARENA_BUDGET_MS 1000
+
+/* Costante per il rapporto tra il limite di tempo reale e quello di CPU di
+ * una mossa (più un secondo).
+ */
+#define ARENA_WALL_FACTOR 10
+
+/* La struttura che rappresenta l'area condivisa con il processo di una
+ * partita, in cui il figlio registra l'esito man mano che gioca.
+ *
+ * outcome
+ *     L'esito della partita; ARENA_CRASHED finché non termina.
+ *
+ * moves, cpu
+ *     Il numero di mosse decise dal bot e il tempo di CPU totale, in
+ *     secondi, delle decisioni.
+ *
+ * baseline
+ *     La memoria residente del figlio, in KiB, prima del caricamento del bot.
+ *
+ * latency
+ *     La latenza, in secondi, di ognuna delle prime moves decisioni (un
+ *     array di max_moves elementi che segue la struttura).
+ */
+struct arena_slot_struct {
+    int outcome;
+    long moves;
+    double cpu;
+    long baseline;
+    double *latency;
+};
+
+/* La struttura che rappresenta i risultati di un bot.
+ *
+ * path, name
+ *     Il percorso della libreria e il nome del bot.
+ *
+ * outcomes
+ *     Il numero di partite per ogni esito.
+ *
+ * moves, cpu
+ *     Il numero totale di mosse e il tempo di CPU totale delle decisioni.
+ *
+ * latency, latency_cnt, latency_cap
+ *     Le latenze di tutte le decisioni, il loro numero e la capacità
+ *     dell'array.
+ *
+ * peak
+ *     La memoria di picco, in KiB, della partita più esigente, al netto di
+ *     quella del processo prima del caricamento del bot.
+ */
+struct arena_bot_struct {
+    const char *path;
+    char name[64];
+    long outcomes[ARENA_OUTCOMES];
+    long moves;
+    double cpu;
+    double *latency;
+    long latency_cnt, latency_cap;
+    long peak;
+};
+
+/* Le opzioni dell'arena. */
+static int width = ARENA_WIDTH, height = ARENA_HEIGHT;
+static long mines = ARENA_MINES, games = ARENA_GAMES, budget_ms = ARENA_BUDGET_MS, max_moves;
+static unsigned long seed = 1;
+
+/* arena_now restituisce il valore in secondi dell'orologio clock. */
+static double arena_now(clockid_t clock) {
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* arena_timers arma (se arm è vero) o disarma i timer di CPU e di tempo reale
+ * di una mossa.
+ */
+static void arena_timers(int arm) {
+    struct itimerval cpu, wall;
+    long wall_ms = budget_ms * ARENA_WALL_FACTOR + 1000;
+
+    memset(&cpu, 0, sizeof(cpu));
+    memset(&wall, 0, sizeof(wall));
+
+    if (arm) {
+        cpu.it_value.tv_sec = budget_ms / 1000;
+        cpu.it_value.tv_usec = (budget_ms % 1000) * 1000;
+        wall.it_value.tv_sec = wall_ms / 1000;
+        wall.it_value.tv_usec = (wall_ms % 1000) * 1000;
+    }
+
+    setitimer(ITIMER_PROF, &cpu, NULL);
+    setitimer(ITIMER_REAL, &wall, NULL);
+}
+
+/* arena_open apre la partita sul campo field: visita la prima cella vuota
+ * (oppure, se non ce ne sono, la prima cella senza mina) a partire da una
+ * posizione derivata dal seme della partita game, così che tutti i bot
+ * partano dalla stessa cella, e restituisce il risultato della visita.
+ */
+static int arena_open(msw_field field, long game, struct msw_delta_buffer_struct *deltas) {
+    struct msw_action_struct action;
+    long cells = (long) field->width * field->height, start, i, safe = -1;
+    uint64_t state = seed + (uint64_t) game;
+
+    start = (long) (msw_splitmix(&state) % (uint64_t) cells);
+
+    for (i = 0; i < cells; i++) {
+        long index = (start + i) % cells;
+        msw_cell cell = msw_get_cell(field, (int) (index % field->width), (int) (index / field->width));
+
+        if (cell->content == CONTENT_EMPTY) {
+            safe = index;
+            break;
+        }
+        if (safe < 0 && cell->content != CONTENT_MINE)
+            safe = index;
+    }
+
+    action.type = MSW_ACTION_SELECT;
+    action.x = (int) (safe % field->width);
+    action.y = (int) (safe / field->width);
+    msw_apply(field, &action, 1, deltas);
+
+    return action.result;
+}
+
+/* arena_view aggiorna le celle della vista con le modifiche registrate in
+ * deltas.
+ */
+static void arena_view(unsigned char *cells, struct msw_delta_buffer_struct *deltas) {
+    long i;
+
+    for (i = 0; i < deltas->cnt; i++) {
+        int state = MSW_DELTA_STATE(deltas->deltas[i]);
+
+        cells[MSW_DELTA_INDEX(deltas->deltas[i])] = (unsigned char) (state == STATE_HIDDEN ? BOT_HIDDEN :
+                                                                     state == STATE_FLAG ? BOT_FLAG : state);
+    }
+}
+
+/* arena_game gioca, nel processo figlio, la partita game del bot alla
+ * libreria path e ne registra l'esito in slot.
+ */
+static void arena_game(const char *path, long game, struct arena_slot_struct *slot) {
+    struct msw_bot_view_struct view;
+    struct msw_delta_buffer_struct deltas;
+    struct rusage usage;
+    msw_field field = NULL;
+    unsigned char *cells;
+    size_t size;
+    void *library, *state = NULL;
+    msw_bot_start_fn start;
+    msw_bot_move_fn move;
+    msw_bot_end_fn end;
+    long cells_cnt = (long) width * height;
+
+    slot->outcome = ARENA_CRASHED;
+    slot->moves = 0;
+    slot->cpu = 0;
+
+    msw_set_threads(1);
+
+    size = (size_t) cells_cnt;
+    cells = (unsigned char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    deltas.deltas = (uint64_t*) malloc((size_t) cells_cnt * sizeof(uint64_t));
+    deltas.cap = cells_cnt;
+
+    if (cells == MAP_FAILED || !deltas.deltas || !msw_create_seeded(&field, width, height, mines, seed + game))
+        return;
+
+    memset(cells, BOT_HIDDEN, size);
+    if (arena_open(field, game, &deltas) == RESULT_VICTORY) {
+        slot->outcome = ARENA_WON;
+        return;
+    }
+    arena_view(cells, &deltas);
+
+    view.width = width;
+    view.height = height;
+    view.mine_cnt = mines;
+    view.flag_cnt = field->flag_cnt;
+    view.cells = cells;
+
+    getrusage(RUSAGE_SELF, &usage);
+    slot->baseline = usage.ru_maxrss;
+
+    library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!library)
+        return;
+
+    *(void**) &start = dlsym(library, MSW_BOT_START);
+    *(void**) &move = dlsym(library, MSW_BOT_MOVE);
+    *(void**) &end = dlsym(library, MSW_BOT_END);
+    if (!move)
+        return;
+
+    mprotect(cells, size, PROT_READ);
+
+    if (start) {
+        arena_timers(1);
+        state = start(&view);
+        arena_timers(0);
+    }
+
+    while (slot->outcome == ARENA_CRASHED) {
+        struct msw_bot_action_struct bot_action;
+        struct msw_action_struct action;
+        double cpu0, wall0;
+        int decided;
+
+        if (slot->moves >= max_moves) {
+            slot->outcome = ARENA_STALLED;
+            break;
+        }
+
+        /* Decisione del bot, con la vista protetta e i timer armati. */
+        cpu0 = arena_now(CLOCK_PROCESS_CPUTIME_ID);
+        wall0 = arena_now(CLOCK_MONOTONIC);
+        arena_timers(1);
+        decided = move(state, &view, &bot_action);
+        arena_timers(0);
+        slot->latency[slot->moves] = arena_now(CLOCK_MONOTONIC) - wall0;
+        slot->cpu += arena_now(CLOCK_PROCESS_CPUTIME_ID) - cpu0;
+        slot->moves++;
+
+        if (!decided) {
+            slot->outcome = ARENA_RESIGNED;
+            break;
+        }
+
+        /* Esecuzione della mossa e aggiornamento della vista. */
+        action.type = (bot_action.type == BOT_REVEAL ? MSW_ACTION_SELECT :
+                       bot_action.type == BOT_MARK ? MSW_ACTION_MARK :
+                       bot_action.type == BOT_CHORD ? MSW_ACTION_CHORD : 0);
+        action.x = bot_action.x;
+        action.y = bot_action.y;
+        msw_apply(field, &action, 1, &deltas);
+
+        mprotect(cells, size, PROT_READ | PROT_WRITE);
+        arena_view(cells, &deltas);
+        view.flag_cnt = field->flag_cnt;
+        mprotect(cells, size, PROT_READ);
+
+        if (action.result == RESULT_VICTORY)
+            slot->outcome = ARENA_WON;
+        else if (action.result == RESULT_DEFEAT)
+            slot->outcome = ARENA_LOST;
+    }
+
+    if (end) {
+        arena_timers(1);
+        end(state);
+        arena_timers(0);
+    }
+}
+
+/* arena_slot restituisce l'area condivisa numero i, di dimensione size, a
+ * partire da base, con il puntatore alle sue latenze.
+ */
+static struct arena_slot_struct *arena_slot(char *base, size_t size, int i) {
+    struct arena_slot_struct *slot = (struct arena_slot_struct*) (base + size * i);
+
+    slot->latency = (double*) (slot + 1);
+
+    return slot;
+}
+
+/* arena_compare confronta due latenze per qsort. */
+static int arena_compare(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+/* arena_collect aggiunge ai risultati di bot l'esito della partita
+ * registrata in slot, conclusa con lo stato status e l'uso di risorse
+ * usage, e restituisce vero se le latenze sono state aggiunte con successo.
+ */
+static int arena_collect(struct arena_bot_struct *bot, struct arena_slot_struct *slot, int status,
+                         struct rusage *usage) {
+    int outcome = slot->outcome;
+
+    if (WIFSIGNALED(status))
+        outcome = (WTERMSIG(status) == SIGPROF || WTERMSIG(status) == SIGALRM ? ARENA_TIMEOUT : ARENA_CRASHED);
+
+    bot->outcomes[outcome]++;
+    bot->moves += slot->moves;
+    bot->cpu += slot->cpu;
+
+    if (usage->ru_maxrss - slot->baseline > bot->peak)
+        bot->peak = usage->ru_maxrss - slot->baseline;
+
+    if (bot->latency_cnt + slot->moves > bot->latency_cap) {
+        long cap = (bot->latency_cap > 0 ? bot->latency_cap : 1024);
+        double *latency;
+
+        while (cap < bot->latency_cnt + slot->moves)
+            cap *= 2;
+
+        latency = (double*) realloc(bot->latency, cap * sizeof(double));
+        if (!latency)
+            return 0;
+
+        bot->latency = latency;
+        bot->latency_cap = cap;
+    }
+
+    memcpy(bot->latency + bot->latency_cnt, slot->latency, slot->moves * sizeof(double));
+    bot->latency_cnt += slot->moves;
+
+    return 1;
+}
+
+/* arena_report stampa i risultati di bot. */
+static void arena_report(struct arena_bot_struct *bot) {
+    double p99 = 0;
+
+    if (bot->latency_cnt > 0) {
+        qsort(bot->latency, bot->latency_cnt, sizeof(double), arena_compare);
+        p99 = bot->latency[(bot->latency_cnt * 99 + 99) / 100 - 1];
+    }
+
+    printf("%s\n", bot->name);
+    printf("  vittorie:          %ld/%ld (%.1f%%)\n", bot->outcomes[ARENA_WON], games,
+           100.0 * bot->outcomes[ARENA_WON] / games);
+    printf("  sconfitte:         %ld (ritiri %ld, tempo scaduto %ld, errori %ld, stallo %ld)\n",
+           games - bot->outcomes[ARENA_WON], bot->outcomes[ARENA_RESIGNED], bot->outcomes[ARENA_TIMEOUT],
+           bot->outcomes[ARENA_CRASHED], bot->outcomes[ARENA_STALLED]);
+    printf("  mosse:             %ld\n", bot->moves);
+    printf("  CPU per mossa:     %.3f ms\n", bot->moves > 0 ? 1000 * bot->cpu / bot->moves : 0.0);
+    printf("  latenza p99:       %.3f ms\n", 1000 * p99);
+    printf("  memoria di picco:  %ld KiB\n", bot->peak);
+}
+
+/* arena_usage stampa la sintassi del comando. */
+static void arena_usage(const char *program) {
+    fprintf(stderr, "Uso: %s [-n partite] [-w larghezza] [-h altezza] [-m mine] [-s seme] "
+                    "[-t ms per mossa] [-j processi] bot.so...\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    struct arena_bot_struct *bots;
+    pid_t *pids;
+    long *tasks, next = 0, total;
+    int jobs = (int) sysconf(_SC_NPROCESSORS_ONLN), bot_cnt, running = 0, option, i;
+    size_t slot_size;
+    char *base;
+
+    while ((option = getopt(argc, argv, "n:w:h:m:s:t:j:")) != -1) {
+        switch (option) {
+            case 'n': games = strtol(optarg, NULL, 10); break;
+            case 'w': width = (int) strtol(optarg, NULL, 10); break;
+            case 'h': height = (int) strtol(optarg, NULL, 10); break;
+            case 'm': mines = strtol(optarg, NULL, 10); break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            case 't': budget_ms = strtol(optarg, NULL, 10); break;
+            case 'j': jobs = (int) strtol(optarg, NULL, 10); break;
+            default:
+                arena_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    bot_cnt = argc - optind;
+    if (bot_cnt < 1 || games < 1 || width < 1 || height < 1 || mines < 1 ||
+        mines >= (long) width * height || budget_ms < 1) {
+        arena_usage(argv[0]);
+        return 1;
+    }
+    if (jobs < 1)
+        jobs = 1;
+
+    /* Un bot che non decide mai la fine della partita (ad esempio mettendo e
+     * togliendo sempre la stessa bandiera) viene fermato dopo max_moves
+     * mosse, più di quante ne servano per visitare e marcare ogni cella.
+     */
+    max_moves = 2 * (long) width * height + 16;
+
+    /* Verifica dei bot nel processo dell'arena. */
+    bots = (struct arena_bot_struct*) calloc(bot_cnt, sizeof(struct arena_bot_struct));
+    if (!bots) {
+        perror("calloc");
+        return 1;
+    }
+
+    for (i = 0; i < bot_cnt; i++) {
+        void *library = dlopen(argv[optind + i], RTLD_NOW | RTLD_LOCAL);
+        msw_bot_name_fn name;
+
+        if (!library || !dlsym(library, MSW_BOT_MOVE)) {
+            fprintf(stderr, "%s: %s\n", argv[optind + i], library ? "manca " MSW_BOT_MOVE : dlerror());
+            return 1;
+        }
+
+        bots[i].path = argv[optind + i];
+        *(void**) &name = dlsym(library, MSW_BOT_NAME);
+        snprintf(bots[i].name, sizeof(bots[i].name), "%s", name ? name() : bots[i].path);
+        dlclose(library);
+    }
+
+    /* Un'area condivisa per ogni processo in esecuzione. */
+    slot_size = sizeof(struct arena_slot_struct) + max_moves * sizeof(double);
+    base = (char*) mmap(NULL, slot_size * jobs, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    pids = (pid_t*) calloc(jobs, sizeof(pid_t));
+    tasks = (long*) calloc(jobs, sizeof(long));
+    if (base == MAP_FAILED || !pids || !tasks) {
+        perror("mmap");
+        return 1;
+    }
+
+    printf("%d bot, %ld partite %dx%d con %ld mine (semi %lu-%lu), %ld ms di CPU per mossa, %d processi\n\n",
+           bot_cnt, games, width, height, mines, seed, seed + games - 1, budget_ms, jobs);
+    fflush(stdout);
+
+    /* Ogni compito è una coppia (bot, partita); i processi liberi prendono il
+     * prossimo compito, e ogni processo terminato viene raccolto.
+     */
+    total = bot_cnt * games;
+    while (next < total || running > 0) {
+        struct rusage usage;
+        pid_t pid;
+        int status;
+
+        if (next < total && running < jobs) {
+            for (i = 0; pids[i] != 0; i++)
+                ;
+
+            pid = fork();
+            if (pid == 0) {
+                arena_game(bots[next / games].path, next % games, arena_slot(base, slot_size, i));
+                _exit(0);
+            } else if (pid < 0) {
+                perror("fork");
+                return 1;
+            }
+
+            pids[i] = pid;
+            tasks[i] = next++;
+            running++;
+            continue;
+        }
+
+        pid = wait4(-1, &status, 0, &usage);
+        if (pid < 0) {
+            perror("wait4");
+            return 1;
+        }
+
+        for (i = 0; i < jobs && pids[i] != pid; i++)
+            ;
+        if (i == jobs)
+            continue;
+
+        if (!arena_collect(bots + tasks[i] / games, arena_slot(base, slot_size, i), status, &usage)) {
+            perror("realloc");
+            return 1;
+        }
+
+        pids[i] = 0;
+        running--;
+    }
+
+    for (i = 0; i < bot_cnt; i++) {
+        arena_report(bots + i);
+        free(bots[i].latency);
+    }
+
+    munmap(base, slot_size * jobs);
+    free(pids);
+    free(tasks);
+    free(bots);
+
+    return 0;
+}
@@ -0,0 +1,332 @@
+#include <stdio.h> /* Gestione di files, rename */
+#include <stdlib.h> /* malloc, calloc, free */
+#include <string.h> /* memcpy, memcmp, strlen */
+#include <unistd.h> /* fsync */
+#include "minesweeper.h"
+#include "autosave.h"
+
+/* msw_autosave_write scrive lo stato del campo e il numero di vite nel file
+ * path, passando per il file temporaneo path.tmp, e restituisce vero se la
+ * scrittura è avvenuta con successo.
+ */
+static int msw_autosave_write(msw_field field, int lives, const char *path) {
+    size_t len = strlen(path);
+    char *tmp_path = (char*) malloc(len + 5);
+    int32_t *row = (int32_t*) malloc(field->width * sizeof(int32_t));
+    FILE *fp = NULL;
+    int success = (tmp_path && row);
+
+    /* Una copia con piazzamento differito viene completata: la partita
+     * ripresa avrà uno schema fisso, coerente con tutto ciò che è stato
+     * mostrato.
+     */
+    success = (success && msw_commit_all(field));
+
+    if (success) {
+        memcpy(tmp_path, path, len);
+        memcpy(tmp_path + len, ".tmp", 5);
+
+        fp = fopen(tmp_path, "wb");
+        success = (fp != NULL);
+    }
+
+    if (success) {
+        struct msw_autosave_header_struct header;
+        long i;
+        int x, y;
+
+        memcpy(header.magic, MSW_AUTOSAVE_MAGIC, sizeof(header.magic));
+        header.width = field->width;
+        header.height = field->height;
+        header.instance = field->instance;
+        header.lives = lives;
+        header.undo_cnt = field->undo_cnt;
+        header.reserved = 0;
+        header.mine_cnt = field->mine_cnt;
+
+        success = (fwrite(&header, sizeof(header), 1, fp) == 1);
+
+        for (i = 0; success && i < field->mine_cnt; i++) {
+            int64_t index = field->mines[i];
+
+            success = (fwrite(&index, sizeof(index), 1, fp) == 1);
+        }
+
+        for (y = 0; success && y < field->height; y++) {
+            for (x = 0; x < field->width; x++)
+                row[x] = msw_get_cell(field, x, y)->visited;
+
+            success = (fwrite(row, sizeof(int32_t), field->width, fp) == (size_t) field->width);
+        }
+
+        /* Il file temporaneo deve essere su disco prima di sostituire il
+         * salvataggio precedente.
+         */
+        success = (success && fflush(fp) == 0 && fsync(fileno(fp)) == 0);
+        success = (fclose(fp) == 0 && success);
+        success = (success && rename(tmp_path, path) == 0);
+
+        if (!success)
+            remove(tmp_path);
+    }
+
+    free(row);
+    free(tmp_path);
+
+    return success;
+}
+
+/* msw_autosave_main è il corpo del thread di salvataggio: attende una copia,
+ * la prende in carico scambiandola con la copia di lavoro e la scrive. Prima
+ * di terminare, scrive l'ultima copia consegnata.
+ */
+static void *msw_autosave_main(void *arg) {
+    msw_autosave autosave = (msw_autosave) arg;
+
+    pthread_mutex_lock(&autosave->lock);
+
+    while (!autosave->quit || autosave->submitted != autosave->taken) {
+        if (autosave->submitted == autosave->taken)
+            pthread_cond_wait(&autosave->cond, &autosave->lock);
+        else {
+            msw_field field = autosave->work;
+            int success;
+
+            autosave->work = autosave->pending;
+            autosave->work_lives = autosave->pending_lives;
+            autosave->pending = field;
+            autosave->taken = autosave->submitted;
+
+            pthread_mutex_unlock(&autosave->lock);
+            success = msw_autosave_write(autosave->work, autosave->work_lives, autosave->path);
+            pthread_mutex_lock(&autosave->lock);
+
+            autosave->failed = !success;
+        }
+    }
+
+    pthread_mutex_unlock(&autosave->lock);
+
+    return NULL;
+}
+
+/* msw_autosave_create crea un nuovo salvataggio automatico sul file path e
+ * avvia il suo thread, assegna il puntatore a *autosaveptr (se *autosaveptr è
+ * un puntatore non nullo, viene prima distrutto il salvataggio riferito da
+ * esso) e restituisce vero se la creazione è avvenuta con successo.
+ */
+int msw_autosave_create(msw_autosave *autosaveptr, const char *path) {
+    msw_autosave autosave = (msw_autosave) calloc(1, sizeof(struct msw_autosave_struct));
+
+    if (autosave) {
+        size_t len = strlen(path) + 1;
+
+        autosave->path = (char*) malloc(len);
+
+        if (autosave->path && pthread_mutex_init(&autosave->lock, NULL) == 0) {
+            memcpy(autosave->path, path, len);
+
+            if (pthread_cond_init(&autosave->cond, NULL) == 0) {
+                if (pthread_create(&autosave->thread, NULL, msw_autosave_main, autosave) == 0) {
+                    msw_autosave_destroy(autosaveptr);
+                    *autosaveptr = autosave;
+
+                    return 1;
+                }
+
+                pthread_cond_destroy(&autosave->cond);
+            }
+
+            pthread_mutex_destroy(&autosave->lock);
+        }
+
+        free(autosave->path);
+        free(autosave);
+    }
+
+    return 0;
+}
+
+/* msw_autosave_destroy attende la scrittura dell'ultima copia consegnata,
+ * termina il thread di salvataggio e distrugge il salvataggio automatico.
+ */
+void msw_autosave_destroy(msw_autosave *autosaveptr) {
+    if (*autosaveptr) {
+        msw_autosave autosave = *autosaveptr;
+
+        pthread_mutex_lock(&autosave->lock);
+        autosave->quit = 1;
+        pthread_cond_signal(&autosave->cond);
+        pthread_mutex_unlock(&autosave->lock);
+
+        pthread_join(autosave->thread, NULL);
+
+        msw_destroy(&autosave->pending);
+        msw_destroy(&autosave->work);
+        pthread_cond_destroy(&autosave->cond);
+        pthread_mutex_destroy(&autosave->lock);
+        free(autosave->path);
+        free(autosave);
+
+        *autosaveptr = NULL;
+    }
+}
+
+/* msw_autosave_copy copia il campo con il numero di vite nella copia da
+ * consegnare, all'istante now, e la consegna al thread di salvataggio;
+ * restituisce vero se la copia è stata effettuata. Va chiamata con il mutex
+ * preso.
+ */
+static int msw_autosave_copy(msw_autosave autosave, msw_field field, int lives, time_t now) {
+    int success = msw_copy(&autosave->pending, field);
+
+    if (success) {
+        autosave->pending_lives = lives;
+        autosave->submitted++;
+        autosave->last = now;
+        autosave->skipped = 0;
+        pthread_cond_signal(&autosave->cond);
+    }
+
+    return success;
+}
+
+/* msw_autosave_submit consegna al thread di salvataggio una copia del campo
+ * con il numero di vite e restituisce vero se la copia è stata effettuata. Se
+ * force è falso, la copia viene effettuata solamente se sono trascorsi almeno
+ * MSW_AUTOSAVE_INTERVAL secondi dalla precedente, così che il costo della
+ * copia non venga pagato ad ogni mossa; altrimenti viene rimandata a
+ * msw_autosave_tick. La scrittura non blocca mai il chiamante: una copia non
+ * ancora presa in carico viene sostituita.
+ */
+int msw_autosave_submit(msw_autosave autosave, msw_field field, int lives, int force) {
+    time_t now = time(NULL);
+    int success = 0;
+
+    pthread_mutex_lock(&autosave->lock);
+
+    if (force || autosave->submitted == 0 || now - autosave->last >= MSW_AUTOSAVE_INTERVAL)
+        success = msw_autosave_copy(autosave, field, lives, now);
+    else {
+        autosave->skipped = 1;
+        autosave->skipped_lives = lives;
+    }
+
+    pthread_mutex_unlock(&autosave->lock);
+
+    return success;
+}
+
+/* msw_autosave_tick consegna la copia rimandata da msw_autosave_submit, se
+ * ce n'è una e l'intervallo è trascorso, e restituisce vero se la copia è
+ * stata effettuata. Va chiamata periodicamente dal thread che modifica il
+ * campo, anche in assenza di mosse, così che le ultime mosse vengano salvate
+ * anche se il giocatore si ferma; field deve essere nello stesso stato
+ * dell'ultima msw_autosave_submit.
+ */
+int msw_autosave_tick(msw_autosave autosave, msw_field field) {
+    time_t now = time(NULL);
+    int success = 0;
+
+    pthread_mutex_lock(&autosave->lock);
+
+    if (autosave->skipped && now - autosave->last >= MSW_AUTOSAVE_INTERVAL)
+        success = msw_autosave_copy(autosave, field, autosave->skipped_lives, now);
+
+    pthread_mutex_unlock(&autosave->lock);
+
+    return success;
+}
+
+/* msw_autosave_failed restituisce vero se l'ultima scrittura non è riuscita. */
+int msw_autosave_failed(msw_autosave autosave) {
+    int failed;
+
+    pthread_mutex_lock(&autosave->lock);
+    failed = autosave->failed;
+    pthread_mutex_unlock(&autosave->lock);
+
+    return failed;
+}
+
+/* msw_autosave_load crea un nuovo campo con le stesse modalità di msw_create,
+ * con lo stato letto dal salvataggio automatico nel file path, assegna a
+ * *lives il numero di vite salvato e restituisce vero se la lettura è
+ * avvenuta con successo.
+ */
+int msw_autosave_load(msw_field *fieldptr, const char *path, int *lives) {
+    FILE *fp = fopen(path, "rb");
+    struct msw_autosave_header_struct header;
+    msw_field field = NULL;
+    int32_t *row = NULL;
+    int success;
+
+    if (!fp)
+        return 0;
+
+    success = (fread(&header, sizeof(header), 1, fp) == 1 &&
+               memcmp(header.magic, MSW_AUTOSAVE_MAGIC, sizeof(header.magic)) == 0 &&
+               header.mine_cnt >= 1 && header.mine_cnt < (int64_t) header.width * header.height &&
+               header.instance >= 1 && header.lives >= 1 && header.undo_cnt >= 0 &&
+               msw_create(&field, header.width, header.height));
+
+    if (success) {
+        long i;
+
+        for (i = 0; success && i < header.mine_cnt; i++) {
+            int64_t index;
+
+            success = (fread(&index, sizeof(index), 1, fp) == 1 &&
+                       index >= 0 && index < (int64_t) header.width * header.height &&
+                       msw_mine_cell(field, (int) (index % header.width), (int) (index / header.width)));
+        }
+
+        success = (success && field->mine_cnt == header.mine_cnt);
+    }
+
+    if (success) {
+        int x, y;
+
+        row = (int32_t*) malloc(header.width * sizeof(int32_t));
+        success = (row != NULL);
+
+        /* Ripristino delle celle visitate e marcate e dei contatori. */
+        for (y = 0; success && y < header.height; y++) {
+            success = (fread(row, sizeof(int32_t), header.width, fp) == (size_t) header.width);
+
+            for (x = 0; success && x < header.width; x++) {
+                msw_cell cell = msw_get_cell_rw(field, x, y);
+
+                success = (cell && row[x] >= VISITED_FLAG && row[x] < header.instance);
+
+                if (success && row[x] != VISITED_NO) {
+                    cell->visited = row[x];
+
+                    if (row[x] == VISITED_FLAG)
+                        field->flag_cnt++;
+                    else if (cell->content != CONTENT_MINE)
+                        field->nmnv_cnt--;
+                }
+            }
+        }
+    }
+
+    free(row);
+    fclose(fp);
+
+    if (success) {
+        field->instance = header.instance;
+        field->undo_cnt = header.undo_cnt;
+        msw_rehash(field);
+
+        msw_destroy(fieldptr);
+        *fieldptr = field;
+        *lives = header.lives;
+
+        return 1;
+    }
+
+    msw_destroy(&field);
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h> /* printf, fprintf */
+#include <stdlib.h> /* strtol, srand, rand */
+#include <string.h> /* strcmp */
+#include <time.h> /* clock_gettime */
+#include <unistd.h> /* sysconf */
+#include "minesweeper.h"
+#include "bitboard.h"
+
+/* Il banco di prova misura il tempo di una grande apertura al variare del
+ * numero di thread: per ogni numero di thread (1, 2, 4, 8, 16, al più
+ * MSW_PARALLEL_MAX) costruisce con msw_create_seeded lo stesso campo, con
+ * poche mine, e seleziona la stessa cella vuota, ripetendo la misura e
+ * tenendo il tempo migliore. Verifica inoltre che il campo risultante (celle
+ * da visitare e hash) sia lo stesso per ogni numero di thread.
+ *
+ * Con il primo argomento "presets", misura invece la velocità di simulazione
+ * sugli schemi classici del motore ordinario e del motore a bitboard: ogni
+ * partita genera uno schema con msw_create_random (o msw_bb_create_random) e
+ * seleziona celle a caso fino alla vittoria o alla sconfitta. Con lo stesso
+ * seed di rand i due motori giocano le stesse partite, e il banco di prova
+ * verifica che ottengano gli stessi risultati.
+ */
+
+/* Costanti per i valori predefiniti: un campo di 16 milioni di celle con una
+ * mina ogni 2000 celle, 3 ripetizioni.
+ */
+#define BENCH_WIDTH 4096
+#define BENCH_HEIGHT 4096
+#define BENCH_MINES 8192
+#define BENCH_REPEAT 3
+#define BENCH_SEED 1
+
+/* Costante per il numero predefinito di partite per schema classico. */
+#define BENCH_GAMES 100000
+
+/* bench_now restituisce il tempo corrente in secondi, da un orologio
+ * monotono.
+ */
+static double bench_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* bench_empty cerca la prima cella vuota del campo, in ordine di riga, e
+ * restituisce vero se esiste.
+ */
+static int bench_empty(msw_field field, int *x, int *y) {
+    for (*y = 0; *y < field->height; (*y)++)
+        for (*x = 0; *x < field->width; (*x)++)
+            if (msw_get_cell(field, *x, *y)->content == CONTENT_EMPTY)
+                return 1;
+
+    return 0;
+}
+
+/* bench_play_field gioca games partite sullo schema width x height con mines
+ * mine con il motore ordinario, assegna a *wins le vittorie e a *visited le
+ * celle visitate in totale, e restituisce il tempo impiegato in secondi.
+ */
+static double bench_play_field(int width, int height, int mines, long games, long *wins, long *visited) {
+    msw_field field = NULL;
+    double start = bench_now();
+    long g;
+
+    *wins = 0;
+    *visited = 0;
+    srand(BENCH_SEED);
+
+    for (g = 0; g < games; g++) {
+        int result = 0;
+
+        if (!msw_create_random(&field, width, height, mines))
+            break;
+
+        while (result != RESULT_VICTORY && result != RESULT_DEFEAT)
+            result = msw_select_cell(field, rand() % width, rand() % height);
+
+        *wins += (result == RESULT_VICTORY);
+        *visited += (long) width * height - mines - field->nmnv_cnt;
+    }
+
+    msw_destroy(&field);
+
+    return bench_now() - start;
+}
+
+/* bench_play_bb gioca le stesse partite di bench_play_field con il motore a
+ * bitboard.
+ */
+static double bench_play_bb(int width, int height, int mines, long games, long *wins, long *visited) {
+    struct msw_bb_struct bb;
+    double start = bench_now();
+    long g;
+
+    *wins = 0;
+    *visited = 0;
+    srand(BENCH_SEED);
+
+    for (g = 0; g < games; g++) {
+        int result = 0;
+
+        if (!msw_bb_create_random(&bb, width, height, mines))
+            break;
+
+        while (result != RESULT_VICTORY && result != RESULT_DEFEAT)
+            result = msw_bb_select_cell(&bb, rand() % width, rand() % height);
+
+        *wins += (result == RESULT_VICTORY);
+        *visited += width * height - mines - bb.nmnv_cnt;
+    }
+
+    return bench_now() - start;
+}
+
+/* bench_presets confronta i due motori sugli schemi classici, con games
+ * partite per schema.
+ */
+static int bench_presets(long games) {
+    int presets[3][3] = {{MSW_BB_BEGINNER}, {MSW_BB_INTERMEDIATE}, {MSW_BB_EXPERT}}, i;
+
+    printf("%ld partite per schema, celle selezionate a caso\n", games);
+    printf("%8s %12s %12s %12s %12s %9s\n", "schema", "vittorie", "campo ms", "bitboard ms", "partite/s", "speedup");
+
+    for (i = 0; i < 3; i++) {
+        int width = presets[i][0], height = presets[i][1], mines = presets[i][2];
+        long field_wins, field_visited, bb_wins, bb_visited;
+        double field_time = bench_play_field(width, height, mines, games, &field_wins, &field_visited);
+        double bb_time = bench_play_bb(width, height, mines, games, &bb_wins, &bb_visited);
+        char name[16];
+
+        if (field_wins != bb_wins || field_visited != bb_visited) {
+            fprintf(stderr, "Risultati diversi tra i due motori sullo schema %dx%d.\n", width, height);
+            return 1;
+        }
+
+        sprintf(name, "%dx%d", width, height);
+        printf("%8s %12ld %12.1f %12.1f %12.0f %8.2fx\n", name, bb_wins, field_time * 1000, bb_time * 1000,
+               games / bb_time, field_time / bb_time);
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int width = (argc > 1 ? (int) strtol(argv[1], NULL, 10) : BENCH_WIDTH);
+    int height = (argc > 2 ? (int) strtol(argv[2], NULL, 10) : BENCH_HEIGHT);
+    long mines = (argc > 3 ? strtol(argv[3], NULL, 10) : BENCH_MINES);
+    int repeat = (argc > 4 ? (int) strtol(argv[4], NULL, 10) : BENCH_REPEAT);
+    msw_field field = NULL;
+    double base = 0;
+    long remaining = -1;
+    uint64_t hash = 0;
+    int threads, x, y, r;
+
+    if (argc > 1 && strcmp(argv[1], "presets") == 0) {
+        long games = (argc > 2 ? strtol(argv[2], NULL, 10) : BENCH_GAMES);
+
+        if (games >= 1)
+            return bench_presets(games);
+
+        width = 0;
+    }
+
+    if (width < 1 || height < 1 || mines < 1 || repeat < 1) {
+        fprintf(stderr, "Uso: %s [larghezza] [altezza] [mine] [ripetizioni]\n", argv[0]);
+        fprintf(stderr, "     %s presets [partite]\n", argv[0]);
+        return 1;
+    }
+
+    printf("Campo %dx%d con %ld mine, %ld processori disponibili\n",
+           width, height, mines, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %12s %12s %10s\n", "thread", "ms", "celle/ms", "speedup");
+
+    for (threads = 1; threads <= MSW_PARALLEL_MAX; threads *= 2) {
+        double best = -1;
+
+        for (r = 0; r < repeat; r++) {
+            double start;
+            long before;
+
+            /* La costruzione usa sempre un solo thread, così che il campo
+             * misurato sia in memoria nello stesso stato.
+             */
+            msw_set_threads(1);
+            if (!msw_create_seeded(&field, width, height, mines, BENCH_SEED) || !bench_empty(field, &x, &y)) {
+                fprintf(stderr, "Non sono riuscito a creare il campo.\n");
+                return 1;
+            }
+
+            msw_set_threads(threads);
+            before = field->nmnv_cnt;
+            start = bench_now();
+            msw_select_cell(field, x, y);
+            start = bench_now() - start;
+
+            if (best < 0 || start < best)
+                best = start;
+
+            if (remaining < 0) {
+                remaining = field->nmnv_cnt;
+                hash = msw_hash(field);
+            } else if (field->nmnv_cnt != remaining || msw_hash(field) != hash) {
+                fprintf(stderr, "Risultato diverso con %d thread.\n", threads);
+                return 1;
+            }
+
+            if (threads == 1 && r == 0)
+                printf("Apertura di %ld celle\n", before - field->nmnv_cnt);
+        }
+
+        if (threads == 1)
+            base = best;
+
+        printf("%8d %12.1f %12.0f %9.2fx\n", threads, best * 1000,
+               (double) (width * (long) height - mines - remaining) / (best * 1000), base / best);
+    }
+
+    msw_destroy(&field);
+
+    return 0;
+}
@@ -0,0 +1,386 @@
+#include <string.h> /* memset */
+#include "minesweeper.h"
+#include "bitboard.h"
+
+/* msw_bb_popcount restituisce il numero di bit a 1 della maschera. */
+static int msw_bb_popcount(uint64_t mask) {
+    return __builtin_popcountll(mask);
+}
+
+/* msw_bb_spread estende orizzontalmente la maschera di una colonna a sinistra
+ * e a destra.
+ */
+static uint64_t msw_bb_spread(uint64_t mask) {
+    return mask | (mask << 1) | (mask >> 1);
+}
+
+/* msw_bb_row_fill estende i bit di seeds lungo le sequenze contigue di bit a
+ * 1 di mask che li contengono (riempimento di Kogge-Stone in entrambe le
+ * direzioni, in 6 passi anziché fino a 64).
+ */
+static uint64_t msw_bb_row_fill(uint64_t seeds, uint64_t mask) {
+    uint64_t left = seeds & mask, right = left, pro_left = mask, pro_right = mask;
+    int shift;
+
+    for (shift = 1; shift < 64; shift <<= 1) {
+        left |= pro_left & (left << shift);
+        pro_left &= pro_left << shift;
+        right |= pro_right & (right >> shift);
+        pro_right &= pro_right >> shift;
+    }
+
+    return left | right;
+}
+
+/* msw_bb_create inizializza un campo a bitboard vuoto, dati 1 < width <= 64 e
+ * 1 < height <= 32, e restituisce vero se l'inizializzazione è avvenuta con
+ * successo. Il campo non richiede allocazioni e può risiedere sullo stack.
+ */
+int msw_bb_create(msw_bb bb, int width, int height) {
+    if (width > 1 && width <= MSW_BB_MAX_WIDTH && height > 1 && height <= MSW_BB_MAX_HEIGHT) {
+        int y;
+
+        memset(bb->mine, 0, sizeof(bb->mine));
+        memset(bb->visited, 0, sizeof(bb->visited));
+        memset(bb->flag, 0, sizeof(bb->flag));
+
+        bb->row_mask = (width == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << width) - 1);
+
+        /* In assenza di mine, tutte le celle esistenti sono vuote. */
+        for (y = 0; y < MSW_BB_MAX_HEIGHT; y++)
+            bb->zero[y] = (y < height ? bb->row_mask : 0);
+
+        bb->width = width;
+        bb->height = height;
+        bb->mine_cnt = 0;
+        bb->flag_cnt = 0;
+        bb->nmnv_cnt = width * height;
+        bb->instance = 1;
+        bb->undo_cnt = 0;
+        bb->log_len = 0;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_bb_create_random inizializza un campo a bitboard con le stesse modalità
+ * di msw_bb_create e vi piazza le mine in modo casuale con lo stesso
+ * algoritmo e le stesse estrazioni (msw_random) di msw_create_random: a
+ * parità di seed di rand, lo schema ottenuto è identico.
+ */
+int msw_bb_create_random(msw_bb bb, int width, int height, int mines) {
+    if ((mines >= 1 && mines < (width * height)) && msw_bb_create(bb, width, height)) {
+        int cells = width * height, j;
+
+        /* Algoritmo di Floyd, con le stesse estrazioni di msw_create_random. */
+        for (j = cells - mines; j < cells; j++) {
+            int t = (int) msw_random(j + 1);
+
+            if (bb->mine[t / width] & ((uint64_t) 1 << (t % width)))
+                t = j;
+
+            msw_bb_mine_cell(bb, t % width, t / width);
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_bb_cell_exists verifica se esiste la cella alla posizione (x, y). */
+int msw_bb_cell_exists(msw_bb bb, int x, int y) {
+    return (x >= 0 && x < bb->width && y >= 0 && y < bb->height);
+}
+
+/* msw_bb_mine_cell piazza una mina sulla (x, y) cella esistente e restituisce
+ * vero se l'operazione è avvenuta con successo.
+ */
+int msw_bb_mine_cell(msw_bb bb, int x, int y) {
+    if (msw_bb_cell_exists(bb, x, y)) {
+        uint64_t bit = (uint64_t) 1 << x;
+
+        if (!(bb->mine[y] & bit)) {
+            uint64_t window = msw_bb_spread(bit) & bb->row_mask;
+            int y0;
+
+            /* Le celle adiacenti alla mina (e la mina stessa) non sono più vuote. */
+            for (y0 = y - 1; y0 <= y + 1; y0++) {
+                if (y0 >= 0 && y0 < bb->height)
+                    bb->zero[y0] &= ~window;
+            }
+
+            bb->mine[y] |= bit;
+            bb->mine_cnt++;
+            bb->nmnv_cnt--;
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_bb_get_content restituisce il contenuto della cella (x, y) con la
+ * stessa codifica di msw_cell_struct.content, contando le mine adiacenti.
+ */
+int msw_bb_get_content(msw_bb bb, int x, int y) {
+    uint64_t bit = (uint64_t) 1 << x, window = msw_bb_spread(bit);
+    int y0, content = 0;
+
+    if (bb->mine[y] & bit)
+        return CONTENT_MINE;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++) {
+        if (y0 >= 0 && y0 < bb->height)
+            content += msw_bb_popcount(bb->mine[y0] & window);
+    }
+
+    return content;
+}
+
+/* msw_bb_get_visited restituisce VISITED_FLAG se la cella (x, y) è marcata con
+ * una bandiera, VISITED_NO se non è visitata, altrimenti un valore positivo
+ * (il campo a bitboard non conserva l'istanza di ogni visita).
+ */
+int msw_bb_get_visited(msw_bb bb, int x, int y) {
+    uint64_t bit = (uint64_t) 1 << x;
+
+    if (bb->flag[y] & bit)
+        return VISITED_FLAG;
+    if (bb->visited[y] & bit)
+        return 1;
+    return VISITED_NO;
+}
+
+/* msw_bb_mark_cell marca/demarca la cella (x, y) con una bandiera, se non
+ * visitata, e restituisce vero se la modifica è avvenuta con successo.
+ */
+int msw_bb_mark_cell(msw_bb bb, int x, int y) {
+    if (msw_bb_cell_exists(bb, x, y)) {
+        uint64_t bit = (uint64_t) 1 << x;
+
+        if (!(bb->visited[y] & bit)) {
+            bb->flag[y] ^= bit;
+            bb->flag_cnt += ((bb->flag[y] & bit) ? 1 : -1);
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* msw_bb_mark_mine_cells marca tutte le celle contenenti una mina con una
+ * bandiera.
+ */
+void msw_bb_mark_mine_cells(msw_bb bb) {
+    int y;
+
+    for (y = 0; y < bb->height; y++) {
+        bb->flag[y] |= bb->mine[y];
+        bb->visited[y] &= ~bb->mine[y];
+    }
+}
+
+/* msw_bb_flood calcola le celle visitate selezionando la cella vuota (x, y):
+ * l'insieme delle celle vuote raggiungibili viene esteso riga per riga finché
+ * non si stabilizza, poi vi si aggiunge il bordo di celle adiacenti. Le righe
+ * delle celle da visitare vengono salvate in delta[*lo_ptr..*hi_ptr].
+ * msw_bb_flood è una funzione ausiliaria di msw_bb_select_cell.
+ */
+static void msw_bb_flood(msw_bb bb, int x, int y, uint64_t *delta, int *lo_ptr, int *hi_ptr) {
+    uint64_t fill[MSW_BB_MAX_HEIGHT + 2], *row = fill + 1;
+    int lo = y, hi = y, r, changed;
+
+    /* row[-1] e row[height] restano vuote, così da non dover controllare i bordi. */
+    memset(fill, 0, sizeof(fill));
+    row[y] = (uint64_t) 1 << x;
+
+    do {
+        changed = 0;
+
+        /* Passata dall'alto verso il basso e poi dal basso verso l'alto: ogni
+         * riga raccoglie i semi dalle righe vicine e li estende lungo le celle
+         * vuote disponibili.
+         */
+        for (r = (lo > 0 ? lo - 1 : 0); r <= hi + 1 && r < bb->height; r++) {
+            uint64_t avail = bb->zero[r] & ~bb->visited[r] & ~bb->flag[r];
+            uint64_t seeds = row[r] | msw_bb_spread(row[r - 1]) | msw_bb_spread(row[r + 1]);
+            uint64_t next = msw_bb_row_fill(seeds, avail);
+
+            if (next != row[r]) {
+                row[r] = next;
+                changed = 1;
+                if (r < lo)
+                    lo = r;
+                if (r > hi)
+                    hi = r;
+            }
+        }
+
+        for (r = (hi + 1 < bb->height ? hi + 1 : hi); r >= lo - 1 && r >= 0; r--) {
+            uint64_t avail = bb->zero[r] & ~bb->visited[r] & ~bb->flag[r];
+            uint64_t seeds = row[r] | msw_bb_spread(row[r - 1]) | msw_bb_spread(row[r + 1]);
+            uint64_t next = msw_bb_row_fill(seeds, avail);
+
+            if (next != row[r]) {
+                row[r] = next;
+                changed = 1;
+                if (r < lo)
+                    lo = r;
+                if (r > hi)
+                    hi = r;
+            }
+        }
+    } while (changed);
+
+    /* Le celle visitate sono le celle vuote raggiunte e le loro adiacenti. */
+    if (lo > 0)
+        lo--;
+    if (hi < bb->height - 1)
+        hi++;
+
+    for (r = lo; r <= hi; r++)
+        delta[r] = (msw_bb_spread(row[r - 1]) | msw_bb_spread(row[r]) | msw_bb_spread(row[r + 1])) &
+            bb->row_mask & ~bb->visited[r] & ~bb->flag[r];
+
+    *lo_ptr = lo;
+    *hi_ptr = hi;
+}
+
+/* msw_bb_select_cell seleziona la cella (x, y) con la stessa semantica di
+ * msw_select_cell.
+ */
+int msw_bb_select_cell(msw_bb bb, int x, int y) {
+    if (msw_bb_cell_exists(bb, x, y)) {
+        uint64_t bit = (uint64_t) 1 << x;
+
+        /* Se la cella è non visitata e non marcata... */
+        if (!((bb->visited[y] | bb->flag[y]) & bit)) {
+            uint64_t delta[MSW_BB_MAX_HEIGHT];
+            int lo = y, hi = y, r, result = RESULT_VISITED;
+
+            if (bb->mine[y] & bit) {
+                result = RESULT_DEFEAT;
+                delta[y] = bit;
+            } else if (bb->zero[y] & bit)
+                msw_bb_flood(bb, x, y, delta, &lo, &hi);
+            else
+                delta[y] = bit;
+
+            /* Visita delle celle e registrazione delle righe modificate. */
+            for (r = lo; r <= hi; r++) {
+                bb->visited[r] |= delta[r];
+                bb->nmnv_cnt -= msw_bb_popcount(delta[r] & ~bb->mine[r]);
+                bb->log[bb->log_len++] = delta[r];
+            }
+
+            bb->log[bb->log_len++] = (uint64_t) lo | ((uint64_t) (hi - lo + 1) << 8);
+
+            /* Se tutte le celle non contenenti una mina sono state visitate, allora vittoria. */
+            if (bb->nmnv_cnt == 0)
+                result = RESULT_VICTORY;
+
+            bb->instance++;
+
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/* msw_bb_undo annulla le ultime times mosse con la stessa semantica di
+ * msw_undo, ripercorrendo all'indietro il registro delle visite.
+ */
+int msw_bb_undo(msw_bb bb, int times) {
+    if (times > 0) {
+        int moves = bb->instance;
+
+        bb->instance -= times;
+
+        /* Non si può andare indietro rispetto l'istanza 1. */
+        if (bb->instance < 1)
+            bb->instance = 1;
+
+        for (moves -= bb->instance; moves > 0; moves--) {
+            uint64_t header = bb->log[--bb->log_len];
+            int lo = (int) (header & 0xff), r;
+
+            for (r = lo + (int) (header >> 8) - 1; r >= lo; r--) {
+                uint64_t delta = bb->log[--bb->log_len] & bb->visited[r];
+
+                bb->visited[r] &= ~delta;
+                bb->nmnv_cnt += msw_bb_popcount(delta & ~bb->mine[r]);
+            }
+        }
+
+        bb->undo_cnt++;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_bb_undo_incremental annulla le ultime n mosse con la stessa semantica
+ * di msw_undo_incremental.
+ */
+int msw_bb_undo_incremental(msw_bb bb) {
+    return msw_bb_undo(bb, bb->undo_cnt + 1);
+}
+
+/* msw_bb_to_field crea un campo equivalente al campo a bitboard, con le
+ * stesse modalità di msw_create, ricostruendo dal registro l'istanza di ogni
+ * visita, e restituisce vero se la creazione è avvenuta con successo.
+ */
+int msw_bb_to_field(msw_bb bb, msw_field *fieldptr) {
+    msw_field field = NULL;
+
+    if (msw_create(&field, bb->width, bb->height)) {
+        int x, y, instance = bb->instance - 1, pos = bb->log_len;
+
+        for (y = 0; y < bb->height; y++)
+            for (x = 0; x < bb->width; x++) {
+                uint64_t bit = (uint64_t) 1 << x;
+
+                if (bb->mine[y] & bit)
+                    msw_mine_cell(field, x, y);
+                if (bb->flag[y] & bit)
+                    msw_get_cell_rw(field, x, y)->visited = VISITED_FLAG;
+            }
+
+        /* Il registro viene percorso all'indietro, dall'ultima istanza alla prima. */
+        while (pos > 0) {
+            uint64_t header = bb->log[--pos];
+            int lo = (int) (header & 0xff), r;
+
+            for (r = lo + (int) (header >> 8) - 1; r >= lo; r--) {
+                uint64_t delta = bb->log[--pos] & bb->visited[r];
+
+                for (x = 0; x < bb->width; x++) {
+                    if (delta & ((uint64_t) 1 << x))
+                        msw_get_cell_rw(field, x, r)->visited = instance;
+                }
+            }
+
+            instance--;
+        }
+
+        field->flag_cnt = bb->flag_cnt;
+        field->nmnv_cnt = bb->nmnv_cnt;
+        field->instance = bb->instance;
+        field->undo_cnt = bb->undo_cnt;
+        msw_rehash(field);
+
+        msw_destroy(fieldptr);
+        *fieldptr = field;
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,333 @@
+#include <stdlib.h> /* malloc, calloc, free */
+#include <string.h> /* memcpy, memcmp, strlen */
+#include <fcntl.h> /* O_* */
+#include <sched.h> /* sched_yield */
+#include <unistd.h> /* ftruncate, close */
+#include <sys/mman.h> /* shm_open, shm_unlink, mmap, munmap */
+#include <sys/stat.h> /* fstat */
+#include "minesweeper.h"
+#include "feed.h"
+
+/* msw_feed_size restituisce la dimensione del segmento per un campo di
+ * dimensioni width e height.
+ */
+static size_t msw_feed_size(int width, int height) {
+    return sizeof(struct msw_feed_header_struct) + MSW_FEED_RING * sizeof(uint64_t) + (size_t) width * height;
+}
+
+/* msw_feed_map mappa il segmento aperto con il descrittore fd e dimensione
+ * size nel capo feed e restituisce vero se la mappatura è avvenuta con
+ * successo.
+ */
+static int msw_feed_map(msw_feed feed, int fd, size_t size, int prot) {
+    void *base = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+
+    if (base == MAP_FAILED)
+        return 0;
+
+    feed->header = (struct msw_feed_header_struct*) base;
+    feed->ring = (uint64_t*) (feed->header + 1);
+    feed->key = (unsigned char*) (feed->ring + MSW_FEED_RING);
+    feed->size = size;
+
+    return 1;
+}
+
+/* msw_feed_new crea un nuovo capo del canale con nome name, senza segmento. */
+static msw_feed msw_feed_new(const char *name) {
+    msw_feed feed = (msw_feed) calloc(1, sizeof(struct msw_feed_struct));
+
+    if (feed) {
+        size_t len = strlen(name) + 1;
+
+        feed->name = (char*) malloc(len);
+        if (!feed->name) {
+            free(feed);
+            return NULL;
+        }
+
+        memcpy(feed->name, name, len);
+    }
+
+    return feed;
+}
+
+/* msw_feed_key_begin e msw_feed_key_end delimitano una scrittura del
+ * fotogramma chiave: il contatore del seqlock resta dispari nel mezzo, così
+ * che un lettore che lo ha copiato nel frattempo ripeta la copia.
+ */
+static void msw_feed_key_begin(msw_feed feed) {
+    __atomic_store_n(&feed->header->key_seq, feed->header->key_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void msw_feed_key_end(msw_feed feed) {
+    __atomic_store_n(&feed->header->key_head, feed->position, __ATOMIC_RELAXED);
+    __atomic_store_n(&feed->header->key_seq, feed->header->key_seq + 1, __ATOMIC_RELEASE);
+}
+
+/* msw_feed_key_all riscrive l'intero fotogramma chiave dallo stato visibile
+ * del campo.
+ */
+static void msw_feed_key_all(msw_feed feed, msw_field field) {
+    unsigned char *key = feed->key;
+    int x, y;
+
+    msw_feed_key_begin(feed);
+
+    for (y = 0; y < field->height; y++)
+        for (x = 0; x < field->width; x++)
+            __atomic_store_n(key++, (unsigned char) msw_cell_state(field, x, y), __ATOMIC_RELAXED);
+
+    msw_feed_key_end(feed);
+}
+
+/* msw_feed_create crea il segmento name (sostituendo un eventuale segmento
+ * con lo stesso nome) per trasmettere la partita del campo, con lo stato
+ * visibile attuale come fotogramma chiave, crea il capo dello scrittore,
+ * assegna il puntatore a *feedptr (se *feedptr è un puntatore non nullo,
+ * viene prima distrutto il capo riferito da esso) e restituisce vero se la
+ * creazione è avvenuta con successo.
+ */
+int msw_feed_create(msw_feed *feedptr, const char *name, msw_field field) {
+    msw_feed feed = msw_feed_new(name);
+
+    if (feed) {
+        size_t size = msw_feed_size(field->width, field->height);
+        int fd, success;
+
+        /* I lettori del segmento precedente lo vedono chiuso dal suo
+         * scrittore; il nuovo segmento è vuoto finché non è pronto.
+         */
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        success = (fd >= 0);
+
+        if (success) {
+            success = (ftruncate(fd, (off_t) size) == 0 && msw_feed_map(feed, fd, size, PROT_READ | PROT_WRITE));
+            close(fd);
+
+            if (!success)
+                shm_unlink(name);
+        }
+
+        if (success) {
+            feed->writer = 1;
+            feed->header->width = field->width;
+            feed->header->height = field->height;
+            memcpy(feed->header->magic, MSW_FEED_MAGIC, sizeof(feed->header->magic));
+
+            /* La prima scrittura del fotogramma chiave rende pari e non nullo
+             * il contatore del seqlock: da qui il segmento è pronto.
+             */
+            msw_feed_key_all(feed, field);
+
+            msw_feed_destroy(feedptr);
+            *feedptr = feed;
+
+            return 1;
+        }
+
+        free(feed->name);
+        free(feed);
+    }
+
+    return 0;
+}
+
+/* msw_feed_attach apre in sola lettura il segmento name, crea un capo di
+ * lettura, assegna il puntatore a *feedptr (se *feedptr è un puntatore non
+ * nullo, viene prima distrutto il capo riferito da esso) e restituisce vero
+ * se l'apertura è avvenuta con successo. Il segmento deve essere pronto; il
+ * capo va sincronizzato con msw_feed_sync prima di seguire le modifiche.
+ */
+int msw_feed_attach(msw_feed *feedptr, const char *name) {
+    msw_feed feed = msw_feed_new(name);
+
+    if (feed) {
+        int fd = shm_open(name, O_RDONLY, 0);
+        struct stat st;
+        int success = (fd >= 0);
+
+        if (success) {
+            success = (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(struct msw_feed_header_struct) &&
+                       msw_feed_map(feed, fd, (size_t) st.st_size, PROT_READ));
+            close(fd);
+        }
+
+        /* Il contatore del seqlock diventa non nullo solo dopo la scrittura
+         * dell'intestazione.
+         */
+        if (success && (__atomic_load_n(&feed->header->key_seq, __ATOMIC_ACQUIRE) == 0 ||
+                        memcmp(feed->header->magic, MSW_FEED_MAGIC, sizeof(feed->header->magic)) != 0 ||
+                        feed->header->width < 1 || feed->header->height < 1 ||
+                        feed->size != msw_feed_size(feed->header->width, feed->header->height))) {
+            munmap(feed->header, feed->size);
+            success = 0;
+        }
+
+        if (success) {
+            msw_feed_destroy(feedptr);
+            *feedptr = feed;
+
+            return 1;
+        }
+
+        free(feed->name);
+        free(feed);
+    }
+
+    return 0;
+}
+
+/* msw_feed_destroy distrugge un capo precedentemente creato; il capo dello
+ * scrittore segnala ai lettori la chiusura e rimuove il segmento.
+ */
+void msw_feed_destroy(msw_feed *feedptr) {
+    if (*feedptr) {
+        msw_feed feed = *feedptr;
+
+        if (feed->writer) {
+            __atomic_store_n(&feed->header->closed, 1, __ATOMIC_RELEASE);
+            shm_unlink(feed->name);
+        }
+
+        munmap(feed->header, feed->size);
+        free(feed->name);
+        free(feed);
+
+        *feedptr = NULL;
+    }
+}
+
+/* msw_feed_publish pubblica le modifiche dello stato visibile del campo
+ * raccolte da msw_apply in buffer: le copia nel buffer circolare, rende
+ * visibile ai lettori il nuovo valore di head e le riporta sul fotogramma
+ * chiave. Se il buffer non contiene tutte le modifiche, il fotogramma chiave
+ * viene riscritto dall'intero campo. Il costo è proporzionale al numero di
+ * modifiche e non dipende dai lettori.
+ */
+void msw_feed_publish(msw_feed feed, msw_field field, const struct msw_delta_buffer_struct *buffer) {
+    long cells = (long) field->width * field->height, i;
+
+    if (buffer->overflow || buffer->cnt > MSW_FEED_RING / 2) {
+        feed->position += MSW_FEED_RING;
+        __atomic_store_n(&feed->header->head, feed->position, __ATOMIC_RELEASE);
+
+        if (buffer->overflow) {
+            msw_feed_key_all(feed, field);
+            return;
+        }
+    } else if (buffer->cnt > 0) {
+        /* Come nel seqlock del fotogramma chiave, le scritture nel buffer
+         * seguono la pubblicazione del valore precedente di head: un lettore
+         * che legge una modifica del nuovo giro, dopo la sua barriera
+         * acquire, vede almeno quel valore e si accorge di essere doppiato.
+         */
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        for (i = 0; i < buffer->cnt; i++)
+            __atomic_store_n(&feed->ring[(feed->position + i) & (MSW_FEED_RING - 1)], buffer->deltas[i],
+                             __ATOMIC_RELAXED);
+
+        feed->position += buffer->cnt;
+        __atomic_store_n(&feed->header->head, feed->position, __ATOMIC_RELEASE);
+    } else
+        return;
+
+    msw_feed_key_begin(feed);
+
+    for (i = 0; i < buffer->cnt; i++) {
+        long index = MSW_DELTA_INDEX(buffer->deltas[i]);
+
+        if (index < cells)
+            __atomic_store_n(&feed->key[index], (unsigned char) MSW_DELTA_STATE(buffer->deltas[i]), __ATOMIC_RELAXED);
+    }
+
+    msw_feed_key_end(feed);
+}
+
+/* msw_feed_sync copia il fotogramma chiave nel campo di sola visualizzazione
+ * *viewptr (creato, o ricreato se le dimensioni non corrispondono), porta il
+ * capo di lettura alla modifica a cui il fotogramma corrisponde e restituisce
+ * vero se l'operazione è avvenuta con successo. La copia viene ripetuta
+ * finché non risulta estranea a ogni scrittura.
+ */
+int msw_feed_sync(msw_feed feed, msw_field *viewptr) {
+    int width = feed->header->width, height = feed->header->height;
+    uint64_t seq, head = 0;
+
+    if ((!*viewptr || (*viewptr)->width != width || (*viewptr)->height != height) &&
+        !msw_create(viewptr, width, height))
+        return 0;
+
+    do {
+        const unsigned char *key = feed->key;
+        int x, y;
+
+        seq = __atomic_load_n(&feed->header->key_seq, __ATOMIC_ACQUIRE);
+        if (seq % 2 == 1) {
+            sched_yield();
+            continue;
+        }
+
+        for (y = 0; y < height; y++)
+            for (x = 0; x < width; x++) {
+                int state = __atomic_load_n(key++, __ATOMIC_RELAXED);
+
+                if (state <= STATE_MINE)
+                    msw_set_cell_state(*viewptr, x, y, state);
+            }
+
+        head = __atomic_load_n(&feed->header->key_head, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (seq % 2 == 1 || __atomic_load_n(&feed->header->key_seq, __ATOMIC_RELAXED) != seq);
+
+    feed->position = head;
+
+    return 1;
+}
+
+/* msw_feed_follow applica al campo di sola visualizzazione, sincronizzato con
+ * msw_feed_sync, le modifiche pubblicate dopo l'ultima lettura, assegna a
+ * *last (se last è un puntatore non nullo) la posizione della cella
+ * dell'ultima modifica applicata e restituisce il numero di modifiche
+ * applicate, oppure FEED_CLOSED se la partita è terminata e non ci sono altre
+ * modifiche, oppure FEED_LAPPED se il lettore è stato doppiato: in questo caso
+ * la vista non è affidabile e va sincronizzata di nuovo.
+ */
+long msw_feed_follow(msw_feed feed, msw_field view, long *last) {
+    long cells = (long) view->width * view->height;
+    uint64_t head = __atomic_load_n(&feed->header->head, __ATOMIC_ACQUIRE), i;
+
+    if ((int64_t) (head - feed->position) <= 0)
+        return (__atomic_load_n(&feed->header->closed, __ATOMIC_ACQUIRE) ? FEED_CLOSED : 0);
+
+    if (head - feed->position > MSW_FEED_RING / 2)
+        return FEED_LAPPED;
+
+    for (i = feed->position; i < head; i++) {
+        uint64_t delta = __atomic_load_n(&feed->ring[i & (MSW_FEED_RING - 1)], __ATOMIC_RELAXED);
+        long index = MSW_DELTA_INDEX(delta);
+        int state = MSW_DELTA_STATE(delta);
+
+        if (index < cells && state <= STATE_MINE) {
+            msw_set_cell_state(view, (int) (index % view->width), (int) (index / view->width), state);
+
+            if (last)
+                *last = index;
+        }
+    }
+
+    /* Le modifiche lette sono valide solo se nel frattempo lo scrittore non
+     * ha cominciato a sovrascriverle.
+     */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&feed->header->head, __ATOMIC_RELAXED) - feed->position > MSW_FEED_RING / 2)
+        return FEED_LAPPED;
+
+    i = head - feed->position;
+    feed->position = head;
+
+    return (long) i;
+}
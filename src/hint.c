@@ -0,0 +1,407 @@
+#include <stdlib.h> /* calloc, malloc, realloc, free */
+#include <string.h> /* memset, memcpy */
+#include "minesweeper.h"
+#include "solver.h"
+#include "sampler.h"
+#include "hint.h"
+
+/* msw_hint_stale verifica se la consegna gen è stata resa obsoleta da una
+ * consegna successiva o dalla terminazione del suggeritore.
+ */
+static int msw_hint_stale(msw_hint hint, unsigned long gen) {
+    int stale;
+
+    pthread_mutex_lock(&hint->lock);
+    stale = (hint->submitted != gen || hint->quit);
+    pthread_mutex_unlock(&hint->lock);
+
+    return stale;
+}
+
+/* msw_hint_risk stima la probabilità che la cella non visitata (x, y)
+ * contenga una mina: per ogni numero visitato adiacente, il rapporto tra le
+ * mine che mancano al numero e le celle adiacenti ad esso ancora
+ * indeterminate, considerando il più sfavorevole; density se la cella non è
+ * adiacente ad alcun numero.
+ */
+static double msw_hint_risk(msw_field field, msw_solver solver, int x, int y, double density) {
+    double risk = -1;
+    int x0, y0, x1, y1;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++)
+        for (x0 = x - 1; x0 <= x + 1; x0++) {
+            msw_cell cell = msw_get_cell(field, x0, y0);
+
+            if (cell && cell->visited > VISITED_NO && cell->content > CONTENT_EMPTY) {
+                int need = cell->content, unknown = 0;
+
+                for (y1 = y0 - 1; y1 <= y0 + 1; y1++)
+                    for (x1 = x0 - 1; x1 <= x0 + 1; x1++) {
+                        if (msw_cell_exists(field, x1, y1)) {
+                            int known = msw_solver_get(solver, x1, y1);
+
+                            if (known == SOLVER_MINE)
+                                need--;
+                            else if (known == SOLVER_UNKNOWN)
+                                unknown++;
+                        }
+                    }
+
+                if (unknown > 0 && (double) need / unknown > risk)
+                    risk = (double) need / unknown;
+            }
+        }
+
+    return (risk < 0 ? density : risk);
+}
+
+/* msw_hint_analyse analizza la copia di lavoro consegnata con il numero gen e
+ * compila *result. Restituisce falso se l'analisi non è riuscita o è stata
+ * interrotta perché obsoleta.
+ */
+static int msw_hint_analyse(msw_hint hint, unsigned long gen, struct msw_hint_result_struct *result) {
+    msw_field field = hint->work;
+    msw_sampler sampler = NULL;
+    long known_mines = 0, unknown = 0;
+    double density, best_risk = 2;
+    int x, y, mine_x = -1, mine_y = -1, guess_x = -1, guess_y = -1;
+
+    /* Il risolutore viene ricreato solamente se cambiano le dimensioni del
+     * campo, altrimenti viene aggiornato in modo incrementale.
+     */
+    if (!hint->solver || hint->solver->width != field->width || hint->solver->height != field->height) {
+        if (!msw_solver_create(&hint->solver, field))
+            return 0;
+    }
+
+    if (!msw_solver_update(hint->solver, field, &hint->work_deltas) || msw_hint_stale(hint, gen))
+        return 0;
+
+    result->kind = HINT_NONE;
+    result->safe_cnt = 0;
+    result->mine_cnt = 0;
+    result->risk = 0;
+    result->error = -1;
+
+    /* Conteggio delle celle determinate e delle celle indeterminate, per la
+     * densità delle mine lontano dai numeri.
+     */
+    for (y = 0; y < field->height; y++)
+        for (x = 0; x < field->width; x++) {
+            int known = msw_solver_get(hint->solver, x, y);
+            msw_cell cell = msw_get_cell(field, x, y);
+
+            if (known == SOLVER_MINE)
+                known_mines++;
+            else if (known == SOLVER_UNKNOWN)
+                unknown++;
+
+            if (cell->visited <= VISITED_NO) {
+                if (known == SOLVER_SAFE) {
+                    if (result->safe_cnt++ == 0) {
+                        result->x = x;
+                        result->y = y;
+                    }
+                } else if (known == SOLVER_MINE) {
+                    result->mine_cnt++;
+                    if (mine_x < 0 && cell->visited == VISITED_NO) {
+                        mine_x = x;
+                        mine_y = y;
+                    }
+                }
+            }
+        }
+
+    if (result->safe_cnt > 0) {
+        result->kind = HINT_SAFE;
+        return 1;
+    }
+
+    if (mine_x >= 0) {
+        result->kind = HINT_MINE;
+        result->x = mine_x;
+        result->y = mine_y;
+        result->risk = 1;
+        return 1;
+    }
+
+    density = (unknown > 0 ? (double) (msw_mine_total(field) - known_mines) / unknown : 1);
+
+    /* Stima delle frequenze con il campionatore, entro un tempo limitato; se
+     * non riesce, il rischio viene stimato localmente.
+     */
+    if (msw_sampler_create(&sampler, field) &&
+        !msw_sampler_run(sampler, MSW_HINT_SAMPLES, MSW_HINT_SAMPLE_MS, (uint64_t) gen))
+        msw_sampler_destroy(&sampler);
+
+    /* Ricerca della cella indeterminata con il rischio stimato minore, con un
+     * controllo di obsolescenza ad ogni riga.
+     */
+    for (y = 0; y < field->height; y++) {
+        if (msw_hint_stale(hint, gen)) {
+            msw_sampler_destroy(&sampler);
+            return 0;
+        }
+
+        for (x = 0; x < field->width; x++) {
+            if (msw_get_cell(field, x, y)->visited == VISITED_NO &&
+                msw_solver_get(hint->solver, x, y) == SOLVER_UNKNOWN) {
+                double risk = (sampler ? msw_sampler_get(sampler, x, y) :
+                               msw_hint_risk(field, hint->solver, x, y, density));
+
+                if (risk < best_risk) {
+                    best_risk = risk;
+                    guess_x = x;
+                    guess_y = y;
+                }
+            }
+        }
+    }
+
+    if (guess_x >= 0) {
+        result->kind = HINT_GUESS;
+        result->x = guess_x;
+        result->y = guess_y;
+        result->risk = best_risk;
+        if (sampler)
+            result->error = sampler->error;
+    }
+
+    msw_sampler_destroy(&sampler);
+
+    return 1;
+}
+
+/* msw_hint_main è il corpo del thread di analisi: attende una consegna, la
+ * prende in carico scambiandola con la copia di lavoro e la analizza,
+ * pubblicando il risultato solo se nel frattempo non è diventato obsoleto.
+ */
+static void *msw_hint_main(void *arg) {
+    msw_hint hint = (msw_hint) arg;
+
+    pthread_mutex_lock(&hint->lock);
+
+    while (!hint->quit) {
+        if (hint->submitted == hint->taken)
+            pthread_cond_wait(&hint->cond, &hint->lock);
+        else {
+            struct msw_hint_result_struct result;
+            msw_field field = hint->work;
+            unsigned char *rows = hint->work_rows;
+            struct msw_delta_buffer_struct deltas = hint->work_deltas;
+            unsigned long gen = hint->submitted;
+            int success;
+
+            hint->work = hint->pending;
+            hint->pending = field;
+            hint->work_rows = hint->pending_rows;
+            hint->pending_rows = rows;
+            hint->work_deltas = hint->pending_deltas;
+            hint->pending_deltas = deltas;
+            hint->pending_deltas.cnt = 0;
+            hint->pending_deltas.overflow = 0;
+            hint->taken = gen;
+
+            pthread_mutex_unlock(&hint->lock);
+            success = msw_hint_analyse(hint, gen, &result);
+            pthread_mutex_lock(&hint->lock);
+
+            if (success && hint->submitted == gen) {
+                hint->result = result;
+                hint->result_gen = gen;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&hint->lock);
+
+    return NULL;
+}
+
+/* msw_hint_create crea un nuovo suggeritore e avvia il suo thread di analisi,
+ * assegna il puntatore a *hintptr (se *hintptr è un puntatore non nullo, viene
+ * prima distrutto il suggeritore riferito da esso) e restituisce vero se la
+ * creazione è avvenuta con successo.
+ */
+int msw_hint_create(msw_hint *hintptr) {
+    msw_hint hint = (msw_hint) calloc(1, sizeof(struct msw_hint_struct));
+
+    if (hint) {
+        if (pthread_mutex_init(&hint->lock, NULL) == 0) {
+            if (pthread_cond_init(&hint->cond, NULL) == 0) {
+                if (pthread_create(&hint->thread, NULL, msw_hint_main, hint) == 0) {
+                    msw_hint_destroy(hintptr);
+                    *hintptr = hint;
+
+                    return 1;
+                }
+
+                pthread_cond_destroy(&hint->cond);
+            }
+
+            pthread_mutex_destroy(&hint->lock);
+        }
+
+        free(hint);
+    }
+
+    return 0;
+}
+
+/* msw_hint_destroy termina il thread di analisi (attendendo al più il
+ * prossimo controllo di obsolescenza) e distrugge il suggeritore.
+ */
+void msw_hint_destroy(msw_hint *hintptr) {
+    if (*hintptr) {
+        msw_hint hint = *hintptr;
+
+        pthread_mutex_lock(&hint->lock);
+        hint->quit = 1;
+        pthread_cond_signal(&hint->cond);
+        pthread_mutex_unlock(&hint->lock);
+
+        pthread_join(hint->thread, NULL);
+
+        msw_destroy(&hint->pending);
+        msw_destroy(&hint->work);
+        free(hint->pending_rows);
+        free(hint->work_rows);
+        free(hint->pending_deltas.deltas);
+        free(hint->work_deltas.deltas);
+        msw_solver_destroy(&hint->solver);
+        pthread_cond_destroy(&hint->cond);
+        pthread_mutex_destroy(&hint->lock);
+        free(hint);
+
+        *hintptr = NULL;
+    }
+}
+
+/* msw_hint_touch segna come modificate in entrambe le copie le righe
+ * toccate dalle modifiche in buffer, oppure tutte le righe se buffer è NULL o
+ * incompleto, e restituisce falso se non è riuscito ad allocare gli array
+ * delle righe. Le mine piazzate in modo differito attorno a una cella
+ * visitata cambiano i numeri (nascosti) fino a due righe di distanza da
+ * essa.
+ */
+static int msw_hint_touch(msw_hint hint, msw_field field, struct msw_delta_buffer_struct *buffer) {
+    long i;
+    int y;
+
+    if (hint->row_cnt != field->height) {
+        free(hint->pending_rows);
+        free(hint->work_rows);
+        hint->pending_rows = (unsigned char*) malloc(field->height);
+        hint->work_rows = (unsigned char*) malloc(field->height);
+        hint->row_cnt = 0;
+
+        if (!hint->pending_rows || !hint->work_rows)
+            return 0;
+
+        hint->row_cnt = field->height;
+        buffer = NULL;
+    }
+
+    if (!buffer || buffer->overflow) {
+        memset(hint->pending_rows, 1, field->height);
+        memset(hint->work_rows, 1, field->height);
+    } else {
+        for (i = 0; i < buffer->cnt; i++) {
+            int row = (int) (MSW_DELTA_INDEX(buffer->deltas[i]) / field->width);
+
+            for (y = row - 2; y <= row + 2; y++) {
+                if (y >= 0 && y < field->height) {
+                    hint->pending_rows[y] = 1;
+                    hint->work_rows[y] = 1;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* msw_hint_record aggiunge le modifiche in buffer a quelle accumulate per la
+ * prossima presa in carico; se buffer è NULL o incompleto, se le modifiche
+ * superano le celle del campo o se non è possibile allocarle, le modifiche
+ * accumulate vengono segnate come incomplete e il risolutore scorrerà
+ * l'intero campo.
+ */
+static void msw_hint_record(msw_hint hint, msw_field field, struct msw_delta_buffer_struct *buffer) {
+    struct msw_delta_buffer_struct *deltas = &hint->pending_deltas;
+    long cnt;
+
+    if (deltas->overflow)
+        return;
+
+    if (!buffer || buffer->overflow) {
+        deltas->overflow = 1;
+        return;
+    }
+
+    cnt = deltas->cnt + buffer->cnt;
+    if (cnt > (long) field->width * field->height) {
+        deltas->overflow = 1;
+        return;
+    }
+
+    if (cnt > deltas->cap) {
+        long cap = (cnt > 2 * deltas->cap ? cnt : 2 * deltas->cap);
+        uint64_t *array = (uint64_t*) realloc(deltas->deltas, cap * sizeof(uint64_t));
+
+        if (!array) {
+            deltas->overflow = 1;
+            return;
+        }
+
+        deltas->deltas = array;
+        deltas->cap = cap;
+    }
+
+    if (buffer->cnt > 0)
+        memcpy(deltas->deltas + deltas->cnt, buffer->deltas, buffer->cnt * sizeof(uint64_t));
+    deltas->cnt = cnt;
+}
+
+/* msw_hint_submit consegna al thread di analisi una copia dello stato attuale
+ * del campo, rendendo obsoleta l'analisi in corso, e restituisce vero se la
+ * copia è avvenuta con successo. Va chiamata dal thread che modifica il campo,
+ * dopo ogni modifica, con il buffer in cui msw_apply ha registrato le
+ * modifiche (NULL per la prima consegna o per modifiche non registrate): la
+ * copia costa solamente le righe modificate.
+ */
+int msw_hint_submit(msw_hint hint, msw_field field, struct msw_delta_buffer_struct *buffer) {
+    int success;
+
+    pthread_mutex_lock(&hint->lock);
+
+    success = msw_hint_touch(hint, field, buffer) && msw_copy_rows(&hint->pending, field, hint->pending_rows);
+    if (success) {
+        memset(hint->pending_rows, 0, field->height);
+        msw_hint_record(hint, field, buffer);
+        hint->submitted++;
+        pthread_cond_signal(&hint->cond);
+    }
+
+    pthread_mutex_unlock(&hint->lock);
+
+    return success;
+}
+
+/* msw_hint_get copia in *result il risultato dell'analisi dell'ultima copia
+ * consegnata e restituisce vero, oppure restituisce falso se l'analisi non è
+ * ancora terminata.
+ */
+int msw_hint_get(msw_hint hint, struct msw_hint_result_struct *result) {
+    int ready;
+
+    pthread_mutex_lock(&hint->lock);
+
+    ready = (hint->submitted > 0 && hint->result_gen == hint->submitted);
+    if (ready)
+        *result = hint->result;
+
+    pthread_mutex_unlock(&hint->lock);
+
+    return ready;
+}
@@ -0,0 +1,234 @@
+#include <stdlib.h> /* malloc, calloc, realloc, free, labs */
+#include "minesweeper.h"
+#include "history.h"
+
+/* msw_history_put imposta la cella di posizione index della vista in modo
+ * che il suo stato visibile sia state.
+ */
+static void msw_history_put(msw_field view, long index, int state) {
+    msw_set_cell_state(view, (int) (index % view->width), (int) (index / view->width), state);
+}
+
+/* msw_history_reserve assicura che l'array *arrayptr, di capacità *capptr
+ * elementi di dimensione size, possa contenere almeno need elementi,
+ * raddoppiandone la capacità se necessario, e restituisce vero se
+ * l'operazione è avvenuta con successo.
+ */
+static int msw_history_reserve(void **arrayptr, long *capptr, long need, size_t size) {
+    if (need > *capptr) {
+        long cap = (*capptr > 0 ? *capptr : 16);
+        void *array;
+
+        while (cap < need)
+            cap *= 2;
+
+        array = realloc(*arrayptr, cap * size);
+        if (!array)
+            return 0;
+
+        *arrayptr = array;
+        *capptr = cap;
+    }
+
+    return 1;
+}
+
+/* msw_history_key salva un fotogramma chiave dello stato dopo l'ultima mossa
+ * registrata e restituisce vero se il salvataggio è avvenuto con successo.
+ */
+static int msw_history_key(msw_history history) {
+    long cells = (long) history->width * history->height, i;
+    unsigned char *states;
+
+    if (!msw_history_reserve((void**) &history->keys, &history->key_cap, history->key_cnt + 1,
+                             sizeof(struct msw_history_key_struct)))
+        return 0;
+
+    states = (unsigned char*) calloc((cells + 1) / 2, 1);
+    if (!states)
+        return 0;
+
+    for (i = 0; i < cells; i++)
+        states[i / 2] |= history->head[i] << (i % 2 * 4);
+
+    history->keys[history->key_cnt].step = history->step_cnt;
+    history->keys[history->key_cnt].states = states;
+    history->key_cnt++;
+
+    return 1;
+}
+
+/* msw_history_create crea una nuova cronologia che comincia dallo stato
+ * visibile attuale del campo, assegna il puntatore a *historyptr (se
+ * *historyptr è un puntatore non nullo, viene prima distrutta la cronologia
+ * riferita da esso) e restituisce vero se la creazione è avvenuta con
+ * successo.
+ */
+int msw_history_create(msw_history *historyptr, msw_field field) {
+    msw_history history = (msw_history) calloc(1, sizeof(struct msw_history_struct));
+
+    if (history) {
+        long cells = (long) field->width * field->height;
+
+        history->width = field->width;
+        history->height = field->height;
+        history->head = (unsigned char*) malloc(cells);
+
+        if (history->head && msw_create(&history->view, field->width, field->height) &&
+            msw_history_reserve((void**) &history->steps, &history->step_cap, 1, sizeof(long))) {
+            int x, y;
+
+            for (y = 0; y < field->height; y++)
+                for (x = 0; x < field->width; x++) {
+                    long index = (long) y * field->width + x;
+
+                    history->head[index] = msw_cell_state(field, x, y);
+                    msw_history_put(history->view, index, history->head[index]);
+                }
+
+            history->steps[0] = 0;
+
+            if (msw_history_key(history)) {
+                msw_history_destroy(historyptr);
+                *historyptr = history;
+
+                return 1;
+            }
+        }
+
+        msw_history_destroy(&history);
+    }
+
+    return 0;
+}
+
+/* msw_history_destroy distrugge una cronologia precedentemente creata. */
+void msw_history_destroy(msw_history *historyptr) {
+    if (*historyptr) {
+        msw_history history = *historyptr;
+        long i;
+
+        for (i = 0; i < history->key_cnt; i++)
+            free(history->keys[i].states);
+
+        free(history->keys);
+        free(history->steps);
+        free(history->log);
+        free(history->head);
+        msw_destroy(&history->view);
+        free(history);
+
+        *historyptr = NULL;
+    }
+}
+
+/* msw_history_record registra come nuova mossa le modifiche dello stato
+ * visibile del campo raccolte da msw_apply in buffer e restituisce vero se la
+ * registrazione è avvenuta con successo. Le mosse che non modificano lo stato
+ * visibile non vengono registrate. Se il buffer non contiene tutte le
+ * modifiche, o se la registrazione precedente non è riuscita, le modifiche
+ * vengono ricavate confrontando l'intero campo con l'ultimo stato registrato.
+ */
+int msw_history_record(msw_history history, msw_field field, const struct msw_delta_buffer_struct *buffer) {
+    long cells = (long) history->width * history->height, start = history->log_cnt, i;
+    int full = (history->resync || buffer->overflow);
+
+    if (!msw_history_reserve((void**) &history->log, &history->log_cap,
+                             history->log_cnt + (full ? cells : buffer->cnt), sizeof(uint64_t)) ||
+        !msw_history_reserve((void**) &history->steps, &history->step_cap, history->step_cnt + 2, sizeof(long))) {
+        history->resync = 1;
+        return 0;
+    }
+
+    if (full) {
+        int x, y;
+
+        for (y = 0; y < field->height; y++)
+            for (x = 0; x < field->width; x++) {
+                long index = (long) y * field->width + x;
+                int state = msw_cell_state(field, x, y);
+
+                if (history->head[index] != state) {
+                    history->log[history->log_cnt++] = MSW_HISTORY_ENTRY(index, history->head[index], state);
+                    history->head[index] = state;
+                }
+            }
+    } else
+        for (i = 0; i < buffer->cnt; i++) {
+            long index = MSW_DELTA_INDEX(buffer->deltas[i]);
+            int state = MSW_DELTA_STATE(buffer->deltas[i]);
+
+            if (history->head[index] != state) {
+                history->log[history->log_cnt++] = MSW_HISTORY_ENTRY(index, history->head[index], state);
+                history->head[index] = state;
+            }
+        }
+
+    history->resync = 0;
+
+    if (history->log_cnt > start) {
+        history->steps[++history->step_cnt] = history->log_cnt;
+
+        /* Un fotogramma chiave non salvato rende solamente più lunghi gli
+         * spostamenti.
+         */
+        if (history->log_cnt - history->steps[history->keys[history->key_cnt - 1].step] >=
+            cells / MSW_HISTORY_KEY_RATIO)
+            msw_history_key(history);
+    }
+
+    return 1;
+}
+
+/* msw_history_seek porta la vista alla mossa step (0 per lo stato iniziale,
+ * entro il numero di mosse registrate), applicando le modifiche a partire
+ * dalla mossa mostrata oppure dal fotogramma chiave più vicino, se il
+ * ripristino di quest'ultimo costa meno: il ripristino scrive tutte le
+ * width * height celle e viene contato come altrettante modifiche.
+ */
+void msw_history_seek(msw_history history, long step) {
+    long cells = (long) history->width * history->height, current, target, lo, hi, i;
+    struct msw_history_key_struct *key;
+
+    if (step < 0)
+        step = 0;
+    else if (step > history->step_cnt)
+        step = history->step_cnt;
+
+    current = history->steps[history->position];
+    target = history->steps[step];
+
+    /* Ricerca binaria dell'ultimo fotogramma chiave non successivo a step,
+     * confrontato con il primo successivo.
+     */
+    lo = 0;
+    hi = history->key_cnt - 1;
+    while (lo < hi) {
+        long mid = (lo + hi + 1) / 2;
+
+        if (history->keys[mid].step <= step)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    key = history->keys + lo;
+    if (lo + 1 < history->key_cnt &&
+        history->steps[history->keys[lo + 1].step] - target < target - history->steps[key->step])
+        key = history->keys + lo + 1;
+
+    if (cells + labs(history->steps[key->step] - target) < labs(current - target)) {
+        for (i = 0; i < cells; i++)
+            msw_history_put(history->view, i, (key->states[i / 2] >> (i % 2 * 4)) & 15);
+
+        current = history->steps[key->step];
+    }
+
+    for (i = current; i < target; i++)
+        msw_history_put(history->view, MSW_HISTORY_INDEX(history->log[i]), MSW_HISTORY_TO(history->log[i]));
+
+    for (i = current - 1; i >= target; i--)
+        msw_history_put(history->view, MSW_HISTORY_INDEX(history->log[i]), MSW_HISTORY_FROM(history->log[i]));
+
+    history->position = step;
+}
@@ -1,13 +1,32 @@
 #include <stdio.h> /* Gestione di files */
-#include <stdlib.h> /* srand */
-#include <time.h> /* time */
+#include <stdlib.h> /* srand, malloc, free */
+#include <time.h> /* time, clock_gettime */
+#include <unistd.h> /* access */
 #include "minesweeper.h"
 #include "ui.h"
+#include "hint.h"
+#include "autosave.h"
+#include "history.h"
+#include "feed.h"
 #include "main.h"
 
 /* Il campo minato corrente. */
 msw_field field = NULL;
 
+/* Il buffer delle modifiche di msw_apply, la cronologia della partita in
+ * corso e il canale per gli spettatori.
+ */
+static struct msw_delta_buffer_struct deltas;
+static msw_history history = NULL;
+static msw_feed feed = NULL;
+
+/* La selezione in corso di reveal. */
+static msw_reveal selection = NULL;
+
+/* Il salvataggio automatico e il suggeritore della partita in corso. */
+static msw_autosave autosave = NULL;
+static msw_hint hint = NULL;
+
 int main() {
     int quit = 0;
 
@@ -17,7 +36,7 @@ int main() {
 
     do {
         /* Menu principale. */
-        int action = ui_main_menu(field != NULL);
+        int action = ui_main_menu(field != NULL, access(AUTOSAVE_FILE_NAME, F_OK) == 0);
 
         switch (action) {
             case ACTION_NEW: {
@@ -32,27 +51,43 @@ int main() {
                 success = msw_create_random(&field, width, height, mines);
 
                 if (success)
-                    game();
+                    game(0);
                 else
                     ui_message("Non sono riuscito a creare il campo.");
             }
             break;
             case ACTION_LOAD: {
-                /* Apertura del file SAVE_FILE_NAME per la lettura e msw_create_from_file. */
+                /* Apertura del file SAVE_FILE_NAME per la lettura e msw_create_from_stream. */
                 FILE *fp = fopen(SAVE_FILE_NAME, "r");
 
                 if (fp != NULL) {
-                    int success = msw_create_from_file(&field, fp);
+                    long line, column;
+                    int success = msw_create_from_stream(&field, fp, &line, &column);
                     fclose(fp);
 
                     if (success)
-                        game();
-                    else
+                        game(0);
+                    else if (line > 0) {
+                        char message[80];
+
+                        sprintf(message, "Campo non valido alla riga %ld, colonna %ld.", line, column);
+                        ui_message(message);
+                    } else
                         ui_message("Non sono riuscito a caricare il campo.");
                 } else
                     ui_message("Non sono riuscito ad aprire il file di salvataggio per la lettura.");
             }
             break;
+            case ACTION_RESUME: {
+                /* Ripresa della partita dal salvataggio automatico. */
+                int lives;
+
+                if (msw_autosave_load(&field, AUTOSAVE_FILE_NAME, &lives))
+                    game(lives);
+                else
+                    ui_message("Non sono riuscito a riprendere la partita.");
+            }
+            break;
             case ACTION_SAVE: {
                 /* Apertura del file SAVE_FILE_NAME per la scrittura e msw_write_to_file. */
                 FILE *fp = fopen(SAVE_FILE_NAME, "w");
@@ -82,29 +117,190 @@ int main() {
     return 0;
 }
 
-/* game è la procedura di gioco. */
-void game() {
-    int x = 0, y = 0, lives, quit = 0;
+/* record registra nella cronologia, pubblica agli spettatori e consegna al
+ * suggeritore le modifiche dell'ultima mossa, contenute in deltas.
+ */
+static void record() {
+    if (history)
+        msw_history_record(history, field, &deltas);
+    if (feed)
+        msw_feed_publish(feed, field, &deltas);
+    if (hint)
+        msw_hint_submit(hint, field, &deltas);
+}
+
+/* apply esegue sul campo corrente l'azione type sulla cella (x, y) con
+ * msw_apply, la registra nella cronologia, la pubblica agli spettatori e ne
+ * restituisce il risultato.
+ */
+static int apply(int type, int x, int y) {
+    struct msw_action_struct action;
+
+    action.type = type;
+    action.x = x;
+    action.y = y;
+
+    msw_apply(field, &action, 1, &deltas);
+    record();
+
+    return action.result;
+}
+
+/* now_ms restituisce il tempo corrente in millisecondi, da un orologio
+ * monotono.
+ */
+static long now_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* reveal_step è la funzione della modalità di apertura: prosegue la
+ * selezione in corso a passi di MSW_REVEAL_SLICE celle per al più
+ * REVEAL_SLICE_MS millisecondi e restituisce il numero di celle aperte,
+ * oppure -1 se l'apertura è completa.
+ */
+static long reveal_step(msw_field view) {
+    long start = now_ms();
+
+    while (msw_reveal_step(selection, MSW_REVEAL_SLICE)) {
+        if (now_ms() - start >= REVEAL_SLICE_MS)
+            return selection->visited;
+    }
+
+    return -1;
+}
+
+/* reveal seleziona la cella (*x, *y) del campo corrente come apply, ma a
+ * passi: se l'apertura non si completa entro REVEAL_SLICE_MS millisecondi,
+ * il campo viene ridisegnato mentre si espande, con il cursore (che il
+ * giocatore può spostare) in (*x, *y) e la possibilità di sospendere
+ * l'apertura. Le modifiche di tutti i passi vengono registrate e pubblicate
+ * come un'unica mossa.
+ */
+static int reveal(int *x, int *y) {
+    int result;
+
+    if (!msw_reveal_begin(&selection, field, *x, *y, &deltas))
+        return apply(MSW_ACTION_SELECT, *x, *y);
+
+    if (reveal_step(field) >= 0) {
+        ui_set_reveal(reveal_step);
+        ui_minesweeper(field, x, y, UI_REVEAL);
+    }
+
+    result = msw_reveal_finish(&selection);
+    record();
+
+    return result;
+}
+
+/* replay è la procedura di revisione della partita: comincia dall'ultima
+ * mossa e permette di spostarsi tra le mosse registrate nella cronologia,
+ * con il cursore in (x, y), senza modificare il campo.
+ */
+static void replay(int x, int y) {
+    int action;
+
+    msw_history_seek(history, history->step_cnt);
+
+    do {
+        ui_replay_position(history->position, history->step_cnt);
+        action = ui_minesweeper(history->view, &x, &y, UI_REPLAY);
+
+        if (action == ACTION_SEEK)
+            msw_history_seek(history, history->position + ui_seek_steps());
+    } while (action != ACTION_REPLAY);
+}
+
+/* idle è la funzione chiamata dall'interfaccia mentre attende l'input:
+ * consegna al salvataggio automatico le mosse rimandate, così che vengano
+ * salvate anche se il giocatore si ferma.
+ */
+static void idle() {
+    if (autosave)
+        msw_autosave_tick(autosave, field);
+}
+
+/* game è la procedura di gioco. Se lives è 0, il numero di vite viene
+ * chiesto al giocatore, altrimenti la partita riprende con lives vite.
+ */
+void game(int lives) {
+    int x = 0, y = 0, quit = 0, over = 0, changed = 1, save_failed = 0;
 
     /* Input del numero di vite (tentativi permessi). */
-    lives = ui_input_range("Numero di vite [1,5]", 1, 5);
+    if (lives == 0)
+        lives = ui_input_range("Numero di vite [1,5]", 1, 5);
+
+    /* Azzeramento dell'orologio di gioco. */
+    ui_clock_reset();
+
+    /* Avvio del suggeritore, che analizza il campo mentre si attende l'input,
+     * con la consegna completa del campo iniziale (le mosse successive
+     * vengono consegnate da record).
+     */
+    if (msw_hint_create(&hint))
+        msw_hint_submit(hint, field, NULL);
+
+    /* Avvio del salvataggio automatico, con le mosse rimandate consegnate
+     * durante l'attesa dell'input.
+     */
+    msw_autosave_create(&autosave, AUTOSAVE_FILE_NAME);
+    ui_set_idle(idle);
+
+    /* Avvio della cronologia, con un buffer sufficiente per le modifiche di
+     * qualsiasi mossa (senza buffer, la cronologia confronta l'intero campo
+     * ad ogni mossa).
+     */
+    deltas.deltas = (uint64_t*) malloc((size_t) field->width * field->height * sizeof(uint64_t));
+    deltas.cap = (deltas.deltas ? (long) field->width * field->height : 0);
+    msw_history_create(&history, field);
+
+    /* Apertura del canale per gli spettatori. */
+    msw_feed_create(&feed, MSW_FEED_NAME, field);
 
     do {
+        int action;
+
+        /* Consegna al salvataggio automatico del campo appena modificato (il
+         * salvataggio copia il campo solo periodicamente).
+         */
+        if (changed && autosave)
+            msw_autosave_submit(autosave, field, lives, 0);
+        changed = 0;
+
+        /* Segnalazione di un salvataggio automatico non riuscito, una volta
+         * finché non ne riesce uno.
+         */
+        if (autosave && msw_autosave_failed(autosave) != save_failed) {
+            save_failed = !save_failed;
+            if (save_failed)
+                ui_message("Il salvataggio automatico non è riuscito.");
+        }
+
         /* Visualizzazione del campo e attesa dell'azione da input. */
-        int action = ui_minesweeper(field, &x, &y, 0);
+        action = ui_minesweeper(field, &x, &y, UI_PLAY);
 
         switch (action) {
-            case ACTION_SELECT: {
-                /* Selezione della cella (x, y). */
-                int result = msw_select_cell(field, x, y);
+            case ACTION_SELECT:
+            case ACTION_CHORD: {
+                /* Selezione della cella (x, y), oppure delle celle adiacenti al
+                 * numero (x, y) se le bandiere attorno ad esso sono complete.
+                 */
+                int result = (action == ACTION_SELECT ? reveal(&x, &y) : apply(MSW_ACTION_CHORD, x, y));
+
+                changed = 1;
 
                 if (result == RESULT_VICTORY || result == RESULT_DEFEAT) {
-                    /* Marcatura di tutte le celle contenenti una mina se vittoria. */
-                    if (result == RESULT_VICTORY)
-                        msw_mark_mine_cells(field);
+                    /* Marcatura di tutte le celle contenenti una mina se vittoria,
+                     * visualizzazione se sconfitta.
+                     */
+                    apply(result == RESULT_VICTORY ? MSW_ACTION_MARK_MINES : MSW_ACTION_SHOW_MINES, 0, 0);
 
                     /* Visualizzazione finale del campo. */
-                    ui_minesweeper(field, &x, &y, 1);
+                    ui_minesweeper(field, &x, &y, UI_DRAW);
                     ui_sleep(2000);
 
                     /* Decremento del numero di vite se sconfitta. */
@@ -113,22 +309,81 @@ void game() {
 
                     /* Menu di gioco. */
                     if (ui_game_menu(result == RESULT_VICTORY ? GMENU_VICTORY : GMENU_DEFEAT, lives) == ACTION_CONTINUE)
-                        msw_undo_incremental(field);
-                    else
+                        apply(MSW_ACTION_UNDO, field->undo_cnt + 1, 0);
+                    else {
+                        over = 1;
                         quit = 1;
+                    }
                 }
             }
             break;
             case ACTION_MARK: {
                 /* Marcatura della cella (x, y). */
-                msw_mark_cell(field, x, y);
+                apply(MSW_ACTION_MARK, x, y);
+                changed = 1;
+            }
+            break;
+            case ACTION_HINT: {
+                /* Visualizzazione dell'ultimo suggerimento, con il cursore
+                 * spostato sulla cella suggerita.
+                 */
+                struct msw_hint_result_struct result;
+
+                if (!hint)
+                    ui_message("Suggerimenti non disponibili.");
+                else if (!msw_hint_get(hint, &result))
+                    ui_message("Analisi in corso, riprova tra poco.");
+                else if (result.kind == HINT_NONE)
+                    ui_message("Nessun suggerimento.");
+                else {
+                    char message[80];
+
+                    x = result.x;
+                    y = result.y;
+
+                    if (result.kind == HINT_SAFE)
+                        sprintf(message, "La cella evidenziata non contiene mine (%ld sicure).", result.safe_cnt);
+                    else if (result.kind == HINT_MINE)
+                        sprintf(message, "La cella evidenziata contiene una mina.");
+                    else if (result.error >= 0)
+                        sprintf(message, "Nessuna cella sicura: rischio minimo %d%% (±%d%%).",
+                                (int) (result.risk * 100 + 0.5), (int) (result.error * 100 + 0.5));
+                    else
+                        sprintf(message, "Nessuna cella sicura: rischio minimo %d%%.", (int) (result.risk * 100 + 0.5));
+
+                    ui_message(message);
+                }
+            }
+            break;
+            case ACTION_REPLAY: {
+                /* Revisione della partita. */
+                if (history)
+                    replay(x, y);
+                else
+                    ui_message("Cronologia non disponibile.");
             }
             break;
             case ACTION_PAUSE: {
-                /* Menu di gioco. */
+                /* Salvataggio forzato e menu di gioco. */
+                if (autosave)
+                    msw_autosave_submit(autosave, field, lives, 1);
+
                 if (ui_game_menu(GMENU_PAUSE, 0) == ACTION_QUIT)
                     quit = 1;
             }
         }
     } while (!quit);
+
+    msw_hint_destroy(&hint);
+    msw_history_destroy(&history);
+    msw_feed_destroy(&feed);
+    free(deltas.deltas);
+
+    /* Attesa dell'ultimo salvataggio; una partita terminata non può essere
+     * ripresa.
+     */
+    ui_set_idle(NULL);
+    msw_autosave_destroy(&autosave);
+    if (over)
+        remove(AUTOSAVE_FILE_NAME);
 }
@@ -1,383 +1,2454 @@
 #include <stdio.h> /* Gestione di I/O e files */
 #include <stdlib.h> /* malloc, free, rand */
+#include <string.h> /* memcpy, memset, memchr, memmove */
+#include <limits.h> /* INT_MAX */
+#include <fcntl.h> /* open */
+#include <unistd.h> /* ftruncate, close, unlink, sysconf */
+#include <sys/mman.h> /* mmap, munmap, madvise */
+#include <pthread.h> /* pthread_create, pthread_join, pthread_mutex_t, pthread_cond_t */
 #include "minesweeper.h"
 
+/* Le funzioni di allocazione e deallocazione correnti del motore. */
+static msw_alloc_fn msw_alloc = malloc;
+static msw_free_fn msw_free = free;
+
+/* msw_set_allocator imposta le funzioni di allocazione e deallocazione usate
+ * dal motore per i campi creati da ora in poi (se una delle due è nulla,
+ * vengono ripristinate malloc e free). Un campo deve essere distrutto con le
+ * stesse funzioni con cui è stato creato.
+ */
+void msw_set_allocator(msw_alloc_fn alloc_fn, msw_free_fn free_fn) {
+    if (alloc_fn && free_fn) {
+        msw_alloc = alloc_fn;
+        msw_free = free_fn;
+    } else {
+        msw_alloc = malloc;
+        msw_free = free;
+    }
+}
+
+/* Il numero di thread usati dalle operazioni parallele (0 per il numero di
+ * processori disponibili).
+ */
+static int msw_threads = 0;
+
+/* msw_set_threads imposta il numero di thread usati per costruire i grandi
+ * campi (msw_create_seeded), per espandere le grandi aperture e per
+ * campionare gli schemi coerenti (msw_sampler_run): 0 per usare
+ * il numero di processori disponibili (al più MSW_PARALLEL_MAX), 1 per
+ * lavorare sempre sequenzialmente.
+ */
+void msw_set_threads(int threads) {
+    msw_threads = (threads < 0 ? 0 : threads > MSW_PARALLEL_MAX ? MSW_PARALLEL_MAX : threads);
+}
+
+/* msw_thread_count restituisce il numero di thread da usare per le
+ * operazioni parallele.
+ */
+int msw_thread_count(void) {
+    long cpus;
+
+    if (msw_threads > 0)
+        return msw_threads;
+
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (cpus < 1 ? 1 : cpus > MSW_PARALLEL_MAX ? MSW_PARALLEL_MAX : (int) cpus);
+}
+
+/* msw_grid_offset restituisce la posizione dell'array delle righe all'interno
+ * della memoria di un campo, allineata alla dimensione di un puntatore.
+ */
+static size_t msw_grid_offset() {
+    return (sizeof(struct msw_field_struct) + sizeof(msw_cell) - 1) / sizeof(msw_cell) * sizeof(msw_cell);
+}
+
+/* msw_required_size restituisce la dimensione in byte della memoria
+ * necessaria per un campo width * height (la struttura, l'array delle righe e
+ * le celle in un unico blocco), oppure 0 se le dimensioni non sono valide.
+ */
+size_t msw_required_size(int width, int height) {
+    /* La dimensione minima del campo è 2x2. */
+    if (width > 1 && height > 1)
+        return msw_grid_offset() + (size_t) height * sizeof(msw_cell) +
+            (size_t) width * height * sizeof(struct msw_cell_struct);
+    return 0;
+}
+
+/* msw_init_storage inizializza un campo vuoto nella memoria puntata da
+ * buffer, di dimensione almeno msw_required_size(width, height), e ne
+ * restituisce il puntatore. Se clear è falso, le celle e i contatori non
+ * vengono inizializzati: se ne occupa il chiamante.
+ */
+static msw_field msw_init_storage(void *buffer, int width, int height, int storage, int clear) {
+    msw_field field = (msw_field) buffer;
+    msw_cell cells;
+    int i;
+
+    field->grid = (msw_grid) ((char*) buffer + msw_grid_offset());
+    field->width = width;
+    field->height = height;
+    field->storage = storage;
+    field->row_owned = NULL;
+    field->map = NULL;
+    field->map_size = 0;
+    field->map_fd = -1;
+    field->mines = NULL;
+    field->mine_cap = 0;
+    field->lazy = LAZY_NONE;
+    field->lazy_mines = 0;
+    field->committed = NULL;
+    field->committed_cnt = 0;
+    field->delta = NULL;
+
+    /* Le righe della griglia sono contigue e seguono l'array delle righe. */
+    cells = (msw_cell) (field->grid + height);
+    for (i = 0; i < height; i++)
+        field->grid[i] = cells + (size_t) i * width;
+
+    if (clear)
+        msw_reset(field);
+
+    return field;
+}
+
+/* msw_create_in_buffer crea un nuovo campo vuoto con le stesse modalità di
+ * msw_create, ma nella memoria fornita dal chiamante (buffer, di dimensione
+ * size, allineata come un puntatore), senza alcuna allocazione per la
+ * griglia (l'indice delle mine viene allocato al primo piazzamento e poi
+ * riutilizzato). La memoria deve restare valida finché il campo non viene
+ * distrutto, e msw_destroy non la dealloca.
+ */
+int msw_create_in_buffer(msw_field *fieldptr, void *buffer, size_t size, int width, int height) {
+    size_t required = msw_required_size(width, height);
+
+    if (buffer && required > 0 && size >= required) {
+        /* Il campo precedente viene distrutto per primo, poiché potrebbe
+         * trovarsi nella stessa memoria.
+         */
+        msw_destroy(fieldptr);
+        *fieldptr = msw_init_storage(buffer, width, height, STORAGE_BUFFER, 1);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_create_reserved crea un campo come msw_create, ma prima di qualsiasi
+ * modifica riserva lo spazio per mines mine nell'indice delle mine e, se lazy
+ * è vero, la bitmap del piazzamento differito: piazzando poi al più mines
+ * mine, la costruzione del campo non può più fallire a metà. Una diramazione
+ * non viene mai riutilizzata, poiché azzerarla richiederebbe di copiarne le
+ * righe. In caso di errore, nessuna modifica viene apportata a *fieldptr e al
+ * campo puntato da esso.
+ */
+static int msw_create_reserved(msw_field *fieldptr, int width, int height, long mines, int lazy) {
+    size_t required = msw_required_size(width, height);
+    msw_field field = *fieldptr;
+    long *index = NULL;
+    uint64_t *committed = NULL;
+    int reuse;
+
+    if (required == 0)
+        return 0;
+
+    reuse = (field && field->width == width && field->height == height && !field->row_owned);
+
+    if (mines > 0 && (!reuse || field->mine_cap < mines) &&
+        !(index = (long*) msw_alloc(mines * sizeof(long))))
+        return 0;
+
+    if (lazy && (!reuse || !field->committed) &&
+        !(committed = (uint64_t*) msw_alloc((((size_t) width * height + 63) / 64) * sizeof(uint64_t)))) {
+        if (index)
+            msw_free(index);
+        return 0;
+    }
+
+    if (reuse) {
+        /* Riutilizzo del campo esistente, senza alcuna allocazione per la
+         * griglia.
+         */
+        msw_reset(field);
+    } else {
+        /* La struttura, l'array delle righe e le celle vengono allocati in un
+         * unico blocco.
+         */
+        void *buffer = msw_alloc(required);
+
+        if (!buffer) {
+            if (index)
+                msw_free(index);
+            if (committed)
+                msw_free(committed);
+            return 0;
+        }
+
+        field = msw_init_storage(buffer, width, height, STORAGE_ALLOC, 1);
+    }
+
+    if (index) {
+        if (field->mine_cap > 0)
+            msw_free(field->mines);
+        field->mines = index;
+        field->mine_cap = mines;
+    }
+
+    if (committed)
+        field->committed = committed;
+
+    if (!reuse) {
+        /* Distruzione del precedente campo puntato da *fieldptr e sostituzione
+         * con il puntatore al campo appena creato.
+         */
+        msw_destroy(fieldptr);
+        *fieldptr = field;
+    }
+
+    return 1;
+}
+
 /* msw_create crea un nuovo campo vuoto, dati width > 1 e height > 1, assegna
- * il puntatore a *fieldptr (se *fieldptr è un puntatore non nullo, viene prima
- * distrutto il campo riferito da esso) e restituisce vero se la creazione è
- * avvenuta con successo. In caso di errore, nessuna modifica viene apportata a
- * *fieldptr e al campo puntato da esso.
+ * il puntatore a *fieldptr e restituisce vero se la creazione è avvenuta con
+ * successo. Se *fieldptr è un puntatore non nullo a un campo delle stesse
+ * dimensioni (non una diramazione), il campo viene riportato allo stato
+ * iniziale riutilizzandone la memoria, altrimenti viene prima distrutto. In
+ * caso di errore, nessuna modifica viene apportata a *fieldptr e al campo
+ * puntato da esso.
+ */
+int msw_create(msw_field *fieldptr, int width, int height) {
+    return msw_create_reserved(fieldptr, width, height, 0, 0);
+}
+
+/* msw_create_mapped crea un nuovo campo vuoto con le stesse modalità di
+ * msw_create, ma con la griglia mappata in memoria dal file sparso indicato
+ * da path (creato o troncato; se path è nullo, viene usato un file temporaneo
+ * anonimo). Il sistema operativo carica e scarica le pagine della griglia
+ * secondo necessità, così che la griglia non debba stare interamente in
+ * memoria: le pagine mai toccate non occupano né memoria né disco. Per
+ * riempirlo di mine, il campo può essere passato a msw_create_random, che
+ * lo rigenera sul posto.
+ */
+int msw_create_mapped(msw_field *fieldptr, int width, int height, const char *path) {
+    if (width > 1 && height > 1) {
+        size_t size = (size_t) width * height * sizeof(struct msw_cell_struct);
+        void *buffer = msw_alloc(msw_grid_offset() + (size_t) height * sizeof(msw_cell));
+
+        if (buffer) {
+            int fd;
+
+            if (path)
+                fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+            else {
+                char name[] = "/tmp/msw-XXXXXX";
+
+                fd = mkstemp(name);
+                if (fd >= 0)
+                    unlink(name);
+            }
+
+            if (fd >= 0) {
+                /* Il file viene esteso senza scrivere nulla: le celle lette prima di
+                 * essere scritte valgono zero, cioè CONTENT_EMPTY e VISITED_NO.
+                 */
+                if (ftruncate(fd, size) == 0) {
+                    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+                    if (map != MAP_FAILED) {
+                        msw_field field = (msw_field) buffer;
+                        int i;
+
+                        field->grid = (msw_grid) ((char*) buffer + msw_grid_offset());
+                        field->width = width;
+                        field->height = height;
+                        field->storage = STORAGE_MAP;
+                        field->row_owned = NULL;
+                        field->map = map;
+                        field->map_size = size;
+                        field->map_fd = fd;
+                        field->mines = NULL;
+                        field->mine_cap = 0;
+                        field->lazy = LAZY_NONE;
+                        field->lazy_mines = 0;
+                        field->committed = NULL;
+                        field->committed_cnt = 0;
+                        field->delta = NULL;
+
+                        for (i = 0; i < height; i++)
+                            field->grid[i] = (msw_cell) map + (size_t) i * width;
+
+                        msw_reset(field);
+
+                        msw_destroy(fieldptr);
+                        *fieldptr = field;
+
+                        return 1;
+                    }
+                }
+
+                close(fd);
+            }
+
+            msw_free(buffer);
+        }
+    }
+
+    return 0;
+}
+
+/* msw_advise suggerisce al sistema operativo il tipo di accesso alla griglia
+ * di un campo mappato su file (nessun effetto sugli altri campi): le
+ * scansioni complete della griglia usano MADV_SEQUENTIAL, così che le pagine
+ * vengano lette in anticipo e scaricate subito dopo l'uso.
+ */
+static void msw_advise(msw_field field, int advice) {
+    if (field->map)
+        madvise(field->map, field->map_size, advice);
+}
+
+/* msw_reset riporta il campo allo stato iniziale: tutte le celle vuote e non
+ * visitate, nessuna mina, istanza 1.
+ */
+void msw_reset(msw_field field) {
+    int x, y;
+
+    if (field->storage == STORAGE_MAP) {
+        /* Troncare ed estendere di nuovo il file ne scarta tutte le pagine, che
+         * tornano a valere zero senza essere scritte una per una.
+         */
+        if (ftruncate(field->map_fd, 0) != 0 || ftruncate(field->map_fd, field->map_size) != 0)
+            memset(field->map, 0, field->map_size);
+    } else
+        for (y = 0; y < field->height; y++) {
+            msw_cell row = msw_get_cell_rw(field, 0, y);
+
+            if (row)
+                for (x = 0; x < field->width; x++) {
+                    /* Inizializzazione della struttura msw_cell_struct. */
+                    row[x].content = CONTENT_EMPTY;
+                    row[x].visited = VISITED_NO;
+                }
+        }
+
+    field->mine_cnt = 0;
+    field->flag_cnt = 0;
+    field->nmnv_cnt = (long) field->width * field->height;
+    field->instance = 1;
+    field->undo_cnt = 0;
+
+    /* La bitmap del piazzamento differito viene mantenuta per essere
+     * riutilizzata da msw_create_lazy.
+     */
+    field->lazy = LAZY_NONE;
+    field->lazy_mines = 0;
+    field->committed_cnt = 0;
+
+    /* Lo stato visibile di un campo senza celle visitate ha hash nullo. */
+    memset(field->hash, 0, sizeof(field->hash));
+}
+
+/* msw_committed_size restituisce la dimensione in byte della bitmap del
+ * piazzamento differito del campo.
+ */
+static size_t msw_committed_size(msw_field field) {
+    return (((size_t) field->width * field->height + 63) / 64) * sizeof(uint64_t);
+}
+
+/* msw_fork crea una diramazione del campo, assegna il puntatore a *forkptr
+ * (se *forkptr è un puntatore non nullo, viene prima distrutto il campo
+ * riferito da esso) e restituisce vero se la creazione è avvenuta con
+ * successo. La diramazione condivide le righe della griglia con il campo di
+ * origine e ne copia una solo alla prima modifica (copy-on-write): la
+ * creazione costa una copia dell'array delle righe, ogni modifica costa al
+ * più la copia delle righe toccate e la distruzione dealloca solamente le
+ * righe private.
+ * Finché esistono sue diramazioni, il campo di origine non deve essere né
+ * modificato né distrutto; rispettata questa condizione, più diramazioni
+ * dello stesso campo possono essere usate contemporaneamente da thread
+ * diversi.
+ */
+int msw_fork(msw_field parent, msw_field *forkptr) {
+    size_t rows = (size_t) parent->height * sizeof(msw_cell);
+    void *buffer = msw_alloc(msw_grid_offset() + rows + parent->height);
+
+    if (buffer) {
+        msw_field field = (msw_field) buffer;
+
+        *field = *parent;
+        field->grid = (msw_grid) ((char*) buffer + msw_grid_offset());
+        field->storage = STORAGE_FORK;
+        field->row_owned = (unsigned char*) field->grid + rows;
+        field->map = NULL;
+        field->map_size = 0;
+        field->map_fd = -1;
+        field->delta = NULL;
+
+        /* Anche l'indice delle mine è condiviso finché non viene modificato. */
+        field->mine_cap = 0;
+
+        /* La bitmap del piazzamento differito, invece, viene copiata subito. */
+        field->committed = NULL;
+        if (parent->lazy) {
+            size_t bytes = msw_committed_size(parent);
+
+            field->committed = (uint64_t*) msw_alloc(bytes);
+            if (!field->committed) {
+                msw_free(buffer);
+                return 0;
+            }
+
+            memcpy(field->committed, parent->committed, bytes);
+        } else
+            field->lazy = LAZY_NONE;
+
+        memcpy(field->grid, parent->grid, rows);
+        memset(field->row_owned, 0, parent->height);
+
+        msw_destroy(forkptr);
+        *forkptr = field;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_copy copia lo stato completo del campo source (griglia, contatori,
+ * hash, indice delle mine e stato del piazzamento differito) nel campo
+ * riferito da *fieldptr, che viene prima creato con le modalità di
+ * msw_create se non ha le stesse dimensioni, e restituisce vero se la copia
+ * è avvenuta con successo. La copia è indipendente da source: a differenza
+ * di una diramazione, può essere letta da un altro thread mentre source
+ * continua ad essere modificato. Copiando ripetutamente nello stesso campo
+ * non avviene alcuna allocazione.
+ */
+int msw_copy(msw_field *fieldptr, msw_field source) {
+    return msw_copy_rows(fieldptr, source, NULL);
+}
+
+/* msw_copy_rows aggiorna come msw_copy il campo riferito da *fieldptr, già
+ * copia di source, copiando però solamente le righe y per cui rows[y] è vero:
+ * rows deve indicare tutte le righe di source modificate dall'ultima copia.
+ * Dell'indice delle mine, che le mosse possono solo estendere, vengono
+ * copiate solo le mine aggiunte, e della bitmap del piazzamento differito
+ * solo le parole delle righe indicate, così che il costo sia proporzionale
+ * alle righe modificate. Se rows è NULL, oppure se il campo viene creato,
+ * la copia è completa.
+ */
+int msw_copy_rows(msw_field *fieldptr, msw_field source, const unsigned char *rows) {
+    msw_field field = *fieldptr;
+    long first = 0;
+    int y, i;
+
+    if (!field || field->width != source->width || field->height != source->height) {
+        if (!msw_create(fieldptr, source->width, source->height))
+            return 0;
+        field = *fieldptr;
+        rows = NULL;
+    }
+
+    if (field->mine_cap < source->mine_cnt) {
+        long *mines = (long*) msw_alloc(source->mine_cnt * sizeof(long));
+
+        if (!mines)
+            return 0;
+
+        if (rows && field->mine_cnt > 0)
+            memcpy(mines, field->mines, field->mine_cnt * sizeof(long));
+        if (field->mine_cap > 0)
+            msw_free(field->mines);
+
+        field->mines = mines;
+        field->mine_cap = source->mine_cnt;
+    }
+
+    if (source->lazy) {
+        size_t bytes = msw_committed_size(source);
+
+        if (!field->committed) {
+            if (!(field->committed = (uint64_t*) msw_alloc(bytes)))
+                return 0;
+            rows = NULL;
+        }
+
+        if (!rows)
+            memcpy(field->committed, source->committed, bytes);
+        else {
+            for (y = 0; y < source->height; y++) {
+                if (rows[y]) {
+                    long from = (long) y * source->width / 64, to = ((long) (y + 1) * source->width - 1) / 64;
+
+                    memcpy(field->committed + from, source->committed + from, (to - from + 1) * sizeof(uint64_t));
+                }
+            }
+        }
+    }
+
+    for (y = 0; y < source->height; y++) {
+        if (!rows || rows[y]) {
+            msw_cell row = msw_get_cell_rw(field, 0, y);
+
+            if (!row)
+                return 0;
+
+            memcpy(row, source->grid[y], source->width * sizeof(struct msw_cell_struct));
+        }
+    }
+
+    if (rows && field->mine_cnt <= source->mine_cnt)
+        first = field->mine_cnt;
+    if (source->mine_cnt > first)
+        memcpy(field->mines + first, source->mines + first, (source->mine_cnt - first) * sizeof(long));
+
+    field->mine_cnt = source->mine_cnt;
+    field->flag_cnt = source->flag_cnt;
+    field->nmnv_cnt = source->nmnv_cnt;
+    field->instance = source->instance;
+    field->undo_cnt = source->undo_cnt;
+    field->lazy = source->lazy;
+    field->lazy_mines = source->lazy_mines;
+    field->committed_cnt = source->committed_cnt;
+
+    for (i = 0; i < SYMMETRY_CNT; i++)
+        field->hash[i] = source->hash[i];
+
+    return 1;
+}
+
+/* msw_destroy distrugge un campo precedentemente creato. La memoria fornita
+ * dal chiamante con msw_create_in_buffer non viene deallocata; di una
+ * diramazione vengono deallocate solamente le righe private; di un campo
+ * mappato su file viene rimossa la mappatura e chiuso il file.
+ */
+void msw_destroy(msw_field *fieldptr) {
+    if (*fieldptr) {
+        msw_field field = *fieldptr;
+
+        if (field->storage == STORAGE_FORK) {
+            int i;
+
+            for (i = 0; i < field->height; i++) {
+                if (field->row_owned[i])
+                    msw_free(field->grid[i]);
+            }
+        }
+
+        if (field->storage == STORAGE_MAP) {
+            munmap(field->map, field->map_size);
+            close(field->map_fd);
+        }
+
+        if (field->mine_cap > 0)
+            msw_free(field->mines);
+
+        if (field->committed)
+            msw_free(field->committed);
+
+        if (field->storage != STORAGE_BUFFER)
+            msw_free(field);
+
+        *fieldptr = NULL;
+    }
+}
+
+/* msw_cell_exists verifica se esiste la cella alla posizione (x, y). */
+int msw_cell_exists(msw_field field, int x, int y) {
+    return (x >= 0 && x < field->width && y >= 0 && y < field->height);
+}
+
+/* msw_get_cell restituisce il puntatore della cella alla posizione (x, y),
+ * altrimenti NULL se non esiste. Il puntatore restituito deve essere usato
+ * solamente in lettura: per modificare la cella si usa msw_get_cell_rw.
+ */
+msw_cell msw_get_cell(msw_field field, int x, int y) {
+    if (msw_cell_exists(field, x, y))
+        return field->grid[y] + x;
+    return NULL;
+}
+
+/* msw_get_cell_rw restituisce il puntatore modificabile della cella alla
+ * posizione (x, y), altrimenti NULL se non esiste. Se il campo è una
+ * diramazione e la riga della cella è ancora condivisa, la riga viene prima
+ * copiata (NULL anche se la copia non riesce).
+ */
+msw_cell msw_get_cell_rw(msw_field field, int x, int y) {
+    if (msw_cell_exists(field, x, y)) {
+        if (field->row_owned && !field->row_owned[y]) {
+            msw_cell row = (msw_cell) msw_alloc(field->width * sizeof(struct msw_cell_struct));
+
+            if (!row)
+                return NULL;
+
+            memcpy(row, field->grid[y], field->width * sizeof(struct msw_cell_struct));
+            field->grid[y] = row;
+            field->row_owned[y] = 1;
+        }
+
+        return field->grid[y] + x;
+    }
+    return NULL;
+}
+
+/* msw_cell_state restituisce lo stato visibile della cella esistente (x, y):
+ * STATE_HIDDEN se non visitata, STATE_FLAG se marcata con una bandiera,
+ * STATE_MINE se visitata e contenente una mina, altrimenti il numero di mine
+ * adiacenti.
+ */
+int msw_cell_state(msw_field field, int x, int y) {
+    msw_cell cell = msw_get_cell(field, x, y);
+
+    if (cell->visited == VISITED_NO)
+        return STATE_HIDDEN;
+    if (cell->visited == VISITED_FLAG)
+        return STATE_FLAG;
+    if (cell->content == CONTENT_MINE)
+        return STATE_MINE;
+    return cell->content;
+}
+
+/* msw_set_cell_state imposta direttamente lo stato visibile della cella
+ * esistente (x, y) a state, per i campi di sola visualizzazione che
+ * ricostruiscono una partita a partire dai suoi stati (cronologia,
+ * spettatori): le celle visitate ricevono l'istanza 1 e il contenuto
+ * indicato da state, mentre contatori, indice delle mine e hash non vengono
+ * aggiornati.
+ */
+void msw_set_cell_state(msw_field field, int x, int y, int state) {
+    msw_cell cell = field->grid[y] + x;
+
+    if (state == STATE_HIDDEN)
+        cell->visited = VISITED_NO;
+    else if (state == STATE_FLAG)
+        cell->visited = VISITED_FLAG;
+    else {
+        cell->content = (state == STATE_MINE ? CONTENT_MINE : state);
+        cell->visited = 1;
+    }
+}
+
+/* msw_zobrist restituisce la chiave di Zobrist dello stato visibile state
+ * alla posizione (x, y). Anziché da una tabella, la chiave è calcolata con
+ * la funzione di mescolamento di splitmix64, così da non occupare memoria
+ * proporzionale al campo. Lo stato STATE_HIDDEN ha chiave nulla.
+ */
+static uint64_t msw_zobrist(int x, int y, int state) {
+    uint64_t z;
+
+    if (state == STATE_HIDDEN)
+        return 0;
+
+    z = ((((uint64_t) (unsigned) y << 32) | (unsigned) x) * 16 + state) * 0x9e3779b97f4a7c15UL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+
+    return z ^ (z >> 31);
+}
+
+/* msw_hash_delta applica a hash, per ogni simmetria del campo, la modifica
+ * dello stato visibile della cella (x, y) da from a to.
+ */
+static void msw_hash_delta(msw_field field, uint64_t *hash, int x, int y, int from, int to) {
+    if (from != to) {
+        int w = field->width - 1, h = field->height - 1;
+
+        hash[0] ^= msw_zobrist(x, y, from) ^ msw_zobrist(x, y, to);
+        hash[1] ^= msw_zobrist(w - x, y, from) ^ msw_zobrist(w - x, y, to);
+        hash[2] ^= msw_zobrist(x, h - y, from) ^ msw_zobrist(x, h - y, to);
+        hash[3] ^= msw_zobrist(w - x, h - y, from) ^ msw_zobrist(w - x, h - y, to);
+
+        /* Le trasposizioni hanno senso solamente per i campi quadrati. */
+        if (w == h) {
+            hash[4] ^= msw_zobrist(y, x, from) ^ msw_zobrist(y, x, to);
+            hash[5] ^= msw_zobrist(h - y, x, from) ^ msw_zobrist(h - y, x, to);
+            hash[6] ^= msw_zobrist(y, w - x, from) ^ msw_zobrist(y, w - x, to);
+            hash[7] ^= msw_zobrist(h - y, w - x, from) ^ msw_zobrist(h - y, w - x, to);
+        }
+    }
+}
+
+/* msw_cell_changed aggiorna l'hash del campo, per ogni simmetria, dopo che
+ * lo stato visibile della cella (x, y) è passato da from a to e, durante
+ * msw_apply, registra la modifica nel buffer delle modifiche.
+ */
+static void msw_cell_changed(msw_field field, int x, int y, int from, int to) {
+    msw_hash_delta(field, field->hash, x, y, from, to);
+
+    if (field->delta && from != to) {
+        struct msw_delta_buffer_struct *delta = field->delta;
+
+        if (delta->cnt < delta->cap)
+            delta->deltas[delta->cnt++] = MSW_DELTA((long) y * field->width + x, to);
+        else
+            delta->overflow = 1;
+    }
+}
+
+/* msw_hash_apply applica atomicamente all'hash del campo le modifiche
+ * accumulate in delta, per la modalità condivisa.
+ */
+static void msw_hash_apply(msw_field field, uint64_t *delta) {
+    int i;
+
+    for (i = 0; i < SYMMETRY_CNT; i++) {
+        if (delta[i])
+            __sync_fetch_and_xor(&field->hash[i], delta[i]);
+    }
+}
+
+/* msw_hash restituisce l'hash a 64 bit dello stato visibile del campo,
+ * aggiornato incrementalmente ad ogni modifica.
+ */
+uint64_t msw_hash(msw_field field) {
+    return field->hash[0];
+}
+
+/* msw_canonical_hash restituisce l'hash dello stato visibile del campo
+ * invariante rispetto alle simmetrie (il minimo tra gli hash delle
+ * trasformazioni valide): due campi equivalenti a meno di rotazioni e
+ * riflessioni hanno lo stesso hash canonico.
+ */
+uint64_t msw_canonical_hash(msw_field field) {
+    int i, n = (field->width == field->height ? SYMMETRY_CNT : SYMMETRY_CNT / 2);
+    uint64_t hash = field->hash[0];
+
+    for (i = 1; i < n; i++) {
+        if (field->hash[i] < hash)
+            hash = field->hash[i];
+    }
+
+    return hash;
+}
+
+/* msw_rehash ricalcola da zero l'hash del campo; è necessaria solamente dopo
+ * aver modificato le celle direttamente anziché con le funzioni msw_*.
+ */
+void msw_rehash(msw_field field) {
+    int x, y;
+
+    memset(field->hash, 0, sizeof(field->hash));
+
+    for (y = 0; y < field->height; y++)
+        for (x = 0; x < field->width; x++)
+            msw_cell_changed(field, x, y, STATE_HIDDEN, msw_cell_state(field, x, y));
+}
+
+/* msw_mine_total restituisce il numero totale di mine del campo: per i campi
+ * con piazzamento differito, quelle da piazzare (lazy_mines) e non solo
+ * quelle già piazzate (mine_cnt).
+ */
+long msw_mine_total(msw_field field) {
+    return (field->lazy ? field->lazy_mines : field->mine_cnt);
+}
+
+/* msw_mine_cell piazza una mina sulla (x, y) cella esistente e restituisce
+ * vero se l'operazione è avvenuta con successo.
+ */
+int msw_mine_cell(msw_field field, int x, int y) {
+    if (msw_cell_exists(field, x, y)) {
+        if (msw_get_cell(field, x, y)->content != CONTENT_MINE) {
+            int x0, y0;
+
+            /* Le righe coinvolte e lo spazio nell'indice delle mine vengono
+             * preparati prima di qualsiasi modifica, così che un errore non lasci
+             * il campo a metà.
+             */
+            for (y0 = -1; y0 <= 1; y0++) {
+                if (msw_cell_exists(field, x, y + y0) && !msw_get_cell_rw(field, x, y + y0))
+                    return 0;
+            }
+
+            if (field->mine_cnt >= field->mine_cap) {
+                long cap = (field->mine_cnt < 8 ? 16 : field->mine_cnt * 2);
+                long *mines = (long*) msw_alloc(cap * sizeof(long));
+
+                if (!mines)
+                    return 0;
+
+                if (field->mine_cnt > 0)
+                    memcpy(mines, field->mines, field->mine_cnt * sizeof(long));
+                if (field->mine_cap > 0)
+                    msw_free(field->mines);
+
+                field->mines = mines;
+                field->mine_cap = cap;
+            }
+
+            /* Incremento del numero contenuto in tutte le celle adiacenti alla cella (x, y)
+             * non contenenti una mina. In realtà, è compresa anche la cella centrale
+             * nell'incremento...
+             */
+            for (y0 = -1; y0 <= 1; y0++)
+                for (x0 = -1; x0 <= 1; x0++) {
+                    if (msw_cell_exists(field, x + x0, y + y0) &&
+                        msw_get_cell(field, x + x0, y + y0)->content != CONTENT_MINE) {
+                        int state = msw_cell_state(field, x + x0, y + y0);
+
+                        msw_get_cell_rw(field, x + x0, y + y0)->content++;
+                        msw_cell_changed(field, x + x0, y + y0, state, msw_cell_state(field, x + x0, y + y0));
+                    }
+                }
+
+            /* ... ma adesso contiene una mina. */
+            {
+                int state = msw_cell_state(field, x, y);
+
+                msw_get_cell_rw(field, x, y)->content = CONTENT_MINE;
+                msw_cell_changed(field, x, y, state, msw_cell_state(field, x, y));
+            }
+            field->mines[field->mine_cnt++] = (long) y * field->width + x;
+            field->nmnv_cnt--;
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_random restituisce un numero casuale uniforme in [0, n) ottenuto con la
+ * funzione rand: per i campi più grandi di RAND_MAX + 1 celle vengono
+ * combinate più chiamate di rand, e le estrazioni oltre il più grande
+ * multiplo di n rappresentabile vengono scartate e ripetute, così che il
+ * resto della divisione per n non favorisca i valori più piccoli. Il valore
+ * combinato resta in un unsigned long per n fino a ULONG_MAX / (RAND_MAX + 1),
+ * ben oltre le celle di un campo che possa stare in memoria.
+ */
+long msw_random(long n) {
+    unsigned long r, range, limit;
+
+    do {
+        r = rand();
+        range = (unsigned long) RAND_MAX + 1;
+
+        while (range < (unsigned long) n) {
+            r = r * ((unsigned long) RAND_MAX + 1) + rand();
+            range *= (unsigned long) RAND_MAX + 1;
+        }
+
+        limit = range - range % n;
+    } while (r >= limit);
+
+    return (long) (r % n);
+}
+
+/* msw_create_random crea un nuovo campo con le stesse modalità di msw_create
+ * (compreso il riutilizzo di un campo delle stesse dimensioni, anche mappato
+ * su file), eccetto per il fatto che vengono piazzate le mine nel campo in
+ * modo casuale con la funzione rand (il seed deve essere prima
+ * inizializzato). L'indice delle mine viene riservato prima di azzerare il
+ * campo riutilizzato, così che il piazzamento non possa fallire: in caso di
+ * errore, il campo riferito da *fieldptr resta invariato.
+ */
+int msw_create_random(msw_field *fieldptr, int width, int height, long mines) {
+    /* Almeno una cella del campo deve contenere una mina e almeno una cella non
+     * deve contenere una mina. Se *fieldptr ha le stesse dimensioni, viene
+     * rigenerato sul posto da msw_create.
+     */
+    if ((mines >= 1 && mines < ((long) width * height)) && msw_create_reserved(fieldptr, width, height, mines, 0)) {
+        msw_field field = *fieldptr;
+        long cells = (long) width * height, j;
+
+        /* Algoritmo di Floyd: per ogni j tra le ultime mines posizioni, viene
+         * estratta una posizione t in [0, j]; se t contiene già una mina, la mina
+         * viene piazzata in j (che non può contenerne). Poiché msw_random è
+         * uniforme, ogni sottoinsieme di celle ha la stessa probabilità, e
+         * servono esattamente mines estrazioni, senza mai scorrere la griglia.
+         */
+        for (j = cells - mines; j < cells; j++) {
+            long t = msw_random(j + 1);
+
+            if (msw_get_cell(field, (int) (t % width), (int) (t / width))->content == CONTENT_MINE)
+                t = j;
+
+            msw_mine_cell(field, (int) (t % width), (int) (t / width));
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_splitmix restituisce il prossimo numero casuale a 64 bit del flusso
+ * splitmix64 con stato *state. Ogni striscia della costruzione parallela (e
+ * ogni catena del campionatore) ha il proprio flusso, derivato dal seme e dal
+ * proprio numero.
+ */
+uint64_t msw_splitmix(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15UL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+
+    return z ^ (z >> 31);
+}
+
+/* La struttura che rappresenta una costruzione parallela con
+ * msw_create_seeded. Il campo è diviso in strisce di MSW_STRIPE_ROWS righe,
+ * indipendenti dal numero di thread, che i thread prelevano una alla volta.
+ *
+ * field, seed
+ *     Il campo in costruzione e il seme.
+ *
+ * stripes, next
+ *     Il numero di strisce e la prossima striscia da prelevare (incrementata
+ *     atomicamente).
+ *
+ * quota, offset
+ *     Per ogni striscia, il numero di mine da piazzare e la posizione delle
+ *     sue mine nell'indice delle mine.
+ *
+ * halo
+ *     Per ogni striscia, la prima e l'ultima riga (un byte per cella, vero se
+ *     la cella contiene una mina), pubblicate dopo il piazzamento e lette
+ *     dalle strisce adiacenti durante il conteggio.
+ *
+ * scratch
+ *     Tre righe di lavoro (width byte ciascuna) per ogni thread.
+ */
+struct msw_build_struct {
+    msw_field field;
+    uint64_t seed;
+    long stripes, next;
+    long *quota, *offset;
+    unsigned char *halo, *scratch;
+};
+
+/* La struttura che rappresenta un thread della costruzione parallela. */
+struct msw_build_worker_struct {
+    pthread_t thread;
+    struct msw_build_struct *build;
+    unsigned char *scratch;
+    int phase;
+};
+
+/* msw_build_place azzera le celle della striscia s (il primo accesso da
+ * parte del thread che la costruisce, così che le pagine vengano allocate
+ * vicino a esso), vi piazza quota[s] mine con l'algoritmo di Floyd e il
+ * flusso della striscia, e pubblica le sue righe di bordo in halo.
+ */
+static void msw_build_place(struct msw_build_struct *build, long s) {
+    msw_field field = build->field;
+    int width = field->width, y0 = (int) (s * MSW_STRIPE_ROWS), y1, y;
+    long cells, j, k = build->quota[s], *mines = field->mines + build->offset[s];
+    uint64_t state = build->seed ^ ((uint64_t) s * 0xd1b54a32d192ed03UL);
+    msw_cell cell = field->grid[y0];
+
+    y1 = (y0 + MSW_STRIPE_ROWS < field->height ? y0 + MSW_STRIPE_ROWS : field->height);
+    cells = (long) (y1 - y0) * width;
+
+    /* Le righe della striscia sono contigue. */
+    memset(cell, 0, cells * sizeof(struct msw_cell_struct));
+
+    for (j = cells - k; j < cells; j++) {
+        long t = (long) (msw_splitmix(&state) % (uint64_t) (j + 1));
+
+        if (cell[t].content == CONTENT_MINE)
+            t = j;
+
+        cell[t].content = CONTENT_MINE;
+        *mines++ = (long) y0 * width + t;
+    }
+
+    for (y = 0; y < 2; y++) {
+        msw_cell row = field->grid[y == 0 ? y0 : y1 - 1];
+        unsigned char *halo = build->halo + (2 * s + y) * width;
+        int x;
+
+        for (x = 0; x < width; x++)
+            halo[x] = (row[x].content == CONTENT_MINE);
+    }
+}
+
+/* msw_build_row copia in flags la riga y come byte (vero se la cella
+ * contiene una mina), leggendo la griglia se la riga appartiene alla striscia
+ * s e le righe di bordo delle strisce adiacenti altrimenti; fuori dal campo,
+ * la riga è vuota.
+ */
+static void msw_build_row(struct msw_build_struct *build, long s, int y, unsigned char *flags) {
+    msw_field field = build->field;
+    int width = field->width, x;
+    long t = (y < 0 ? -1 : y / MSW_STRIPE_ROWS);
+
+    if (y < 0 || y >= field->height)
+        memset(flags, 0, width);
+    else if (t == s) {
+        msw_cell row = field->grid[y];
+
+        for (x = 0; x < width; x++)
+            flags[x] = (row[x].content == CONTENT_MINE);
+    } else
+        memcpy(flags, build->halo + (2 * t + (t < s)) * width, width);
+}
+
+/* msw_build_count calcola il numero contenuto nelle celle non contenenti una
+ * mina della striscia s, scorrendo tre righe alla volta con le somme per
+ * colonna; le righe fuori dalla striscia vengono lette da halo, così che
+ * nessun thread legga celle che un altro thread sta scrivendo.
+ */
+static void msw_build_count(struct msw_build_struct *build, long s, unsigned char *scratch) {
+    msw_field field = build->field;
+    int width = field->width, y0 = (int) (s * MSW_STRIPE_ROWS), y1, y, x;
+    unsigned char *up = scratch, *mid = scratch + width, *down = scratch + 2 * width, *tmp;
+
+    y1 = (y0 + MSW_STRIPE_ROWS < field->height ? y0 + MSW_STRIPE_ROWS : field->height);
+
+    msw_build_row(build, s, y0 - 1, up);
+    msw_build_row(build, s, y0, mid);
+
+    for (y = y0; y < y1; y++) {
+        msw_cell row = field->grid[y];
+        int prev = 0, cur, next;
+
+        msw_build_row(build, s, y + 1, down);
+        cur = up[0] + mid[0] + down[0];
+
+        for (x = 0; x < width; x++) {
+            next = (x + 1 < width ? up[x + 1] + mid[x + 1] + down[x + 1] : 0);
+
+            if (!mid[x])
+                row[x].content = prev + cur + next;
+
+            prev = cur;
+            cur = next;
+        }
+
+        tmp = up;
+        up = mid;
+        mid = down;
+        down = tmp;
+    }
+}
+
+/* msw_build_main è il corpo di un thread della costruzione parallela: preleva
+ * le strisce una alla volta ed esegue su di esse la fase assegnata.
+ */
+static void *msw_build_main(void *arg) {
+    struct msw_build_worker_struct *worker = (struct msw_build_worker_struct*) arg;
+    struct msw_build_struct *build = worker->build;
+    long s;
+
+    while ((s = __sync_fetch_and_add(&build->next, 1)) < build->stripes) {
+        if (worker->phase == 0)
+            msw_build_place(build, s);
+        else
+            msw_build_count(build, s, worker->scratch);
+    }
+
+    return NULL;
+}
+
+/* msw_build_run esegue una fase della costruzione su tutte le strisce con al
+ * più threads thread, compreso il chiamante, che lavora anch'esso e prosegue
+ * da solo se gli altri thread non possono essere avviati.
+ */
+static void msw_build_run(struct msw_build_struct *build, int threads, int phase) {
+    struct msw_build_worker_struct workers[MSW_PARALLEL_MAX];
+    int i, started = 0;
+
+    build->next = 0;
+
+    for (i = 0; i < threads; i++) {
+        workers[i].build = build;
+        workers[i].scratch = build->scratch + (size_t) i * 3 * build->field->width;
+        workers[i].phase = phase;
+    }
+
+    for (i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, msw_build_main, workers + i) != 0)
+            break;
+        started++;
+    }
+
+    msw_build_main(workers);
+
+    for (i = 1; i <= started; i++)
+        pthread_join(workers[i].thread, NULL);
+}
+
+/* msw_create_seeded crea un nuovo campo con le stesse modalità di
+ * msw_create_random, ma con le mine piazzate a partire dal seme seed e con
+ * la costruzione divisa tra più thread (quanti indicati da msw_set_threads),
+ * per i campi di centinaia di milioni di celle. Lo stesso seme produce
+ * sempre lo stesso campo, qualunque sia il numero di thread: il campo è
+ * diviso in strisce di MSW_STRIPE_ROWS righe, ognuna con un numero di mine
+ * proporzionale alle sue celle (le mine che avanzano vengono assegnate con
+ * il flusso del seme, così che il totale sia esattamente mines) e piazzate
+ * con un flusso proprio. Le strisce non sono quindi estratte come un unico
+ * sottoinsieme uniforme del campo, ma ogni striscia lo è al suo interno.
+ * Un campo esistente delle stesse dimensioni (anche mappato su file, non una
+ * diramazione) viene riutilizzato; altrimenti la griglia viene allocata
+ * senza essere azzerata, e ogni striscia viene azzerata dal thread che la
+ * costruisce.
+ */
+int msw_create_seeded(msw_field *fieldptr, int width, int height, long mines, unsigned long seed) {
+    struct msw_build_struct build;
+    long cells = (long) width * height, s, placed = 0;
+    int threads = msw_thread_count(), reuse, need_index;
+    size_t required = msw_required_size(width, height);
+    msw_field field = NULL;
+    long *index = NULL;
+    uint64_t state = seed;
+
+    if (required == 0 || mines < 1 || mines >= cells)
+        return 0;
+
+    build.stripes = (height + MSW_STRIPE_ROWS - 1) / MSW_STRIPE_ROWS;
+    if (threads > build.stripes)
+        threads = (int) build.stripes;
+
+    reuse = (*fieldptr && (*fieldptr)->width == width && (*fieldptr)->height == height &&
+             !(*fieldptr)->row_owned);
+
+    /* Tutte le allocazioni precedono qualsiasi modifica, così che un errore
+     * non lasci il campo esistente a metà.
+     */
+    build.quota = (long*) msw_alloc(2 * build.stripes * sizeof(long));
+    build.halo = (unsigned char*) msw_alloc((size_t) 2 * build.stripes * width);
+    build.scratch = (unsigned char*) msw_alloc((size_t) 3 * threads * width);
+
+    need_index = (!reuse || (*fieldptr)->mine_cap < mines);
+    if (need_index)
+        index = (long*) msw_alloc(mines * sizeof(long));
+
+    if (!reuse) {
+        void *buffer = msw_alloc(required);
+
+        if (buffer)
+            field = msw_init_storage(buffer, width, height, STORAGE_ALLOC, 0);
+    } else
+        field = *fieldptr;
+
+    if (!build.quota || !build.halo || !build.scratch || !field || (need_index && !index)) {
+        if (!reuse && field)
+            msw_free(field);
+        if (index)
+            msw_free(index);
+        if (build.quota)
+            msw_free(build.quota);
+        if (build.halo)
+            msw_free(build.halo);
+        if (build.scratch)
+            msw_free(build.scratch);
+
+        return 0;
+    }
+
+    if (index) {
+        if (field->mine_cap > 0)
+            msw_free(field->mines);
+        field->mines = index;
+        field->mine_cap = mines;
+    }
+
+    /* Quote proporzionali alle celle di ogni striscia, più le mine che
+     * avanzano, assegnate una alla volta a una cella estratta a caso (se la
+     * sua striscia ha ancora spazio).
+     */
+    build.offset = build.quota + build.stripes;
+
+    for (s = 0; s < build.stripes; s++) {
+        long rows = (s + 1 < build.stripes ? MSW_STRIPE_ROWS : height - s * MSW_STRIPE_ROWS);
+
+        build.quota[s] = (long) ((double) mines * rows * width / cells);
+        if (build.quota[s] > rows * width)
+            build.quota[s] = rows * width;
+        placed += build.quota[s];
+    }
+
+    while (placed < mines) {
+        s = (long) (msw_splitmix(&state) % (uint64_t) cells) / width / MSW_STRIPE_ROWS;
+
+        if (build.quota[s] < (s + 1 < build.stripes ? MSW_STRIPE_ROWS : height - s * MSW_STRIPE_ROWS) * (long) width) {
+            build.quota[s]++;
+            placed++;
+        }
+    }
+
+    while (placed > mines) {
+        s = (long) (msw_splitmix(&state) % (uint64_t) cells) / width / MSW_STRIPE_ROWS;
+
+        if (build.quota[s] > 0) {
+            build.quota[s]--;
+            placed--;
+        }
+    }
+
+    for (s = 0, placed = 0; s < build.stripes; s++) {
+        build.offset[s] = placed;
+        placed += build.quota[s];
+    }
+
+    build.field = field;
+    build.seed = msw_splitmix(&state);
+
+    /* Prima fase: azzeramento e piazzamento; seconda fase, dopo che tutte le
+     * righe di bordo sono state pubblicate: conteggio delle mine adiacenti.
+     */
+    msw_build_run(&build, threads, 0);
+    msw_build_run(&build, threads, 1);
+
+    msw_free(build.quota);
+    msw_free(build.halo);
+    msw_free(build.scratch);
+
+    field->mine_cnt = mines;
+    field->flag_cnt = 0;
+    field->nmnv_cnt = cells - mines;
+    field->instance = 1;
+    field->undo_cnt = 0;
+    field->lazy = LAZY_NONE;
+    field->lazy_mines = 0;
+    field->committed_cnt = 0;
+
+    /* Lo stato visibile di un campo senza celle visitate ha hash nullo. */
+    memset(field->hash, 0, sizeof(field->hash));
+
+    if (!reuse) {
+        msw_destroy(fieldptr);
+        *fieldptr = field;
+    }
+
+    return 1;
+}
+
+/* msw_commit_cell decide se la cella (x, y), se esistente e non ancora
+ * decisa, contiene una mina, piazzandola con msw_mine_cell, e restituisce
+ * falso solo se il piazzamento non è riuscito. Con bias nullo la cella
+ * contiene una mina con probabilità pari alle mine ancora da piazzare diviso
+ * le celle non ancora decise (campionamento sequenziale senza reinserimento,
+ * equivalente a un piazzamento iniziale uniforme); con bias positivo contiene
+ * una mina se ne restano da piazzare, con bias negativo solo se tutte le
+ * celle non decise devono contenerne una.
+ */
+static int msw_commit_cell(msw_field field, int x, int y, int bias) {
+    if (msw_cell_exists(field, x, y)) {
+        long index = (long) y * field->width + x;
+        uint64_t bit = (uint64_t) 1 << (index % 64);
+
+        if (!(field->committed[index / 64] & bit)) {
+            long left = field->lazy_mines - field->mine_cnt;
+            long undecided = (long) field->width * field->height - field->committed_cnt;
+            int mine;
+
+            if (bias > 0)
+                mine = (left > 0);
+            else if (bias < 0)
+                mine = (left >= undecided);
+            else
+                mine = (msw_random(undecided) < left);
+
+            /* Il numero di celle non contenenti una mina da visitare tiene già
+             * conto di tutte le mine da piazzare.
+             */
+            if (mine) {
+                field->nmnv_cnt++;
+                if (!msw_mine_cell(field, x, y)) {
+                    field->nmnv_cnt--;
+                    return 0;
+                }
+            }
+
+            field->committed[index / 64] |= bit;
+            field->committed_cnt++;
+        }
+    }
+
+    return 1;
+}
+
+/* msw_commit_around decide le celle non ancora decise attorno alla cella
+ * (x, y), compresa, prima che questa venga visitata. Così il numero mostrato
+ * dalla cella non cambia più e le celle non decise non sono mai adiacenti a
+ * un numero visibile: qualsiasi piazzamento successivo resta coerente con
+ * tutto ciò che è stato mostrato, senza bisogno di verificarlo.
+ */
+static int msw_commit_around(msw_field field, int x, int y) {
+    int x0, y0, success = 1;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++)
+        for (x0 = x - 1; x0 <= x + 1; x0++)
+            success = (msw_commit_cell(field, x0, y0, 0) && success);
+
+    return success;
+}
+
+/* msw_create_lazy crea un nuovo campo con le stesse modalità di msw_create,
+ * in cui le mine non vengono piazzate subito: la presenza di una mina in una
+ * cella viene decisa solamente quando la cella o una sua adiacente viene
+ * visitata, così che il costo del piazzamento venga pagato solo dove il
+ * giocatore guarda. La politica policy stabilisce come viene decisa la cella
+ * selezionata dal giocatore, se non ancora decisa: LAZY_UNIFORM come tutte le
+ * altre (lo schema è distribuito come quelli di msw_create_random),
+ * LAZY_PLAYER senza mina se possibile, LAZY_HOUSE con una mina se possibile.
+ * Le funzioni che richiedono lo schema completo (salvataggio e visualizzazione
+ * delle mine) decidono prima tutte le celle con msw_commit_all. La bitmap e
+ * l'indice delle mine vengono riservati prima di azzerare il campo
+ * riutilizzato: in caso di errore, il campo riferito da *fieldptr resta
+ * invariato.
+ */
+int msw_create_lazy(msw_field *fieldptr, int width, int height, long mines, int policy) {
+    if ((mines >= 1 && mines < ((long) width * height)) &&
+        (policy == LAZY_UNIFORM || policy == LAZY_PLAYER || policy == LAZY_HOUSE) &&
+        msw_create_reserved(fieldptr, width, height, mines, 1)) {
+        msw_field field = *fieldptr;
+
+        /* La bitmap di un campo riutilizzato viene riutilizzata a sua volta. */
+        memset(field->committed, 0, msw_committed_size(field));
+
+        field->lazy = policy;
+        field->lazy_mines = mines;
+        field->committed_cnt = 0;
+        field->nmnv_cnt = (long) width * height - mines;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/* msw_commit_all decide tutte le celle non ancora decise di un campo creato
+ * con msw_create_lazy, che diventa un campo ordinario, e restituisce vero se
+ * il piazzamento è avvenuto con successo. Le parole della bitmap già complete
+ * vengono saltate.
+ */
+int msw_commit_all(msw_field field) {
+    long cells = (long) field->width * field->height, words = (cells + 63) / 64, w;
+
+    if (!field->lazy)
+        return 1;
+
+    for (w = 0; w < words; w++) {
+        uint64_t undecided = ~field->committed[w];
+
+        while (undecided) {
+            long index = w * 64 + __builtin_ctzll(undecided);
+
+            if (index >= cells)
+                break;
+
+            if (!msw_commit_cell(field, (int) (index % field->width), (int) (index / field->width), 0))
+                return 0;
+
+            undecided &= undecided - 1;
+        }
+    }
+
+    field->lazy = LAZY_NONE;
+
+    return 1;
+}
+
+/* msw_skip_blank restituisce la posizione del primo carattere di [p, end)
+ * diverso da uno spazio, una tabulazione o un ritorno a capo '\r'.
+ */
+static const char *msw_skip_blank(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+
+    return p;
+}
+
+/* msw_scan_int legge un numero intero, con segno opzionale, a partire da *p e
+ * sposta *p dopo l'ultima cifra. Restituisce falso, con *p sul carattere non
+ * valido, se non ci sono cifre o se il numero non è rappresentabile come int.
+ */
+static int msw_scan_int(const char **p, const char *end, int *value) {
+    const char *q = *p, *digits;
+    long v = 0;
+    int negative = 0;
+
+    if (q < end && (*q == '-' || *q == '+')) {
+        negative = (*q == '-');
+        q++;
+    }
+
+    digits = q;
+    while (q < end && *q >= '0' && *q <= '9') {
+        v = v * 10 + (*q - '0');
+
+        if (v > INT_MAX) {
+            *p = q;
+            return 0;
+        }
+
+        q++;
+    }
+
+    *p = q;
+
+    if (q == digits)
+        return 0;
+
+    *value = (int) (negative ? -v : v);
+
+    return 1;
+}
+
+/* msw_scan_line legge la riga [*p, end), senza il carattere di fine riga, nel
+ * formato "a,b" con spazi opzionali attorno ai numeri. Restituisce 1 se la
+ * riga contiene una coppia (a, b), 0 se è vuota e -1 se non è valida, con *p
+ * sul carattere non valido.
+ */
+static int msw_scan_line(const char **p, const char *end, int *a, int *b) {
+    const char *q = msw_skip_blank(*p, end);
+
+    if (q == end)
+        return 0;
+
+    if (!msw_scan_int(&q, end, a))
+        goto invalid;
+
+    q = msw_skip_blank(q, end);
+    if (q == end || *q != ',')
+        goto invalid;
+
+    q = msw_skip_blank(q + 1, end);
+    if (!msw_scan_int(&q, end, b))
+        goto invalid;
+
+    q = msw_skip_blank(q, end);
+    if (q != end)
+        goto invalid;
+
+    return 1;
+
+invalid:
+    *p = q;
+    return -1;
+}
+
+/* msw_create_from_stream crea un nuovo campo con le stesse modalità di
+ * msw_create, eccetto per il fatto che lo schema (dimensione di esso e
+ * posizione delle mine) viene letto dallo stream descritto da *fileptr (anche
+ * lo standard input o una pipe), il cui formato di ogni riga è "a,b". Lo
+ * stream viene letto a blocchi di MSW_READ_BLOCK byte e analizzato sul posto,
+ * senza allocazioni per riga. In caso di errore, se line e column non sono
+ * NULL, vi vengono scritte la riga e la colonna (a partire da 1) del
+ * carattere che lo ha causato, oppure 0 se l'errore non dipende da una
+ * posizione (errore di lettura o numero di mine non valido).
+ */
+int msw_create_from_stream(msw_field *fieldptr, FILE *fileptr, long *line, long *column) {
+    msw_field field = NULL;
+    int width = 0, height = 0;
+    char *buffer = (char*) malloc(MSW_READ_BLOCK);
+    size_t len = 0, pos = 0;
+    long line_no = 1;
+    const char *error = NULL;
+    int success = (buffer != NULL), eof = 0;
+
+    while (success) {
+        char *begin = buffer + pos, *end = memchr(begin, '\n', len - pos);
+
+        if (!end) {
+            if (!eof) {
+                /* Riga incompleta: viene spostata all'inizio del buffer e il
+                 * resto del blocco viene letto dallo stream.
+                 */
+                memmove(buffer, begin, len - pos);
+                len -= pos;
+                pos = 0;
+
+                if (len == MSW_READ_BLOCK) {
+                    /* Una riga più lunga del buffer non può essere valida. */
+                    error = buffer + len - 1;
+                    success = 0;
+                } else {
+                    size_t bytes_read = fread(buffer + len, 1, MSW_READ_BLOCK - len, fileptr);
+
+                    if (bytes_read == 0) {
+                        eof = 1;
+                        if (ferror(fileptr))
+                            success = 0;
+                    }
+
+                    len += bytes_read;
+                }
+
+                continue;
+            }
+
+            /* Ultima riga senza fine riga. */
+            if (pos == len)
+                break;
+            end = buffer + len;
+        }
+
+        {
+            const char *p = begin;
+            int a, b, kind = msw_scan_line(&p, end, &a, &b);
+
+            if (kind < 0) {
+                error = p;
+                success = 0;
+            } else if (kind > 0) {
+                if (!field) {
+                    /* Se il campo non è stato ancora creato, è necessario crearlo. */
+                    width = a;
+                    height = b;
+                    success = msw_create(&field, width, height);
+                }  else {
+                    /* Se il campo è già stato creato, piazzare una mina. */
+                    success = msw_mine_cell(field, a, b);
+                }
+
+                if (!success)
+                    error = msw_skip_blank(begin, end);
+            }
+        }
+
+        if (success) {
+            pos = (end - buffer) + (end < buffer + len);
+            line_no++;
+        } else
+            pos = begin - buffer;
+    }
+
+    if (success && field) {
+        /* Almeno una cella del campo deve contenere una mina e almeno una cella non
+         * deve contenere una mina (le righe ripetute piazzano una sola mina).
+         */
+        if (field->mine_cnt >= 1 && field->mine_cnt < ((long) width * height)) {
+            free(buffer);
+
+            msw_destroy(fieldptr);
+            *fieldptr = field;
+
+            return 1;
+        }
+    }
+
+    if (line)
+        *line = (error ? line_no : 0);
+    if (column)
+        *column = (error ? (long) (error - (buffer + pos)) + 1 : 0);
+
+    free(buffer);
+
+    if (field)
+        msw_destroy(&field);
+
+    return 0;
+}
+
+/* msw_create_from_file crea un nuovo campo come msw_create_from_stream, senza
+ * riportare la posizione di un eventuale errore.
+ */
+int msw_create_from_file(msw_field *fieldptr, FILE *fileptr) {
+    return msw_create_from_stream(fieldptr, fileptr, NULL, NULL);
+}
+
+/* msw_write_to_file scrive lo schema (dimensione di esso e posizione delle
+ * mine) sul file descritto da *fileptr, il cui formato di ogni riga è
+ * "a,b" e restituisce vero se la scrittura è avvenuta con successo.
+ */
+int msw_write_to_file(msw_field field, FILE *fileptr) {
+    int success;
+
+    /* Scrittura della dimensione dello schema, completato se il piazzamento
+     * è differito.
+     */
+    success = msw_commit_all(field) && (fprintf(fileptr, "%d, %d\n\n", field->width, field->height) >= 0);
+
+    if (success) {
+        long i = 0;
+
+        /* Scrittura della posizione di ogni cella contenente una mina,
+         * dall'indice delle mine.
+         */
+        while (success && (i < field->mine_cnt)) {
+            long index = field->mines[i];
+
+            success = (fprintf(fileptr, "%ld, %ld\n", index % field->width, index / field->width) >= 0);
+
+            i++;
+        }
+    }
+
+    return success;
+}
+
+/* msw_mark_cell marca/demarca la cella (x, y) con una bandiera, se non
+ * visitata, e restituisce vero se la modifica è avvenuta con successo.
+ */
+int msw_mark_cell(msw_field field, int x, int y) {
+    if (msw_cell_exists(field, x, y)) {
+        int visited = msw_get_cell(field, x, y)->visited;
+
+        if ((visited == VISITED_NO || visited == VISITED_FLAG) && msw_get_cell_rw(field, x, y)) {
+            if (visited == VISITED_NO) {
+                msw_get_cell_rw(field, x, y)->visited = VISITED_FLAG;
+                field->flag_cnt++;
+                msw_cell_changed(field, x, y, STATE_HIDDEN, STATE_FLAG);
+            } else {
+                msw_get_cell_rw(field, x, y)->visited = VISITED_NO;
+                field->flag_cnt--;
+                msw_cell_changed(field, x, y, STATE_FLAG, STATE_HIDDEN);
+            }
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* msw_mark_mine_cells marca tutte le celle contenenti una mina con una
+ * bandiera.
+ */
+void msw_mark_mine_cells(msw_field field) {
+    long i;
+
+    msw_commit_all(field);
+
+    for (i = 0; i < field->mine_cnt; i++) {
+        int x = (int) (field->mines[i] % field->width), y = (int) (field->mines[i] / field->width);
+        int state = msw_cell_state(field, x, y);
+        msw_cell cell = msw_get_cell_rw(field, x, y);
+
+        if (cell) {
+            cell->visited = VISITED_FLAG;
+            msw_cell_changed(field, x, y, state, STATE_FLAG);
+        }
+    }
+}
+
+/* msw_show_mine_cells visita tutte le celle contenenti una mina non ancora
+ * visitate e non marcate, per mostrarle alla fine della partita. Le celle
+ * vengono visitate all'ultima istanza (quella della mossa appena eseguita),
+ * così che un annullamento successivo le nasconda di nuovo.
+ */
+void msw_show_mine_cells(msw_field field) {
+    long i;
+
+    msw_commit_all(field);
+
+    for (i = 0; i < field->mine_cnt; i++) {
+        int x = (int) (field->mines[i] % field->width), y = (int) (field->mines[i] / field->width);
+
+        if (msw_get_cell(field, x, y)->visited == VISITED_NO) {
+            msw_cell cell = msw_get_cell_rw(field, x, y);
+
+            if (cell) {
+                cell->visited = (field->instance > 1 ? field->instance - 1 : 1);
+                msw_cell_changed(field, x, y, STATE_HIDDEN, STATE_MINE);
+            }
+        }
+    }
+}
+
+/* La struttura che rappresenta lo stato di una visita in modalità condivisa,
+ * locale al thread che la esegue.
+ *
+ * stamp
+ *     L'istanza assegnata alle celle visitate.
+ *
+ * visited
+ *     Il numero di celle non contenenti una mina visitate.
+ *
+ * delta
+ *     Le modifiche all'hash, per ogni simmetria, da applicare al campo.
+ */
+struct msw_shared_visit_struct {
+    int stamp;
+    long visited;
+    uint64_t delta[SYMMETRY_CNT];
+};
+
+/* msw_visit_cell visita la sola cella (x, y), se esistente, non visitata e
+ * non marcata, e restituisce RESULT_DEFEAT se contiene una mina,
+ * RESULT_VISITED altrimenti, oppure 0 se la cella non è stata visitata.
+ * Se shared non è NULL, la visita avviene in modalità condivisa: la cella
+ * viene reclamata con un compare-and-swap sul suo stato di visita (0 se
+ * un altro thread l'ha reclamata prima) e le modifiche all'hash e al numero
+ * di celle visitate vengono accumulate in *shared, senza toccare il campo.
+ */
+static int msw_visit_cell(msw_field field, int x, int y, struct msw_shared_visit_struct *shared) {
+    if (shared) {
+        if (msw_cell_exists(field, x, y)) {
+            msw_cell cell = field->grid[y] + x;
+
+            /* La lettura preliminare evita l'operazione atomica sulle celle già
+             * visitate, le più frequenti durante un'espansione.
+             */
+            if (__atomic_load_n(&cell->visited, __ATOMIC_RELAXED) == VISITED_NO &&
+                __sync_bool_compare_and_swap(&cell->visited, VISITED_NO, shared->stamp)) {
+                if (cell->content == CONTENT_MINE) {
+                    msw_hash_delta(field, shared->delta, x, y, STATE_HIDDEN, STATE_MINE);
+                    return RESULT_DEFEAT;
+                }
+
+                msw_hash_delta(field, shared->delta, x, y, STATE_HIDDEN, cell->content);
+                shared->visited++;
+
+                return RESULT_VISITED;
+            }
+        }
+
+        return 0;
+    }
+
+    if (msw_cell_exists(field, x, y)) {
+        msw_cell cell = msw_get_cell(field, x, y);
+
+        /* Se la cella è non visitata e non marcata... */
+        if (cell->visited == VISITED_NO && (cell = msw_get_cell_rw(field, x, y))) {
+            /* Con il piazzamento differito, il vicinato della cella viene
+             * deciso prima di leggerne il contenuto.
+             */
+            if (field->lazy && !msw_commit_around(field, x, y))
+                return 0;
+
+            /* La cella è stata visitata all'istanza corrente. */
+            cell->visited = field->instance;
+            msw_cell_changed(field, x, y, STATE_HIDDEN, msw_cell_state(field, x, y));
+
+            /* Se la cella contiene una mina, allora sconfitta. */
+            if (cell->content == CONTENT_MINE)
+                return RESULT_DEFEAT;
+
+            /* Altrimenti, si tratta di un passo in più verso la vittoria. */
+            field->nmnv_cnt--;
+
+            return RESULT_VISITED;
+        }
+    }
+
+    return 0;
+}
+
+static void msw_expand(msw_field, int, int, struct msw_shared_visit_struct*);
+
+/* msw_push aggiunge la cella (x, y) alla pila *stackptr (*cntptr coppie di
+ * coordinate, spazio per *capptr coppie), raddoppiandone lo spazio se
+ * necessario, e restituisce vero se l'aggiunta è avvenuta con successo.
+ */
+static int msw_push(int **stackptr, long *cntptr, long *capptr, int x, int y) {
+    if (*cntptr == *capptr) {
+        int *grown = (int*) msw_alloc(*capptr * 4 * sizeof(int));
+
+        if (!grown)
+            return 0;
+
+        memcpy(grown, *stackptr, *capptr * 2 * sizeof(int));
+        msw_free(*stackptr);
+        *stackptr = grown;
+        *capptr *= 2;
+    }
+
+    (*stackptr)[*cntptr * 2] = x;
+    (*stackptr)[*cntptr * 2 + 1] = y;
+    (*cntptr)++;
+
+    return 1;
+}
+
+/* msw_expand_some prosegue l'espansione dalle celle vuote, già visitate,
+ * contenute nella pila *stackptr (*cntptr coppie di coordinate, spazio per
+ * *capptr coppie), visitando al più budget celle (senza limite se budget è
+ * negativo), e restituisce il numero di celle visitate. La pila viene fatta
+ * crescere se necessario; se non può crescere, l'espansione della cella
+ * prosegue ricorsivamente con msw_expand. Le celle ancora da espandere
+ * restano nella pila.
+ */
+static long msw_expand_some(msw_field field, int **stackptr, long *cntptr, long *capptr,
+                            struct msw_shared_visit_struct *shared, long budget) {
+    int *stack = *stackptr;
+    long cnt = *cntptr, cap = *capptr, visits = 0;
+
+    while (cnt > 0 && (budget < 0 || visits < budget)) {
+        int x, y, x0, y0;
+
+        cnt--;
+        x = stack[cnt * 2];
+        y = stack[cnt * 2 + 1];
+
+        for (y0 = y - 1; y0 <= y + 1; y0++)
+            for (x0 = x - 1; x0 <= x + 1; x0++) {
+                /* Se la cella adiacente viene visitata ed è vuota, deve essere a sua
+                 * volta espansa.
+                 */
+                if (msw_visit_cell(field, x0, y0, shared) == RESULT_VISITED) {
+                    visits++;
+
+                    if (msw_get_cell(field, x0, y0)->content == CONTENT_EMPTY &&
+                        !msw_push(&stack, &cnt, &cap, x0, y0))
+                        msw_expand(field, x0, y0, shared);
+                }
+            }
+    }
+
+    *stackptr = stack;
+    *cntptr = cnt;
+    *capptr = cap;
+
+    return visits;
+}
+
+/* msw_expand visita tutte le celle raggiungibili dalla cella vuota (x, y),
+ * già visitata, attraverso celle vuote (in modalità condivisa se shared non è
+ * NULL, come msw_visit_cell). Al posto della ricorsione viene usata una pila
+ * esplicita, così che le aperture di milioni di celle non esauriscano lo
+ * stack; se la pila non può essere allocata, l'espansione prosegue
+ * ricorsivamente.
  */
-int msw_create(msw_field *fieldptr, int width, int height) {
-    msw_field field = NULL;
+static void msw_expand(msw_field field, int x, int y, struct msw_shared_visit_struct *shared) {
+    long cap = 256, cnt = 0;
+    int *stack = (int*) msw_alloc(cap * 2 * sizeof(int));
+
+    if (!stack) {
+        int x0, y0;
+
+        for (y0 = -1; y0 <= 1; y0++)
+            for (x0 = -1; x0 <= 1; x0++) {
+                if (msw_visit_cell(field, x + x0, y + y0, shared) == RESULT_VISITED &&
+                    msw_get_cell(field, x + x0, y + y0)->content == CONTENT_EMPTY)
+                    msw_expand(field, x + x0, y + y0, shared);
+            }
 
-    /* La dimensione minima del campo è 2x2. */
-    if (width > 1 && height > 1) {
-        field = (msw_field) malloc(sizeof(struct msw_field_struct));
-
-        if (field) {
-            /* Inizializzazione della struttura msw_field_struct. */
-            field->grid = (msw_grid) malloc(height * sizeof(msw_cell));
-            field->width = width;
-            field->height = 0;
-            field->mine_cnt = 0;
-            field->flag_cnt = 0;
-            field->nmnv_cnt = width * height;
-            field->instance = 1;
-            field->undo_cnt = 0;
+        return;
+    }
+
+    stack[cnt * 2] = x;
+    stack[cnt * 2 + 1] = y;
+    cnt++;
 
-            if (field->grid) {
-                int i = 0, success = 1;
+    msw_expand_some(field, &stack, &cnt, &cap, shared, -1);
 
-                while (success && (i < height)) {
-                    field->grid[i] = (msw_cell) malloc(width * sizeof(struct msw_cell_struct));
+    msw_free(stack);
+}
+
+/* La struttura che rappresenta un'espansione parallela.
+ *
+ * field, stamp
+ *     Il campo e l'istanza assegnata alle celle visitate.
+ *
+ * lock, cond
+ *     Il mutex che protegge i campi seguenti e la condizione su cui i thread
+ *     senza lavoro attendono nuove celle da espandere.
+ *
+ * pool, pool_cnt, pool_cap
+ *     Le celle vuote, già visitate, da espandere (coppie di coordinate), che
+ *     i thread prelevano quando la propria pila è vuota e alimentano quando
+ *     qualche thread è senza lavoro.
+ *
+ * workers, idle
+ *     Il numero di thread e il numero di thread senza lavoro: quando tutti i
+ *     thread sono senza lavoro e pool è vuoto, l'espansione è terminata. idle
+ *     viene modificato atomicamente, oltre che sotto il mutex, perché i thread
+ *     al lavoro lo leggono senza prendere il mutex.
+ */
+struct msw_flood_struct {
+    msw_field field;
+    int stamp;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int *pool;
+    long pool_cnt, pool_cap;
+    int workers, idle;
+};
+
+/* La struttura che rappresenta un thread dell'espansione parallela, con il
+ * proprio stato di visita in modalità condivisa.
+ */
+struct msw_flood_worker_struct {
+    pthread_t thread;
+    struct msw_flood_struct *flood;
+    struct msw_shared_visit_struct shared;
+};
+
+/* msw_flood_main è il corpo di un thread dell'espansione parallela: espande
+ * la propria pila a blocchi di MSW_PARALLEL_SLICE celle, reclamando ogni
+ * cella con un compare-and-swap, e cede metà della pila a pool quando un
+ * altro thread è senza lavoro (work stealing).
+ */
+static void *msw_flood_main(void *arg) {
+    struct msw_flood_worker_struct *worker = (struct msw_flood_worker_struct*) arg;
+    struct msw_flood_struct *flood = worker->flood;
+    long cap = 256, cnt = 0;
+    int *stack = (int*) msw_alloc(cap * 2 * sizeof(int));
+
+    for (;;) {
+        if (cnt == 0) {
+            long take;
+
+            pthread_mutex_lock(&flood->lock);
+
+            __sync_fetch_and_add(&flood->idle, 1);
+            while (flood->pool_cnt == 0 && flood->idle < flood->workers)
+                pthread_cond_wait(&flood->cond, &flood->lock);
+
+            if (flood->pool_cnt == 0) {
+                pthread_cond_broadcast(&flood->cond);
+                pthread_mutex_unlock(&flood->lock);
+                break;
+            }
 
-                    if (field->grid[i]) {
-                        int j;
+            __sync_fetch_and_sub(&flood->idle, 1);
 
-                        for (j = 0; j < width; j++) {
-                            /* Inizializzazione della struttura msw_cell_struct. */
-                            field->grid[i][j].content = CONTENT_EMPTY;
-                            field->grid[i][j].visited = VISITED_NO;
-                        }
+            take = (flood->pool_cnt + flood->workers - 1) / flood->workers;
 
-                        /* field->height viene incrementato ogni volta che viene allocata una nuova riga
-                         * della griglia, fino a raggiungere il valore di height. In caso di errore di
-                         * malloc, solo le prime field->height devono essere deallocate.
-                         */
-                        field->height++;
-                    } else
-                        success = 0;
+            if (!stack || take > cap) {
+                int *grown = (int*) msw_alloc(take * 2 * sizeof(int));
 
-                    i++;
+                if (grown) {
+                    msw_free(stack);
+                    stack = grown;
+                    cap = take;
                 }
+            }
+
+            if (!stack) {
+                /* Senza pila, l'unica cella prelevata viene espansa con
+                 * msw_expand, che prosegue ricorsivamente.
+                 */
+                int x, y;
+
+                flood->pool_cnt--;
+                x = flood->pool[flood->pool_cnt * 2];
+                y = flood->pool[flood->pool_cnt * 2 + 1];
+                pthread_mutex_unlock(&flood->lock);
+
+                msw_expand(flood->field, x, y, &worker->shared);
+                continue;
+            }
+
+            if (take > cap)
+                take = cap;
+
+            flood->pool_cnt -= take;
+            memcpy(stack, flood->pool + flood->pool_cnt * 2, take * 2 * sizeof(int));
+            cnt = take;
+
+            pthread_mutex_unlock(&flood->lock);
+        }
+
+        msw_expand_some(flood->field, &stack, &cnt, &cap, &worker->shared, MSW_PARALLEL_SLICE);
+
+        /* Cessione delle celle più vecchie, in fondo alla pila, che sono le
+         * più lontane dalla zona che il thread sta espandendo.
+         */
+        if (cnt > 1 && __atomic_load_n(&flood->idle, __ATOMIC_RELAXED) > 0) {
+            long give = cnt / 2;
+
+            pthread_mutex_lock(&flood->lock);
 
-                if (success) {
-                    /* Distruzione del precedente campo puntato da *fieldptr e sostituzione con il
-                     * puntatore al campo appena creato. */
-                    msw_destroy(fieldptr);
-                    *fieldptr = field;
+            if (flood->pool_cnt + give > flood->pool_cap) {
+                long grown_cap = 2 * (flood->pool_cnt + give);
+                int *grown = (int*) msw_alloc(grown_cap * 2 * sizeof(int));
 
-                    return 1;
+                if (grown) {
+                    memcpy(grown, flood->pool, flood->pool_cnt * 2 * sizeof(int));
+                    msw_free(flood->pool);
+                    flood->pool = grown;
+                    flood->pool_cap = grown_cap;
                 }
             }
+
+            if (flood->pool_cnt + give <= flood->pool_cap) {
+                memcpy(flood->pool + flood->pool_cnt * 2, stack, give * 2 * sizeof(int));
+                memmove(stack, stack + give * 2, (cnt - give) * 2 * sizeof(int));
+                flood->pool_cnt += give;
+                cnt -= give;
+                pthread_cond_broadcast(&flood->cond);
+            }
+
+            pthread_mutex_unlock(&flood->lock);
         }
     }
 
-    msw_destroy(&field);
+    msw_free(stack);
 
-    return 0;
+    return NULL;
 }
 
-/* msw_destroy distrugge un campo precedentemente creato. */
-void msw_destroy(msw_field *fieldptr) {
-    if (*fieldptr) {
-        msw_field field = *fieldptr;
+/* msw_expand_parallel completa con threads thread l'espansione delle celle
+ * nella pila stack (cnt coppie di coordinate, spazio per cap coppie), che
+ * viene presa in carico, e restituisce vero se l'espansione è avvenuta. Le
+ * celle vengono visitate in modalità condivisa all'istanza corrente; al
+ * termine, i conteggi e le modifiche all'hash dei singoli thread vengono
+ * applicati al campo. Se nessun thread può essere avviato, restituisce falso
+ * senza modificare il campo.
+ */
+static int msw_expand_parallel(msw_field field, int *stack, long cnt, long cap, int threads) {
+    struct msw_flood_worker_struct workers[MSW_PARALLEL_MAX];
+    struct msw_flood_struct flood;
+    int i, j, started = 0;
+
+    flood.field = field;
+    flood.stamp = field->instance;
+    flood.pool = stack;
+    flood.pool_cnt = cnt;
+    flood.pool_cap = cap;
+    flood.workers = threads;
+    flood.idle = 0;
+
+    if (pthread_mutex_init(&flood.lock, NULL) != 0)
+        return 0;
+
+    if (pthread_cond_init(&flood.cond, NULL) != 0) {
+        pthread_mutex_destroy(&flood.lock);
+        return 0;
+    }
 
-        if (field->grid) {
-            int i;
+    /* Il numero di thread viene fissato prima dell'avvio: un thread che non
+     * parte viene tolto dal conteggio sotto il mutex, così che la condizione
+     * di terminazione resti corretta.
+     */
+    for (i = 0; i < threads; i++) {
+        workers[started].flood = &flood;
+        workers[started].shared.stamp = flood.stamp;
+        workers[started].shared.visited = 0;
+        for (j = 0; j < SYMMETRY_CNT; j++)
+            workers[started].shared.delta[j] = 0;
+
+        if (pthread_create(&workers[started].thread, NULL, msw_flood_main, workers + started) == 0)
+            started++;
+        else {
+            pthread_mutex_lock(&flood.lock);
+            flood.workers--;
+            pthread_cond_broadcast(&flood.cond);
+            pthread_mutex_unlock(&flood.lock);
+        }
+    }
 
-            /* Solo le prime field->height righe della griglia devono essere deallocate. */
-            for (i = 0; i < field->height; i++)
-                free(field->grid[i]);
+    if (started > 0) {
+        for (i = 0; i < started; i++) {
+            pthread_join(workers[i].thread, NULL);
 
-            free(field->grid);
+            field->nmnv_cnt -= workers[i].shared.visited;
+            for (j = 0; j < SYMMETRY_CNT; j++)
+                field->hash[j] ^= workers[i].shared.delta[j];
         }
 
-        free(field);
+        stack = flood.pool;
+    }
 
-        *fieldptr = NULL;
+    pthread_cond_destroy(&flood.cond);
+    pthread_mutex_destroy(&flood.lock);
+
+    if (started > 0)
+        msw_free(stack);
+
+    return (started > 0);
+}
+
+/* msw_flood visita tutte le celle raggiungibili dalle celle vuote, già
+ * visitate, contenute nella pila stack (cnt coppie di coordinate, spazio per
+ * cap coppie), che viene presa in carico, attraverso celle vuote.
+ * L'espansione comincia sequenzialmente e, se supera MSW_PARALLEL_THRESHOLD
+ * celle, le celle ancora da espandere vengono distribuite tra più thread: le
+ * aperture piccole, le più frequenti, non pagano il costo dei thread e delle
+ * operazioni atomiche. Le diramazioni e i campi con piazzamento differito, che
+ * modificano righe o mine durante la visita, e le espansioni di msw_apply,
+ * che registrano ogni modifica in ordine, vengono sempre eseguite
+ * sequenzialmente.
+ */
+static void msw_flood(msw_field field, int *stack, long cnt, long cap) {
+    int threads = msw_thread_count();
+
+    if (threads >= 2 && !field->row_owned && !field->lazy && !field->delta) {
+        msw_expand_some(field, &stack, &cnt, &cap, NULL, MSW_PARALLEL_THRESHOLD);
+
+        if (cnt > 0 && msw_expand_parallel(field, stack, cnt, cap, threads))
+            return;
     }
+
+    msw_expand_some(field, &stack, &cnt, &cap, NULL, -1);
+    msw_free(stack);
 }
 
-/* msw_cell_exists verifica se esiste la cella alla posizione (x, y). */
-int msw_cell_exists(msw_field field, int x, int y) {
-    return (x >= 0 && x < field->width && y >= 0 && y < field->height);
+/* msw_commit_selected applica alla cella (x, y), selezionata dal giocatore,
+ * la politica del piazzamento differito del campo, se questa dipende dal
+ * giocatore.
+ */
+static void msw_commit_selected(msw_field field, int x, int y) {
+    if (field->lazy == LAZY_PLAYER || field->lazy == LAZY_HOUSE)
+        msw_commit_cell(field, x, y, (field->lazy == LAZY_HOUSE ? 1 : -1));
 }
 
-/* msw_get_cell restituisce il puntatore della cella alla posizione (x, y),
- * altrimenti NULL se non esiste.
+/* msw_visit_adjacent_cells visita la cella (x, y), se non visitata e non
+ * marcata, e, se questa è vuota, tutte le celle raggiungibili da essa
+ * attraverso celle vuote; restituisce una costante che indica se, dopo la
+ * visita, il risultato è la sconfitta (la cella contiene una mina) oppure la
+ * semplice visita di una cella non contenente una mina. Durante l'espansione
+ * non è possibile incontare celle contenenti una mina, poiché queste sono
+ * tutte circondate da celle contenenti numeri.
+ * msw_visit_adjacent è una funzione ausiliaria di msw_select_cell, quindi non
+ * dovrebbe essere richiamata altrove.
  */
-msw_cell msw_get_cell(msw_field field, int x, int y) {
-    if (msw_cell_exists(field, x, y))
-        return field->grid[y] + x;
-    return NULL;
+int msw_visit_adjacent_cells(msw_field field, int x, int y) {
+    int result;
+
+    /* La politica del piazzamento differito si applica alla sola cella
+     * selezionata.
+     */
+    msw_commit_selected(field, x, y);
+
+    result = msw_visit_cell(field, x, y, NULL);
+
+    if (result == RESULT_VISITED && msw_get_cell(field, x, y)->content == CONTENT_EMPTY) {
+        long cap = 256, cnt = 0;
+        int *stack = (int*) msw_alloc(cap * 2 * sizeof(int));
+
+        if (stack && msw_push(&stack, &cnt, &cap, x, y))
+            msw_flood(field, stack, cnt, cap);
+        else
+            msw_expand(field, x, y, NULL);
+    }
+
+    return result;
 }
 
-/* msw_mine_cell piazza una mina sulla (x, y) cella esistente e restituisce
- * vero se l'operazione è avvenuta con successo.
+/* msw_select_cell seleziona la cella (x, y), se non visitata e non marcata, e
+ * restituisce una costante che indica se, dopo la visita, il risultato è la
+ * sconfitta (la cella contiene una mina), la vittoria (tutte le celle non
+ * contenenti una mina sono state visitate) oppure la semplice visita di una
+ * cella non contenente una mina.
  */
-int msw_mine_cell(msw_field field, int x, int y) {
+int msw_select_cell(msw_field field, int x, int y) {
     if (msw_cell_exists(field, x, y)) {
-        if (msw_get_cell(field, x, y)->content != CONTENT_MINE) {
-            int x0, y0;
+        /* Se la cella è non visitata e non marcata... */
+        if (msw_get_cell(field, x, y)->visited == VISITED_NO) {
+            /* Valutazione del risultato della visita delle celle adiacenti. */
+            int result = msw_visit_adjacent_cells(field, x, y);
 
-            /* Incremento del numero contenuto in tutte le celle adiacenti alla cella (x, y)
-             * non contenenti una mina. In realtà, è compresa anche la cella centrale
-             * nell'incremento...
-             */
-            for (y0 = -1; y0 <= 1; y0++)
-                for (x0 = -1; x0 <= 1; x0++) {
-                    if (msw_cell_exists(field, x + x0, y + y0) &&
-                        msw_get_cell(field, x + x0, y + y0)->content != CONTENT_MINE)
+            /* Se tutte le celle contenenti una mina sono state visitate, allora vittoria. */
+            if (field->nmnv_cnt == 0)
+                result = RESULT_VICTORY;
 
-                        msw_get_cell(field, x + x0, y + y0)->content++;
-                }
+            /* Incremento dell'istanza corrente. */
+            field->instance++;
 
-            /* ... ma adesso contiene una mina. */
-            msw_get_cell(field, x, y)->content = CONTENT_MINE;
-            field->mine_cnt++;
-            field->nmnv_cnt--;
+            return result;
         }
-
-        return 1;
     }
 
     return 0;
 }
 
-/* msw_create_random crea un nuovo campo con le stesse modalità di msw_create,
- * eccetto per il fatto che vengono piazzate le mine nel campo in modo casuale
- * con la funzione rand (il seed deve essere prima inizializzato).
+/* msw_select_cells seleziona come un'unica mossa le cnt celle dell'array
+ * cells (coppie di coordinate x, y): le celle non visitate e non marcate
+ * vengono visitate alla stessa istanza, e le celle vuote tra esse vengono
+ * espanse insieme con un'unica visita, così che un solo annullamento le
+ * nasconda tutte. Restituisce RESULT_DEFEAT se almeno una cella contiene una
+ * mina, altrimenti RESULT_VICTORY o RESULT_VISITED come msw_select_cell,
+ * oppure 0 se nessuna cella è stata visitata (l'istanza non cambia).
  */
-int msw_create_random(msw_field *fieldptr, int width, int height, int mines) {
-    msw_field field = NULL;
+int msw_select_cells(msw_field field, const int *cells, int cnt) {
+    long cap = 256, seeds = 0;
+    int *stack = (int*) msw_alloc(cap * 2 * sizeof(int));
+    int i, result = 0;
 
-    /* Almeno una cella del campo deve contenere una mina e almeno una cella non
-     * deve contenere una mina.
-     */
-    if ((mines >= 1 && mines < (width * height)) && msw_create(&field, width, height)) {
-        int cells = width * height;
+    for (i = 0; i < cnt; i++) {
+        int x = cells[i * 2], y = cells[i * 2 + 1], visit;
 
-        /* Per ogni mina da piazzare, selezionare casualmente l'indice n tra tutti gli
-         * indici delle celle ancora senza mina; la mina deve quindi essere piazzata
-         * all'n-esima cella senza mina.
-         */
-        while (mines > 0) {
-            int n = rand() % cells, x = 0, y = 0;
-
-            while (n > 0 || msw_get_cell(field, x, y)->content == CONTENT_MINE) {
-                if (msw_get_cell(field, x, y)->content != CONTENT_MINE)
-                    n--;
-                if (++x >= field->width) {
-                    x = 0;
-                    y++;
-                }
-            }
+        if (!msw_cell_exists(field, x, y) || msw_get_cell(field, x, y)->visited != VISITED_NO)
+            continue;
 
-            msw_mine_cell(field, x, y);
+        msw_commit_selected(field, x, y);
 
-            mines--;
-            cells--;
-        }
+        visit = msw_visit_cell(field, x, y, NULL);
 
-        msw_destroy(fieldptr);
-        *fieldptr = field;
+        if (visit && result != RESULT_DEFEAT)
+            result = visit;
 
-        return 1;
+        /* Le celle vuote vengono raccolte ed espanse alla fine tutte insieme;
+         * senza spazio nella pila, vengono espanse subito.
+         */
+        if (visit == RESULT_VISITED && msw_get_cell(field, x, y)->content == CONTENT_EMPTY &&
+            !(stack && msw_push(&stack, &seeds, &cap, x, y)))
+            msw_expand(field, x, y, NULL);
     }
 
-    return 0;
+    if (stack) {
+        if (seeds > 0)
+            msw_flood(field, stack, seeds, cap);
+        else
+            msw_free(stack);
+    }
+
+    if (!result)
+        return 0;
+
+    if (result != RESULT_DEFEAT && field->nmnv_cnt == 0)
+        result = RESULT_VICTORY;
+
+    field->instance++;
+
+    return result;
 }
 
-/* msw_create_from_file crea un nuovo campo con le stesse modalità di
- * msw_create, eccetto per il fatto che lo schema (dimensione di esso e
- * posizione delle mine) vengono letti dal file descritto da *fileptr, il cui
- * formato di ogni riga è "a,b".
+/* msw_reveal_begin comincia la selezione della cella (x, y), se non visitata e
+ * non marcata, come msw_select_cell, ma senza completare l'espansione: la
+ * cella viene visitata e, se vuota, le celle raggiungibili da essa vengono
+ * visitate dai passi successivi (msw_reveal_step) e da msw_reveal_finish, che
+ * conclude la selezione. Le modifiche dello stato visibile di tutti i passi
+ * vengono registrate di seguito in buffer, se non è NULL. Tra l'inizio e la
+ * conclusione il campo non deve essere modificato altrimenti, ma può essere
+ * letto (ad esempio per essere disegnato). Assegna la selezione a
+ * *revealptr (se *revealptr è un puntatore non nullo, la selezione riferita
+ * da esso viene prima conclusa, in ogni caso) e restituisce vero se la
+ * selezione è cominciata, falso se la cella non è selezionabile o se non c'è
+ * memoria sufficiente (la cella non viene visitata).
  */
-int msw_create_from_file(msw_field *fieldptr, FILE *fileptr) {
-    msw_field field = NULL;
-    int width, height, mines = 0;
-    int success = 1;
-    char *line = NULL;
-    size_t bytes_alloc = 0;
-    ssize_t bytes_read;
-
-    bytes_read = getline(&line, &bytes_alloc, fileptr);
-    while (success && (bytes_read != -1)) {
-        if (line[0] != '\n') {
-            int a, b;
-
-            /* La riga deve rispettare il formato "a,b", con a e b numeri interi. */
-            if (sscanf(line, "%d,%d", &a, &b) == 2) {
-                if (!field) {
-                    /* Se il campo non è stato ancora creato, è necessario crearlo. */
-                    width = a;
-                    height = b;
-                    success = msw_create(&field, width, height);
-                }  else {
-                    /* Se il campo è già stato creato, piazzare una mina. */
-                    success = msw_mine_cell(field, a, b);
-                    mines++;
-                }
-            } else
-                success = 0;
-        }
+int msw_reveal_begin(msw_reveal *revealptr, msw_field field, int x, int y, struct msw_delta_buffer_struct *buffer) {
+    msw_reveal reveal;
 
-        if (success)
-            bytes_read = getline(&line, &bytes_alloc, fileptr);
-    }
+    /* La selezione precedente viene conclusa prima dei controlli, poiché può
+     * visitare la cella (x, y) e cambiare il numero di celle da visitare.
+     */
+    msw_reveal_finish(revealptr);
 
-    free(line);
+    if (!msw_cell_exists(field, x, y) || msw_get_cell(field, x, y)->visited != VISITED_NO)
+        return 0;
 
-    if (success) {
-        /* Almeno una cella del campo deve contenere una mina e almeno una cella non
-         * deve contenere una mina.
-         */
-        if (mines >= 1 && mines < (width * height)) {
-            msw_destroy(fieldptr);
-            *fieldptr = field;
+    reveal = (msw_reveal) msw_alloc(sizeof(struct msw_reveal_struct));
+    if (!reveal)
+        return 0;
 
-            return 1;
-        }
+    reveal->field = field;
+    reveal->buffer = buffer;
+    reveal->cap = 256;
+    reveal->cnt = 0;
+    reveal->stack = (int*) msw_alloc(reveal->cap * 2 * sizeof(int));
+    reveal->start = field->nmnv_cnt;
+
+    if (!reveal->stack) {
+        msw_free(reveal);
+        return 0;
     }
 
-    if (field)
-        msw_destroy(&field);
+    if (buffer) {
+        buffer->cnt = 0;
+        buffer->overflow = 0;
+    }
+    field->delta = buffer;
 
-    return 0;
+    /* La politica del piazzamento differito si applica alla sola cella
+     * selezionata, come in msw_visit_adjacent_cells.
+     */
+    msw_commit_selected(field, x, y);
+
+    reveal->result = msw_visit_cell(field, x, y, NULL);
+
+    if (reveal->result == RESULT_VISITED && msw_get_cell(field, x, y)->content == CONTENT_EMPTY &&
+        !msw_push(&reveal->stack, &reveal->cnt, &reveal->cap, x, y))
+        msw_expand(field, x, y, NULL);
+
+    field->delta = NULL;
+
+    reveal->visited = reveal->start - field->nmnv_cnt;
+    *revealptr = reveal;
+
+    return 1;
 }
 
-/* msw_write_to_file scrive lo schema (dimensione di esso e posizione delle
- * mine) sul file descritto da *fileptr, il cui formato di ogni riga è
- * "a,b" e restituisce vero se la scrittura è avvenuta con successo.
+/* msw_reveal_step prosegue la selezione reveal visitando al più budget celle
+ * (MSW_REVEAL_SLICE se budget non è positivo), più quelle adiacenti
+ * all'ultima cella espansa, e restituisce vero se restano celle da
+ * espandere. Al termine, le celle visitate, la loro istanza e le modifiche
+ * all'hash e ai conteggi sono le stesse di msw_select_cell.
  */
-int msw_write_to_file(msw_field field, FILE *fileptr) {
-    int success;
+int msw_reveal_step(msw_reveal reveal, long budget) {
+    msw_field field = reveal->field;
 
-    /* Scrittura della dimensione dello schema. */
-    success = (fprintf(fileptr, "%d, %d\n\n", field->width, field->height) >= 0);
+    if (reveal->cnt > 0) {
+        field->delta = reveal->buffer;
+        msw_expand_some(field, &reveal->stack, &reveal->cnt, &reveal->cap, NULL,
+                        budget > 0 ? budget : MSW_REVEAL_SLICE);
+        field->delta = NULL;
 
-    if (success) {
-        int y = 0;
+        reveal->visited = reveal->start - field->nmnv_cnt;
+    }
 
-        /* Per ogni cella del campo... */
-        while (success && (y < field->height)) {
-            int x = 0;
+    return (reveal->cnt > 0);
+}
 
-            while (success && (x < field->width)) {
-                /* Scrittura della posizione della cella, se questa contiene
-                 * una mina.
-                 */
-                if (msw_get_cell(field, x, y)->content == CONTENT_MINE)
-                    success = (fprintf(fileptr, "%d, %d\n", x, y) >= 0);
+/* msw_reveal_finish completa l'espansione della selezione *revealptr (con
+ * più thread, come msw_select_cell, se la selezione non registra le
+ * modifiche), la conclude incrementando l'istanza corrente, la distrugge e
+ * restituisce lo stesso risultato di msw_select_cell; restituisce 0 se
+ * *revealptr è nullo.
+ */
+int msw_reveal_finish(msw_reveal *revealptr) {
+    msw_reveal reveal = *revealptr;
+    msw_field field;
+    int result;
 
-                x++;
-            }
+    if (!reveal)
+        return 0;
 
-            y++;
-        }
-    }
+    field = reveal->field;
+    field->delta = reveal->buffer;
 
-    return success;
+    if (reveal->cnt > 0)
+        msw_flood(field, reveal->stack, reveal->cnt, reveal->cap);
+    else
+        msw_free(reveal->stack);
+
+    field->delta = NULL;
+
+    /* Se tutte le celle contenenti una mina sono state visitate, allora vittoria. */
+    result = reveal->result;
+    if (field->nmnv_cnt == 0)
+        result = RESULT_VICTORY;
+
+    field->instance++;
+
+    msw_free(reveal);
+    *revealptr = NULL;
+
+    return result;
 }
 
-/* msw_mark_cell marca/demarca la cella (x, y) con una bandiera, se non
- * visitata, e restituisce vero se la modifica è avvenuta con successo.
+/* msw_count_adjacent conta le celle adiacenti alla cella (x, y) non
+ * visitate e non marcate (in *hidden, e in cells le loro coordinate, se non
+ * è NULL) e marcate (in *flags).
  */
-int msw_mark_cell(msw_field field, int x, int y) {
+static void msw_count_adjacent(msw_field field, int x, int y, int *hidden, int *flags, int *cells) {
+    int x0, y0;
+
+    *hidden = 0;
+    *flags = 0;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++)
+        for (x0 = x - 1; x0 <= x + 1; x0++) {
+            if (msw_cell_exists(field, x0, y0) && (x0 != x || y0 != y)) {
+                int visited = msw_get_cell(field, x0, y0)->visited;
+
+                if (visited == VISITED_FLAG)
+                    (*flags)++;
+                else if (visited == VISITED_NO) {
+                    if (cells) {
+                        cells[*hidden * 2] = x0;
+                        cells[*hidden * 2 + 1] = y0;
+                    }
+                    (*hidden)++;
+                }
+            }
+        }
+}
+
+/* msw_chord_cell, se la cella (x, y) è un numero visitato circondato da
+ * tante bandiere quante indica, seleziona come un'unica mossa (con
+ * msw_select_cells) tutte le celle adiacenti non visitate e non marcate, e
+ * ne restituisce il risultato; altrimenti restituisce 0. Se le bandiere
+ * sono sbagliate, il risultato può essere la sconfitta.
+ */
+int msw_chord_cell(msw_field field, int x, int y) {
     if (msw_cell_exists(field, x, y)) {
-        int *visited = &(msw_get_cell(field, x, y)->visited);
+        msw_cell cell = msw_get_cell(field, x, y);
 
-        if (*visited == VISITED_NO) {
-            *visited = VISITED_FLAG;
-            field->flag_cnt++;
+        if (cell->visited > VISITED_NO && cell->content > CONTENT_EMPTY) {
+            int cells[16], hidden, flags;
 
-            return 1;
-        } else if (*visited == VISITED_FLAG) {
-            *visited = VISITED_NO;
-            field->flag_cnt--;
+            msw_count_adjacent(field, x, y, &hidden, &flags, cells);
 
-            return 1;
+            if (hidden > 0 && flags == cell->content)
+                return msw_select_cells(field, cells, hidden);
         }
     }
 
     return 0;
 }
 
-/* msw_mark_mine_cells marca tutte le celle contenenti una mina con una
- * bandiera.
+/* msw_flag_forced, se la cella (x, y) è un numero visitato le cui mine
+ * mancanti sono tante quante le celle adiacenti non visitate e non marcate,
+ * marca tutte queste celle con una bandiera e ne restituisce il numero;
+ * altrimenti restituisce 0.
  */
-void msw_mark_mine_cells(msw_field field) {
-    int x, y;
+int msw_flag_forced(msw_field field, int x, int y) {
+    if (msw_cell_exists(field, x, y)) {
+        msw_cell cell = msw_get_cell(field, x, y);
 
-    for (y = 0; y < field->height; y++)
-        for (x = 0; x < field->width; x++) {
-            msw_cell cell = msw_get_cell(field, x, y);
+        if (cell->visited > VISITED_NO && cell->content > CONTENT_EMPTY) {
+            int cells[16], hidden, flags, i, marked = 0;
 
-            if (cell->content == CONTENT_MINE)
-                cell->visited = VISITED_FLAG;
+            msw_count_adjacent(field, x, y, &hidden, &flags, cells);
+
+            if (hidden > 0 && hidden + flags == cell->content) {
+                for (i = 0; i < hidden; i++)
+                    marked += (msw_mark_cell(field, cells[i * 2], cells[i * 2 + 1]) != 0);
+            }
+
+            return marked;
         }
+    }
+
+    return 0;
 }
 
-/* msw_visit_adjacent_cells visita le celle adiacenti alla cella (x, y), se
- * non visitate e non marcate, e restituisce una costante che indica se, dopo
- * la visita, il risultato è la sconfitta (la cella contiene una mina) oppure
- * la semplice visita di una cella non contenente una mina.
- * msw_visit_adjacent è una funzione ausiliaria di msw_select_cell, quindi non
- * dovrebbe essere richiamata altrove.
+/* msw_select_cell_shared seleziona la cella (x, y) come msw_select_cell, ma
+ * può essere chiamata contemporaneamente da più thread sullo stesso campo
+ * (modalità condivisa), insieme a msw_mark_cell_shared. Ogni cella viene
+ * reclamata con un compare-and-swap sul suo stato di visita, quindi due
+ * espansioni che si incontrano non visitano mai due volte la stessa cella; i
+ * conteggi e le modifiche all'hash vengono accumulati localmente e applicati
+ * al campo con una sola operazione atomica ciascuno. La vittoria viene
+ * restituita esattamente al thread la cui visita porta a zero il numero di
+ * celle non contenenti una mina da visitare. Ogni selezione riceve la propria
+ * istanza, anche se un altro thread la precede nel reclamare la cella.
+ * La modalità condivisa non è disponibile per le diramazioni e per i campi
+ * con piazzamento differito (restituisce 0) e, mentre è in uso, nessun'altra
+ * funzione deve modificare il campo.
  */
-int msw_visit_adjacent_cells(msw_field field, int x, int y) {
-    if (msw_cell_exists(field, x, y)) {
-        msw_cell cell = msw_get_cell(field, x, y);
-
-        /* Se la cella è non visitata e non marcata... */
-        if (cell->visited == VISITED_NO) {
-            /* La cella è stata visitata all'istanza corrente. */
-            cell->visited = field->instance;
+int msw_select_cell_shared(msw_field field, int x, int y) {
+    if (!field->row_owned && !field->lazy && msw_cell_exists(field, x, y) &&
+        __atomic_load_n(&field->grid[y][x].visited, __ATOMIC_RELAXED) == VISITED_NO) {
+        struct msw_shared_visit_struct shared;
+        int i, result;
 
-            /* Se la cella contiene una mina, allora sconfitta. */
-            if (cell->content == CONTENT_MINE)
-                return RESULT_DEFEAT;
+        shared.stamp = __sync_fetch_and_add(&field->instance, 1);
+        shared.visited = 0;
+        for (i = 0; i < SYMMETRY_CNT; i++)
+            shared.delta[i] = 0;
 
-            /* Altrimenti, si tratta di un passo in più verso la vittoria. */
-            field->nmnv_cnt--;
+        result = msw_visit_cell(field, x, y, &shared);
 
-            /* Se la cella è vuota, applicazione ricorsiva a tutte le celle adiacenti. */
-            if (cell->content == CONTENT_EMPTY) {
-                int x0, y0;
+        if (result == RESULT_VISITED && msw_get_cell(field, x, y)->content == CONTENT_EMPTY)
+            msw_expand(field, x, y, &shared);
 
-                for (y0 = -1; y0 <= 1; y0++)
-                    for (x0 = -1; x0 <= 1; x0++) {
-                        if (x0 != 0 || y0 != 0)
-                            msw_visit_adjacent_cells(field, x + x0, y + y0);
-                    }
-            }
+        msw_hash_apply(field, shared.delta);
 
-            /* Se la cella non contiene una mina e non è vuota, allora contiene un numero e
-             * la ricorsione si interrompe. Durante la ricorsione, non è possibile incontare
-             * celle contenenti una mina, poiché queste sono tutte circondate da celle
-             * contenenti numeri.
-             */
+        if (shared.visited > 0 && __sync_sub_and_fetch(&field->nmnv_cnt, shared.visited) == 0)
+            result = RESULT_VICTORY;
 
-            return RESULT_VISITED;
-        }
+        return result;
     }
 
     return 0;
 }
 
-/* msw_select_cell seleziona la cella (x, y), se non visitata e non marcata, e
- * restituisce una costante che indica se, dopo la visita, il risultato è la
- * sconfitta (la cella contiene una mina), la vittoria (tutte le celle non
- * contenenti una mina sono state visitate) oppure la semplice visita di una
- * cella non contenente una mina.
+/* msw_mark_cell_shared marca/demarca la cella (x, y) come msw_mark_cell, in
+ * modalità condivisa (vedi msw_select_cell_shared).
  */
-int msw_select_cell(msw_field field, int x, int y) {
-    if (msw_cell_exists(field, x, y)) {
-        /* Se la cella è non visitata e non marcata... */
-        if (msw_get_cell(field, x, y)->visited == VISITED_NO) {
-            /* Valutazione del risultato della visita delle celle adiacenti. */
-            int result = msw_visit_adjacent_cells(field, x, y);
+int msw_mark_cell_shared(msw_field field, int x, int y) {
+    if (!field->row_owned && !field->lazy && msw_cell_exists(field, x, y)) {
+        msw_cell cell = field->grid[y] + x;
+        int visited = __atomic_load_n(&cell->visited, __ATOMIC_RELAXED);
+        int marked = (visited == VISITED_NO ? VISITED_FLAG : VISITED_NO);
+
+        if ((visited == VISITED_NO || visited == VISITED_FLAG) &&
+            __sync_bool_compare_and_swap(&cell->visited, visited, marked)) {
+            uint64_t delta[SYMMETRY_CNT];
+            int i;
 
-            /* Se tutte le celle contenenti una mina sono state visitate, allora vittoria. */
-            if (field->nmnv_cnt == 0)
-                result = RESULT_VICTORY;
+            for (i = 0; i < SYMMETRY_CNT; i++)
+                delta[i] = 0;
 
-            /* Incremento dell'istanza corrente. */
-            field->instance++;
+            if (marked == VISITED_FLAG) {
+                __sync_fetch_and_add(&field->flag_cnt, 1);
+                msw_hash_delta(field, delta, x, y, STATE_HIDDEN, STATE_FLAG);
+            } else {
+                __sync_fetch_and_sub(&field->flag_cnt, 1);
+                msw_hash_delta(field, delta, x, y, STATE_FLAG, STATE_HIDDEN);
+            }
 
-            return result;
+            msw_hash_apply(field, delta);
+
+            return 1;
         }
     }
 
@@ -397,6 +2468,8 @@ int msw_undo(msw_field field, int times) {
         if (field->instance < 1)
             field->instance = 1;
 
+        msw_advise(field, MADV_SEQUENTIAL);
+
         /* Per ogni cella del campo... */
         for (y = 0; y < field->height; y++)
             for (x = 0; x < field->width; x++) {
@@ -405,13 +2478,16 @@ int msw_undo(msw_field field, int times) {
                 /* Se la cella è stata visitata "nel futuro", retrocessione a
                  * cella non visitata.
                  */
-                if (cell->visited >= field->instance) {
+                if (cell->visited >= field->instance && (cell = msw_get_cell_rw(field, x, y))) {
+                    msw_cell_changed(field, x, y, msw_cell_state(field, x, y), STATE_HIDDEN);
                     cell->visited = VISITED_NO;
                     if (cell->content != CONTENT_MINE)
                         field->nmnv_cnt++;
                 }
             }
 
+        msw_advise(field, MADV_NORMAL);
+
         field->undo_cnt++;
 
         return 1;
@@ -428,3 +2504,60 @@ int msw_undo(msw_field field, int times) {
 int msw_undo_incremental(msw_field field) {
     return msw_undo(field, field->undo_cnt + 1);
 }
+
+/* msw_apply esegue in ordine le action_cnt azioni dell'array actions,
+ * compilandone il risultato, e registra nel buffer fornito dal chiamante le
+ * modifiche dello stato visibile del campo (posizione della cella e nuovo
+ * stato), così che il chiamante possa aggiornare solamente le celle
+ * modificate senza confrontare l'intero campo. Il buffer viene svuotato
+ * all'inizio e può essere riutilizzato da una chiamata all'altra senza
+ * alcuna allocazione. Se il buffer si riempie, l'azione in corso viene
+ * completata, overflow diventa vero e le azioni seguenti non vengono
+ * eseguite. Restituisce il numero di azioni eseguite.
+ */
+int msw_apply(msw_field field, struct msw_action_struct *actions, int action_cnt,
+              struct msw_delta_buffer_struct *buffer) {
+    int i;
+
+    buffer->cnt = 0;
+    buffer->overflow = 0;
+    field->delta = buffer;
+
+    for (i = 0; i < action_cnt && !buffer->overflow; i++) {
+        struct msw_action_struct *action = actions + i;
+
+        switch (action->type) {
+            case MSW_ACTION_SELECT:
+                action->result = msw_select_cell(field, action->x, action->y);
+                break;
+            case MSW_ACTION_MARK:
+                action->result = msw_mark_cell(field, action->x, action->y);
+                break;
+            case MSW_ACTION_UNDO:
+                action->result = msw_undo(field, action->x);
+                break;
+            case MSW_ACTION_CHORD:
+                action->result = msw_chord_cell(field, action->x, action->y);
+                break;
+            case MSW_ACTION_FLAG_FORCED:
+                action->result = msw_flag_forced(field, action->x, action->y);
+                break;
+            case MSW_ACTION_MARK_MINES:
+                msw_mark_mine_cells(field);
+                action->result = 1;
+                break;
+            case MSW_ACTION_SHOW_MINES:
+                msw_show_mine_cells(field);
+                action->result = 1;
+                break;
+            default:
+                action->result = 0;
+        }
+
+        action->delta_end = buffer->cnt;
+    }
+
+    field->delta = NULL;
+
+    return i;
+}
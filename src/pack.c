@@ -0,0 +1,440 @@
+#include <stdlib.h> /* malloc, calloc, realloc, free */
+#include <string.h> /* memcpy, memcmp, memset */
+#include <fcntl.h> /* open */
+#include <unistd.h> /* pread, pwrite, fsync, close */
+#include <sys/mman.h> /* mmap, munmap */
+#include <sys/stat.h> /* fstat */
+#include "minesweeper.h"
+#include "pack.h"
+
+/* msw_pack_write scrive size byte a partire dall'offset, ripetendo le
+ * scritture parziali.
+ */
+static int msw_pack_write(int fd, const void *data, size_t size, uint64_t offset) {
+    const char *p = (const char*) data;
+
+    while (size > 0) {
+        ssize_t written = pwrite(fd, p, size, (off_t) offset);
+
+        if (written <= 0)
+            return 0;
+
+        p += written;
+        size -= written;
+        offset += written;
+    }
+
+    return 1;
+}
+
+/* msw_pack_record_size restituisce la dimensione di un record per uno schema
+ * di width x height celle.
+ */
+static uint64_t msw_pack_record_size(int width, int height) {
+    uint64_t words = ((uint64_t) width * height + 63) / 64;
+
+    return sizeof(struct msw_pack_record_struct) + words * sizeof(uint64_t);
+}
+
+/* msw_pack_metrics calcola il 3BV e il numero di aperture del campo. Ogni
+ * apertura viene visitata con una pila esplicita e marca le celle che
+ * scopre; le celle numerate rimaste non marcate richiedono una selezione
+ * ciascuna. Restituisce falso se la memoria di appoggio non è disponibile.
+ */
+static int msw_pack_metrics(msw_field field, int64_t *bbbv, int64_t *openings) {
+    long cells = (long) field->width * field->height, i;
+    unsigned char *marked = (unsigned char*) calloc(cells, 1);
+    long *stack = NULL, stack_cnt = 0, stack_cap = 0;
+
+    if (!marked)
+        return 0;
+
+    *bbbv = 0;
+    *openings = 0;
+
+    for (i = 0; i < cells; i++) {
+        msw_cell cell = msw_get_cell(field, (int) (i % field->width), (int) (i / field->width));
+
+        if (!marked[i] && cell->content == CONTENT_EMPTY) {
+            (*openings)++;
+            (*bbbv)++;
+
+            marked[i] = 1;
+            stack_cnt = 0;
+
+            do {
+                long top;
+                int x, y, x0, y0;
+
+                if (stack_cnt == 0)
+                    top = i;
+                else
+                    top = stack[--stack_cnt];
+
+                x = (int) (top % field->width);
+                y = (int) (top / field->width);
+
+                /* Le celle adiacenti vengono scoperte dall'apertura e quelle
+                 * vuote la estendono.
+                 */
+                for (y0 = -1; y0 <= 1; y0++)
+                    for (x0 = -1; x0 <= 1; x0++) {
+                        long n = (long) (y + y0) * field->width + (x + x0);
+
+                        if (msw_cell_exists(field, x + x0, y + y0) && !marked[n]) {
+                            marked[n] = 1;
+
+                            if (msw_get_cell(field, x + x0, y + y0)->content == CONTENT_EMPTY) {
+                                if (stack_cnt == stack_cap) {
+                                    long cap = (stack_cap ? stack_cap * 2 : 256);
+                                    long *grown = (long*) realloc(stack, cap * sizeof(long));
+
+                                    if (!grown) {
+                                        free(stack);
+                                        free(marked);
+                                        return 0;
+                                    }
+
+                                    stack = grown;
+                                    stack_cap = cap;
+                                }
+
+                                stack[stack_cnt++] = n;
+                            }
+                        }
+                    }
+            } while (stack_cnt > 0);
+        }
+    }
+
+    for (i = 0; i < cells; i++) {
+        if (!marked[i] && msw_get_cell(field, (int) (i % field->width), (int) (i / field->width))->content != CONTENT_MINE)
+            (*bbbv)++;
+    }
+
+    free(stack);
+    free(marked);
+
+    return 1;
+}
+
+/* msw_pack_create crea il pacchetto nel file path (troncandolo se esiste già)
+ * e lo apre in scrittura, assegna il puntatore a *packptr (se *packptr è un
+ * puntatore non nullo, viene prima chiuso il pacchetto riferito da esso) e
+ * restituisce vero se la creazione è avvenuta con successo.
+ */
+int msw_pack_create(msw_pack *packptr, const char *path) {
+    msw_pack pack = (msw_pack) calloc(1, sizeof(struct msw_pack_struct));
+
+    if (pack) {
+        struct msw_pack_header_struct header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MSW_PACK_MAGIC, sizeof(header.magic));
+
+        pack->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        pack->writable = 1;
+        pack->end = sizeof(header);
+
+        if (pack->fd != -1) {
+            if (msw_pack_write(pack->fd, &header, sizeof(header), 0) &&
+                pthread_mutex_init(&pack->lock, NULL) == 0) {
+                msw_pack_close(packptr);
+                *packptr = pack;
+
+                return 1;
+            }
+
+            close(pack->fd);
+        }
+
+        free(pack);
+    }
+
+    return 0;
+}
+
+/* msw_pack_append aggiunge al pacchetto lo schema del campo (le posizioni
+ * delle mine) generato con il seed, assegna a *id (se non è NULL)
+ * l'identificativo dello schema e restituisce vero se la scrittura è avvenuta
+ * con successo. Più thread possono aggiungere schemi allo stesso pacchetto
+ * contemporaneamente: il record viene preparato fuori dalla sezione critica,
+ * nella quale vengono solamente riservati l'offset e l'identificativo, e poi
+ * scritto in modo indipendente dagli altri.
+ */
+int msw_pack_append(msw_pack pack, msw_field field, uint64_t seed, long *id) {
+    uint64_t size = msw_pack_record_size(field->width, field->height), offset = 0;
+    struct msw_pack_record_struct *record;
+    uint64_t *bitmap;
+    long i;
+    int success;
+
+    /* Lo schema di un campo con piazzamento differito viene prima completato. */
+    if (!pack->writable || !msw_commit_all(field) ||
+        !(record = (struct msw_pack_record_struct*) calloc(1, size)))
+        return 0;
+
+    record->size = size;
+    record->seed = seed;
+    record->mine_cnt = field->mine_cnt;
+    record->width = field->width;
+    record->height = field->height;
+
+    /* La bitmap viene compilata dall'indice delle mine. */
+    bitmap = (uint64_t*) (record + 1);
+    for (i = 0; i < field->mine_cnt; i++)
+        bitmap[field->mines[i] / 64] |= (uint64_t) 1 << (field->mines[i] % 64);
+
+    success = msw_pack_metrics(field, &record->bbbv, &record->openings);
+
+    if (success) {
+        pthread_mutex_lock(&pack->lock);
+
+        if (pack->board_cnt == pack->index_cap) {
+            long cap = (pack->index_cap ? pack->index_cap * 2 : 1024);
+            uint64_t *index = (uint64_t*) realloc(pack->index, cap * sizeof(uint64_t));
+
+            if (index) {
+                pack->index = index;
+                pack->index_cap = cap;
+            } else
+                success = 0;
+        }
+
+        if (success) {
+            offset = pack->end;
+            pack->end += size;
+
+            if (id)
+                *id = pack->board_cnt;
+            pack->index[pack->board_cnt++] = offset;
+        }
+
+        pthread_mutex_unlock(&pack->lock);
+    }
+
+    if (success)
+        success = msw_pack_write(pack->fd, record, size, offset);
+
+    free(record);
+
+    return success;
+}
+
+/* msw_pack_valid verifica che all'offset della memoria mappata inizi un record
+ * valido che termina entro l'offset end, con aritmetica che non può
+ * traboccare qualunque sia il contenuto del file.
+ */
+static int msw_pack_valid(msw_pack pack, uint64_t offset, uint64_t end) {
+    const struct msw_pack_record_struct *record;
+
+    if (offset < sizeof(struct msw_pack_header_struct) || offset % sizeof(uint64_t) != 0 ||
+        end > pack->map_size || offset > end || end - offset < sizeof(struct msw_pack_record_struct))
+        return 0;
+
+    record = (const struct msw_pack_record_struct*) ((const char*) pack->map + offset);
+
+    return (record->width > 0 && record->height > 0 &&
+            record->size == msw_pack_record_size(record->width, record->height) &&
+            record->size <= end - offset);
+}
+
+/* msw_pack_scan ricostruisce l'indice di un pacchetto non chiuso scorrendo i
+ * record validi a partire dall'inizio, fino al primo record incompleto.
+ */
+static int msw_pack_scan(msw_pack pack) {
+    uint64_t offset = sizeof(struct msw_pack_header_struct);
+
+    while (msw_pack_valid(pack, offset, pack->map_size)) {
+        const struct msw_pack_record_struct *record =
+            (const struct msw_pack_record_struct*) ((const char*) pack->map + offset);
+
+        if (pack->board_cnt == pack->index_cap) {
+            long cap = (pack->index_cap ? pack->index_cap * 2 : 1024);
+            uint64_t *index = (uint64_t*) realloc(pack->index, cap * sizeof(uint64_t));
+
+            if (!index)
+                return 0;
+
+            pack->index = index;
+            pack->index_cap = cap;
+        }
+
+        pack->index[pack->board_cnt++] = offset;
+        offset += record->size;
+    }
+
+    pack->end = offset;
+
+    return 1;
+}
+
+/* msw_pack_index verifica l'indice di un pacchetto chiuso: che sia contenuto
+ * nel file e che ogni suo offset riferisca un record valido che termina prima
+ * dell'indice. Se l'indice è valido lo adotta, leggendolo direttamente dalla
+ * memoria mappata, e restituisce vero.
+ */
+static int msw_pack_index(msw_pack pack, const struct msw_pack_header_struct *header) {
+    const uint64_t *index;
+    uint64_t i;
+
+    if (header->index_offset < sizeof(struct msw_pack_header_struct) ||
+        header->index_offset % sizeof(uint64_t) != 0 || header->index_offset > pack->map_size ||
+        header->board_cnt > (pack->map_size - header->index_offset) / sizeof(uint64_t))
+        return 0;
+
+    index = (const uint64_t*) ((const char*) pack->map + header->index_offset);
+
+    for (i = 0; i < header->board_cnt; i++) {
+        if (!msw_pack_valid(pack, index[i], header->index_offset))
+            return 0;
+    }
+
+    pack->index = (uint64_t*) index;
+    pack->board_cnt = (long) header->board_cnt;
+    pack->end = header->index_offset;
+
+    return 1;
+}
+
+/* msw_pack_open apre in lettura il pacchetto nel file path, mappandolo in
+ * memoria, assegna il puntatore a *packptr (se *packptr è un puntatore non
+ * nullo, viene prima chiuso il pacchetto riferito da esso) e restituisce vero
+ * se l'apertura è avvenuta con successo. Ogni record dell'indice viene
+ * verificato all'apertura, così che msw_pack_record non possa mai riferire
+ * memoria fuori dalla mappatura; un indice non valido viene ricostruito
+ * come quello di un pacchetto non chiuso.
+ */
+int msw_pack_open(msw_pack *packptr, const char *path) {
+    msw_pack pack = (msw_pack) calloc(1, sizeof(struct msw_pack_struct));
+
+    if (pack) {
+        struct stat st;
+
+        pack->fd = open(path, O_RDONLY);
+
+        if (pack->fd != -1 && fstat(pack->fd, &st) == 0 &&
+            (size_t) st.st_size >= sizeof(struct msw_pack_header_struct)) {
+            pack->map_size = st.st_size;
+            pack->map = mmap(NULL, pack->map_size, PROT_READ, MAP_SHARED, pack->fd, 0);
+
+            if (pack->map != MAP_FAILED) {
+                const struct msw_pack_header_struct *header = (const struct msw_pack_header_struct*) pack->map;
+                int success = (memcmp(header->magic, MSW_PACK_MAGIC, sizeof(header->magic)) == 0);
+
+                if (success && (header->index_offset == 0 || !msw_pack_index(pack, header)))
+                    success = msw_pack_scan(pack);
+
+                if (success) {
+                    msw_pack_close(packptr);
+                    *packptr = pack;
+
+                    return 1;
+                }
+
+                if (pack->index_cap > 0)
+                    free(pack->index);
+                munmap(pack->map, pack->map_size);
+            }
+        }
+
+        if (pack->fd != -1)
+            close(pack->fd);
+
+        free(pack);
+    }
+
+    return 0;
+}
+
+/* msw_pack_count restituisce il numero di schemi del pacchetto. */
+long msw_pack_count(msw_pack pack) {
+    return pack->board_cnt;
+}
+
+/* msw_pack_record restituisce il record dello schema con identificativo id,
+ * direttamente dalla memoria mappata, oppure NULL se lo schema non esiste o
+ * il pacchetto non è aperto in lettura.
+ */
+const struct msw_pack_record_struct *msw_pack_record(msw_pack pack, long id) {
+    if (pack->writable || id < 0 || id >= pack->board_cnt)
+        return NULL;
+
+    return (const struct msw_pack_record_struct*) ((const char*) pack->map + pack->index[id]);
+}
+
+/* msw_pack_load crea un nuovo campo con le stesse modalità di msw_create, con
+ * lo schema con identificativo id del pacchetto, e restituisce vero se la
+ * creazione è avvenuta con successo.
+ */
+int msw_pack_load(msw_pack pack, long id, msw_field *fieldptr) {
+    const struct msw_pack_record_struct *record = msw_pack_record(pack, id);
+    msw_field field = NULL;
+
+    if (record && msw_create(&field, record->width, record->height)) {
+        const uint64_t *bitmap = (const uint64_t*) (record + 1);
+        long words = ((long) record->width * record->height + 63) / 64, w;
+        int success = 1;
+
+        /* Piazzamento delle mine scorrendo solamente i bit a 1 della bitmap. */
+        for (w = 0; success && w < words; w++) {
+            uint64_t bits = bitmap[w];
+
+            while (success && bits) {
+                long index = w * 64 + __builtin_ctzll(bits);
+
+                success = msw_mine_cell(field, (int) (index % record->width), (int) (index / record->width));
+                bits &= bits - 1;
+            }
+        }
+
+        if (success) {
+            msw_destroy(fieldptr);
+            *fieldptr = field;
+
+            return 1;
+        }
+
+        msw_destroy(&field);
+    }
+
+    return 0;
+}
+
+/* msw_pack_close chiude il pacchetto riferito da *packptr e assegna NULL a
+ * *packptr. Se il pacchetto è aperto in scrittura, tutte le aggiunte devono
+ * essere terminate: vengono scritti l'indice e l'intestazione definitiva e
+ * viene restituito vero se la scrittura è avvenuta con successo.
+ */
+int msw_pack_close(msw_pack *packptr) {
+    msw_pack pack = *packptr;
+    int success = 1;
+
+    if (pack) {
+        if (pack->writable) {
+            struct msw_pack_header_struct header;
+
+            memcpy(header.magic, MSW_PACK_MAGIC, sizeof(header.magic));
+            header.board_cnt = pack->board_cnt;
+            header.index_offset = pack->end;
+
+            success = msw_pack_write(pack->fd, pack->index, pack->board_cnt * sizeof(uint64_t), pack->end) &&
+                      fsync(pack->fd) == 0 &&
+                      msw_pack_write(pack->fd, &header, sizeof(header), 0) &&
+                      fsync(pack->fd) == 0;
+
+            pthread_mutex_destroy(&pack->lock);
+        } else
+            munmap(pack->map, pack->map_size);
+
+        if (pack->index_cap > 0)
+            free(pack->index);
+
+        close(pack->fd);
+        free(pack);
+
+        *packptr = NULL;
+    }
+
+    return success;
+}
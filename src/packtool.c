@@ -0,0 +1,108 @@
+#include <stdio.h> /* printf, fprintf */
+#include <stdlib.h> /* strtol, strtoul */
+#include <string.h> /* strcmp */
+#include "minesweeper.h"
+#include "pack.h"
+
+/* Lo strumento dei pacchetti genera un pacchetto di schemi e lo scorre:
+ *
+ * packtool create <file> <schemi> <larghezza> <altezza> <mine> [seed]
+ *     Crea il pacchetto con gli schemi generati da msw_create_seeded con i
+ *     seed seed, seed + 1, ... (1 se non indicato).
+ *
+ * packtool list <file>
+ *     Scorre il pacchetto in ordine di identificativo, stampando le metriche
+ *     di ogni schema, e verifica che ogni schema si carichi con il numero di
+ *     mine indicato nel suo record.
+ */
+
+/* packtool_usage stampa l'uso dello strumento e restituisce 1. */
+static int packtool_usage(const char *name) {
+    fprintf(stderr, "Uso: %s create <file> <schemi> <larghezza> <altezza> <mine> [seed]\n", name);
+    fprintf(stderr, "     %s list <file>\n", name);
+
+    return 1;
+}
+
+/* packtool_create genera il pacchetto path con count schemi. */
+static int packtool_create(const char *path, long count, int width, int height, long mines, unsigned long seed) {
+    msw_pack pack = NULL;
+    msw_field field = NULL;
+    long i;
+    int success;
+
+    if (!msw_pack_create(&pack, path)) {
+        fprintf(stderr, "Non sono riuscito a creare il pacchetto %s.\n", path);
+        return 1;
+    }
+
+    for (i = 0, success = 1; success && i < count; i++)
+        success = msw_create_seeded(&field, width, height, mines, seed + i) &&
+                  msw_pack_append(pack, field, seed + i, NULL);
+
+    msw_destroy(&field);
+
+    if (!msw_pack_close(&pack) || !success) {
+        fprintf(stderr, "Non sono riuscito a scrivere il pacchetto %s.\n", path);
+        return 1;
+    }
+
+    printf("%ld schemi %dx%d con %ld mine scritti in %s\n", count, width, height, mines, path);
+
+    return 0;
+}
+
+/* packtool_list scorre il pacchetto path. */
+static int packtool_list(const char *path) {
+    msw_pack pack = NULL;
+    msw_field field = NULL;
+    long count, id, bad = 0;
+    double bbbv = 0;
+
+    if (!msw_pack_open(&pack, path)) {
+        fprintf(stderr, "Non sono riuscito ad aprire il pacchetto %s.\n", path);
+        return 1;
+    }
+
+    count = msw_pack_count(pack);
+    printf("%8s %12s %11s %8s %8s %8s\n", "schema", "seed", "dimensioni", "mine", "3BV", "aperture");
+
+    for (id = 0; id < count; id++) {
+        const struct msw_pack_record_struct *record = msw_pack_record(pack, id);
+        char size[24];
+
+        sprintf(size, "%dx%d", (int) record->width, (int) record->height);
+        printf("%8ld %12lu %11s %8ld %8ld %8ld\n", id, (unsigned long) record->seed, size,
+               (long) record->mine_cnt, (long) record->bbbv, (long) record->openings);
+
+        if (!msw_pack_load(pack, id, &field) || field->mine_cnt != record->mine_cnt)
+            bad++;
+
+        bbbv += record->bbbv;
+    }
+
+    printf("%ld schemi, 3BV medio %.1f, %ld non caricati correttamente\n", count, (count > 0 ? bbbv / count : 0), bad);
+
+    msw_destroy(&field);
+    msw_pack_close(&pack);
+
+    return (bad > 0);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 7 || argc == 8) {
+        if (strcmp(argv[1], "create") == 0) {
+            long count = strtol(argv[3], NULL, 10), mines = strtol(argv[6], NULL, 10);
+            int width = (int) strtol(argv[4], NULL, 10), height = (int) strtol(argv[5], NULL, 10);
+            unsigned long seed = (argc == 8 ? strtoul(argv[7], NULL, 10) : 1);
+
+            if (count < 0 || width < 1 || height < 1 || mines < 0 || mines >= (long) width * height)
+                return packtool_usage(argv[0]);
+
+            return packtool_create(argv[2], count, width, height, mines, seed);
+        }
+    } else if (argc == 3 && strcmp(argv[1], "list") == 0)
+        return packtool_list(argv[2]);
+
+    return packtool_usage(argv[0]);
+}
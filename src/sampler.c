@@ -0,0 +1,780 @@
+#include <stdlib.h> /* malloc, calloc, free */
+#include <string.h> /* memset */
+#include <math.h> /* sqrt */
+#include <time.h> /* clock_gettime */
+#include <pthread.h> /* pthread_create, pthread_join */
+#include "minesweeper.h"
+#include "sampler.h"
+
+/* msw_sampler_find restituisce la variabile della cella di posizione index,
+ * oppure -1 se la cella non appartiene alla frontiera.
+ */
+static int msw_sampler_find(msw_sampler sampler, long index) {
+    int lo = 0, hi = sampler->var_cnt - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (sampler->var_cell[mid] < index)
+            lo = mid + 1;
+        else if (sampler->var_cell[mid] > index)
+            hi = mid - 1;
+        else
+            return mid;
+    }
+
+    return -1;
+}
+
+/* msw_sampler_hidden verifica se lo stato visibile state è quello di una
+ * cella nascosta (eventualmente marcata: le bandiere non sono deduzioni).
+ */
+static int msw_sampler_hidden(int state) {
+    return (state == STATE_HIDDEN || state == STATE_FLAG);
+}
+
+/* msw_sampler_build ricava dal campo le variabili, i numeri e le loro
+ * adiacenze e restituisce vero se l'operazione è avvenuta con successo.
+ */
+static int msw_sampler_build(msw_sampler sampler, msw_field field) {
+    long hidden = 0, visible_mines = 0, links = 0;
+    int *stamp = NULL, *fill = NULL, x, y, x0, y0, v, c, i, j;
+
+    /* Prima scansione: variabili e numeri, con lo spazio delle adiacenze. */
+    for (y = 0; y < field->height; y++)
+        for (x = 0; x < field->width; x++) {
+            int state = msw_cell_state(field, x, y), near = 0;
+
+            if (state == STATE_MINE)
+                visible_mines++;
+
+            for (y0 = y - 1; y0 <= y + 1; y0++)
+                for (x0 = x - 1; x0 <= x + 1; x0++)
+                    if ((x0 != x || y0 != y) && msw_cell_exists(field, x0, y0)) {
+                        int near_state = msw_cell_state(field, x0, y0);
+
+                        if (msw_sampler_hidden(state) ? near_state <= 8 : msw_sampler_hidden(near_state))
+                            near++;
+                    }
+
+            if (msw_sampler_hidden(state)) {
+                hidden++;
+                if (near > 0)
+                    sampler->var_cnt++;
+            } else if (state <= 8 && near > 0) {
+                sampler->con_cnt++;
+                links += near;
+            }
+        }
+
+    sampler->mines = msw_mine_total(field) - visible_mines;
+    sampler->interior = hidden - sampler->var_cnt;
+
+    sampler->var_cell = (long*) malloc((sampler->var_cnt + 1) * sizeof(long));
+    sampler->var_con = (int*) malloc((links + 1) * sizeof(int));
+    sampler->var_con_start = (int*) calloc(sampler->var_cnt + 1, sizeof(int));
+    sampler->con_value = (int*) malloc((sampler->con_cnt + 1) * sizeof(int));
+    sampler->con_var = (int*) malloc((links + 1) * sizeof(int));
+    sampler->con_var_start = (int*) malloc((sampler->con_cnt + 1) * sizeof(int));
+    sampler->freq = (double*) calloc(sampler->var_cnt + 1, sizeof(double));
+    fill = (int*) calloc(sampler->var_cnt + 1, sizeof(int));
+    stamp = (int*) malloc((sampler->var_cnt + 1) * sizeof(int));
+
+    if (!sampler->var_cell || !sampler->var_con || !sampler->var_con_start || !sampler->con_value ||
+        !sampler->con_var || !sampler->con_var_start || !sampler->freq || !fill || !stamp) {
+        free(fill);
+        free(stamp);
+        return 0;
+    }
+
+    /* Seconda scansione: posizioni delle variabili, in ordine crescente. */
+    v = 0;
+    for (y = 0; y < field->height; y++)
+        for (x = 0; x < field->width; x++)
+            if (msw_sampler_hidden(msw_cell_state(field, x, y))) {
+                int near = 0;
+
+                for (y0 = y - 1; y0 <= y + 1 && !near; y0++)
+                    for (x0 = x - 1; x0 <= x + 1; x0++)
+                        if ((x0 != x || y0 != y) && msw_cell_exists(field, x0, y0) && msw_cell_state(field, x0, y0) <= 8)
+                            near = 1;
+
+                if (near)
+                    sampler->var_cell[v++] = (long) y * field->width + x;
+            }
+
+    /* Terza scansione: numeri, con le mine nascoste che mancano a ognuno e
+     * le loro variabili.
+     */
+    c = 0;
+    i = 0;
+    for (y = 0; y < field->height; y++)
+        for (x = 0; x < field->width; x++) {
+            int state = msw_cell_state(field, x, y), start = i, value = state;
+
+            if (msw_sampler_hidden(state) || state > 8)
+                continue;
+
+            for (y0 = y - 1; y0 <= y + 1; y0++)
+                for (x0 = x - 1; x0 <= x + 1; x0++)
+                    if ((x0 != x || y0 != y) && msw_cell_exists(field, x0, y0)) {
+                        int near_state = msw_cell_state(field, x0, y0);
+
+                        if (near_state == STATE_MINE)
+                            value--;
+                        else if (msw_sampler_hidden(near_state)) {
+                            v = msw_sampler_find(sampler, (long) y0 * field->width + x0);
+                            sampler->con_var[i++] = v;
+                            sampler->var_con_start[v + 1]++;
+                        }
+                    }
+
+            if (i > start) {
+                sampler->con_var_start[c] = start;
+                sampler->con_value[c++] = value;
+            }
+        }
+    sampler->con_var_start[c] = i;
+
+    /* Inversione: i numeri di ogni variabile. */
+    for (v = 0; v < sampler->var_cnt; v++)
+        sampler->var_con_start[v + 1] += sampler->var_con_start[v];
+
+    for (c = 0; c < sampler->con_cnt; c++)
+        for (i = sampler->con_var_start[c]; i < sampler->con_var_start[c + 1]; i++) {
+            v = sampler->con_var[i];
+            sampler->var_con[sampler->var_con_start[v] + fill[v]++] = c;
+        }
+
+    /* Adiacenze tra variabili: quelle che condividono un numero, senza
+     * ripetizioni. Ogni variabile ne ha al più 24.
+     */
+    sampler->var_adj_start = (int*) malloc((sampler->var_cnt + 1) * sizeof(int));
+    sampler->var_adj = (int*) malloc(((long) sampler->var_cnt * 24 + 1) * sizeof(int));
+    if (!sampler->var_adj_start || !sampler->var_adj) {
+        free(fill);
+        free(stamp);
+        return 0;
+    }
+
+    for (v = 0; v < sampler->var_cnt; v++)
+        stamp[v] = -1;
+
+    j = 0;
+    for (v = 0; v < sampler->var_cnt; v++) {
+        sampler->var_adj_start[v] = j;
+        stamp[v] = v;
+
+        for (i = sampler->var_con_start[v]; i < sampler->var_con_start[v + 1]; i++) {
+            int k;
+
+            c = sampler->var_con[i];
+            for (k = sampler->con_var_start[c]; k < sampler->con_var_start[c + 1]; k++)
+                if (stamp[sampler->con_var[k]] != v) {
+                    stamp[sampler->con_var[k]] = v;
+                    sampler->var_adj[j++] = sampler->con_var[k];
+                }
+        }
+    }
+    sampler->var_adj_start[sampler->var_cnt] = j;
+
+    free(fill);
+    free(stamp);
+
+    return 1;
+}
+
+/* msw_sampler_create crea un nuovo campionatore per lo stato visibile attuale
+ * del campo, assegna il puntatore a *samplerptr (se *samplerptr è un
+ * puntatore non nullo, viene prima distrutto il campionatore riferito da
+ * esso) e restituisce vero se la creazione è avvenuta con successo. Il
+ * campionatore non fa riferimento al campo dopo la creazione.
+ */
+int msw_sampler_create(msw_sampler *samplerptr, msw_field field) {
+    msw_sampler sampler = (msw_sampler) calloc(1, sizeof(struct msw_sampler_struct));
+
+    if (sampler) {
+        sampler->width = field->width;
+        sampler->height = field->height;
+
+        if (msw_sampler_build(sampler, field)) {
+            sampler->error = 1;
+
+            msw_sampler_destroy(samplerptr);
+            *samplerptr = sampler;
+
+            return 1;
+        }
+
+        msw_sampler_destroy(&sampler);
+    }
+
+    return 0;
+}
+
+/* msw_sampler_destroy distrugge un campionatore precedentemente creato. */
+void msw_sampler_destroy(msw_sampler *samplerptr) {
+    if (*samplerptr) {
+        msw_sampler sampler = *samplerptr;
+
+        free(sampler->var_cell);
+        free(sampler->var_con);
+        free(sampler->var_con_start);
+        free(sampler->var_adj);
+        free(sampler->var_adj_start);
+        free(sampler->con_value);
+        free(sampler->con_var);
+        free(sampler->con_var_start);
+        free(sampler->freq);
+        free(sampler);
+
+        *samplerptr = NULL;
+    }
+}
+
+/* La struttura che rappresenta una catena.
+ *
+ * rng
+ *     Lo stato del flusso casuale della catena.
+ *
+ * ready
+ *     Vero se la catena ha trovato uno schema coerente da cui partire.
+ *
+ * mine, count, k
+ *     Lo schema corrente (vero per ogni variabile con una mina), il numero
+ *     di mine attorno ad ogni numero e il numero di mine dello schema.
+ *
+ * stamp, token
+ *     Per ogni numero, l'ultimo blocco che lo ha raccolto, per raccogliere
+ *     i numeri di un blocco senza ripetizioni.
+ *
+ * options, weights
+ *     Gli schemi coerenti del blocco in aggiornamento e i loro pesi
+ *     cumulati.
+ *
+ * sweeps
+ *     Il numero di passate eseguite.
+ *
+ * hits, interior, samples
+ *     Per ogni variabile, il numero di schemi contati in cui contiene una
+ *     mina; la somma della frequenza delle celle lontane dai numeri sugli
+ *     stessi schemi; il numero di schemi contati.
+ */
+struct msw_sampler_chain_struct {
+    uint64_t rng;
+    int ready;
+    unsigned char *mine;
+    int *count;
+    long k;
+    int *stamp, token;
+    unsigned int options[1 << MSW_SAMPLER_BLOCK];
+    double weights[1 << MSW_SAMPLER_BLOCK];
+    long sweeps;
+    long *hits;
+    double interior;
+    long samples;
+};
+
+/* La struttura che rappresenta un'esecuzione di msw_sampler_run, condivisa
+ * dai thread.
+ *
+ * sampler, chains, chain_cnt
+ *     Il campionatore, le catene e il loro numero.
+ *
+ * order
+ *     Le variabili in ordine di visita in ampiezza lungo le adiacenze, per
+ *     la ricerca dello schema iniziale: i numeri restano parzialmente
+ *     assegnati per poco tempo e i vicoli ciechi emergono presto.
+ *
+ * samples, deadline
+ *     I limiti: il numero di schemi (0 se nessun limite) e l'istante in
+ *     millisecondi (0 se nessun limite).
+ *
+ * total
+ *     Il numero di schemi contati da tutte le catene.
+ */
+struct msw_sampler_run_struct {
+    msw_sampler sampler;
+    struct msw_sampler_chain_struct *chains;
+    int chain_cnt;
+    int *order;
+    long samples, deadline;
+    long total;
+};
+
+/* La struttura che rappresenta il lavoro di un thread: le catene da first a
+ * last - 1.
+ */
+struct msw_sampler_worker_struct {
+    struct msw_sampler_run_struct *run;
+    int first, last;
+};
+
+/* msw_sampler_now restituisce il tempo corrente in millisecondi, da un
+ * orologio monotono.
+ */
+static long msw_sampler_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* msw_sampler_expired verifica se uno dei limiti dell'esecuzione è stato
+ * raggiunto.
+ */
+static int msw_sampler_expired(struct msw_sampler_run_struct *run) {
+    return ((run->samples > 0 && __atomic_load_n(&run->total, __ATOMIC_RELAXED) >= run->samples) ||
+            (run->deadline > 0 && msw_sampler_now() >= run->deadline));
+}
+
+/* msw_sampler_uniform restituisce un numero casuale in [0, 1). */
+static double msw_sampler_uniform(uint64_t *rng) {
+    return (double) (msw_splitmix(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* msw_sampler_below restituisce un numero casuale in [0, n). */
+static long msw_sampler_below(uint64_t *rng, long n) {
+    return (long) (msw_splitmix(rng) % (uint64_t) n);
+}
+
+/* msw_sampler_solve cerca uno schema coerente da cui far partire la catena,
+ * con una ricerca in profondità con ritorno sulle variabili in ordine
+ * run->order, provando per prima una mina con probabilità pari alla densità
+ * delle mine nascoste, così che catene diverse partano da schemi diversi.
+ * Restituisce vero se lo schema è stato trovato entro un numero di passi
+ * proporzionale alle variabili e prima dei limiti dell'esecuzione.
+ */
+static int msw_sampler_solve(struct msw_sampler_run_struct *run, struct msw_sampler_chain_struct *chain) {
+    msw_sampler sampler = run->sampler;
+    long hidden = sampler->var_cnt + sampler->interior, steps = 0;
+    long budget = 64L * sampler->var_cnt + 4096;
+    int *free_cnt = (int*) malloc((sampler->con_cnt + 1) * sizeof(int));
+    signed char *tried = (signed char*) malloc(sampler->var_cnt + 1);
+    int depth = 0, success = 0, c, i;
+
+    if (!free_cnt || !tried) {
+        free(free_cnt);
+        free(tried);
+        return 0;
+    }
+
+    /* tried[d] vale 0 se la variabile alla profondità d non è ancora stata
+     * assegnata, 1 dopo il primo valore e 2 dopo il secondo.
+     */
+    for (c = 0; c < sampler->con_cnt; c++)
+        free_cnt[c] = sampler->con_var_start[c + 1] - sampler->con_var_start[c];
+
+    memset(tried, 0, sampler->var_cnt);
+
+    while (depth >= 0 && depth < sampler->var_cnt) {
+        int v = run->order[depth], value, ok = 1;
+
+        if (++steps > budget || (steps % 4096 == 0 && msw_sampler_expired(run)))
+            break;
+
+        /* Annullamento del valore precedente della variabile, se presente. */
+        if (tried[depth] > 0) {
+            for (i = sampler->var_con_start[v]; i < sampler->var_con_start[v + 1]; i++) {
+                c = sampler->var_con[i];
+                chain->count[c] -= chain->mine[v];
+                free_cnt[c]++;
+            }
+            chain->k -= chain->mine[v];
+        }
+
+        if (tried[depth] == 2) {
+            tried[depth] = 0;
+            depth--;
+            continue;
+        }
+
+        if (tried[depth] == 0)
+            value = (msw_sampler_below(&chain->rng, hidden) < sampler->mines);
+        else
+            value = !chain->mine[v];
+
+        tried[depth]++;
+        chain->mine[v] = (unsigned char) value;
+        chain->k += value;
+
+        for (i = sampler->var_con_start[v]; i < sampler->var_con_start[v + 1]; i++) {
+            c = sampler->var_con[i];
+            chain->count[c] += value;
+            free_cnt[c]--;
+
+            if (chain->count[c] > sampler->con_value[c] || chain->count[c] + free_cnt[c] < sampler->con_value[c])
+                ok = 0;
+        }
+
+        /* Le mine della frontiera devono lasciare alle celle lontane dai
+         * numeri un numero di mine compreso tra 0 e interior.
+         */
+        if (chain->k > sampler->mines ||
+            chain->k + (sampler->var_cnt - depth - 1) < sampler->mines - sampler->interior)
+            ok = 0;
+
+        if (ok)
+            depth++;
+    }
+
+    success = (depth == sampler->var_cnt);
+
+    free(free_cnt);
+    free(tried);
+
+    return success;
+}
+
+/* msw_sampler_block aggiorna la catena con un passo di Gibbs a blocchi: il
+ * blocco è formato dalla variabile a e da al più MSW_SAMPLER_BLOCK - 1
+ * variabili vicine ad essa, scelte a caso, e viene riassegnato con uno
+ * degli schemi del blocco coerenti con i numeri (le altre variabili restano
+ * ferme), scelto con probabilità proporzionale al peso dello schema
+ * completo. Gli schemi del blocco sono percorsi in ordine di Gray, così che
+ * ognuno differisca dal precedente per una sola variabile.
+ */
+static void msw_sampler_block(msw_sampler sampler, struct msw_sampler_chain_struct *chain, int a) {
+    int block[MSW_SAMPLER_BLOCK], size = 1, violated = 0, option_cnt = 0, adj, n, i, j;
+    double weight[MSW_SAMPLER_BLOCK + 1], total;
+    unsigned int gray, code, chosen;
+    long k0, lo, hi;
+
+    /* Il blocco cresce in ampiezza a partire da a, con le adiacenti di ogni
+     * variabile percorse da una posizione casuale, così che comprenda tratti
+     * di frontiera che possono cambiare solo insieme. La scelta non dipende
+     * dallo schema corrente.
+     */
+    block[0] = a;
+    for (n = 0; n < size && size < MSW_SAMPLER_BLOCK; n++) {
+        int u = block[n], offset;
+
+        adj = sampler->var_adj_start[u + 1] - sampler->var_adj_start[u];
+        if (adj == 0)
+            continue;
+
+        offset = (int) msw_sampler_below(&chain->rng, adj);
+        for (i = 0; i < adj && size < MSW_SAMPLER_BLOCK; i++) {
+            int w = sampler->var_adj[sampler->var_adj_start[u] + (offset + i) % adj];
+
+            for (j = 0; j < size && block[j] != w; j++)
+                ;
+            if (j == size)
+                block[size++] = w;
+        }
+    }
+
+    /* Azzeramento del blocco e conteggio dei numeri violati tra quelli del
+     * blocco, raccolti senza ripetizioni.
+     */
+    chain->token++;
+    for (i = 0; i < size; i++) {
+        int v = block[i];
+
+        for (j = sampler->var_con_start[v]; j < sampler->var_con_start[v + 1]; j++)
+            chain->count[sampler->var_con[j]] -= chain->mine[v];
+
+        chain->k -= chain->mine[v];
+        chain->mine[v] = 0;
+    }
+
+    for (i = 0; i < size; i++)
+        for (j = sampler->var_con_start[block[i]]; j < sampler->var_con_start[block[i] + 1]; j++) {
+            int c = sampler->var_con[j];
+
+            if (chain->stamp[c] != chain->token) {
+                chain->stamp[c] = chain->token;
+                violated += (chain->count[c] != sampler->con_value[c]);
+            }
+        }
+
+    /* Pesi C(interior, mines - k0 - n) relativi, per n mine nel blocco. */
+    k0 = chain->k;
+    lo = sampler->mines - k0 - sampler->interior;
+    hi = sampler->mines - k0;
+    for (i = 0; i <= size; i++)
+        weight[i] = 0;
+    for (i = (lo > 0 ? (int) lo : 0); i <= size && i <= hi; i++) {
+        long rest = sampler->mines - k0 - i;
+
+        weight[i] = (i == (lo > 0 ? lo : 0) ? 1 : weight[i - 1] * (rest + 1) / (sampler->interior - rest));
+    }
+
+    /* Enumerazione degli schemi del blocco in ordine di Gray. */
+    total = 0;
+    for (gray = 0, code = 0; ; ) {
+        if (violated == 0 && weight[chain->k - k0] > 0) {
+            total += weight[chain->k - k0];
+            chain->options[option_cnt] = code;
+            chain->weights[option_cnt++] = total;
+        }
+
+        if (++gray == (1U << size))
+            break;
+
+        /* La variabile da invertire è quella del bit meno significativo di
+         * gray.
+         */
+        for (i = 0; !(gray & (1U << i)); i++)
+            ;
+
+        {
+            int v = block[i], d = (chain->mine[v] ? -1 : 1);
+
+            chain->mine[v] = !chain->mine[v];
+            chain->k += d;
+            code ^= 1U << i;
+
+            for (j = sampler->var_con_start[v]; j < sampler->var_con_start[v + 1]; j++) {
+                int c = sampler->var_con[j], before = (chain->count[c] == sampler->con_value[c]);
+
+                chain->count[c] += d;
+                violated += before - (chain->count[c] == sampler->con_value[c]);
+            }
+        }
+    }
+
+    /* Scelta dello schema e passaggio ad esso dall'ultimo enumerato. Lo
+     * schema di partenza è coerente, quindi option_cnt > 0.
+     */
+    total *= msw_sampler_uniform(&chain->rng);
+    for (j = 0; j < option_cnt - 1 && chain->weights[j] <= total; j++)
+        ;
+    chosen = chain->options[j];
+
+    for (i = 0; i < size; i++)
+        if (((code ^ chosen) >> i) & 1) {
+            int v = block[i], d = (chain->mine[v] ? -1 : 1);
+
+            chain->mine[v] = !chain->mine[v];
+            chain->k += d;
+
+            for (j = sampler->var_con_start[v]; j < sampler->var_con_start[v + 1]; j++)
+                chain->count[sampler->var_con[j]] += d;
+        }
+}
+
+/* msw_sampler_sweep esegue una passata della catena (tanti aggiornamenti a
+ * blocchi quanti servono a coprire in media ogni variabile una volta) e, dopo
+ * le passate iniziali, conta lo schema raggiunto.
+ */
+static void msw_sampler_sweep(msw_sampler sampler, struct msw_sampler_chain_struct *chain) {
+    int n, v;
+
+    for (n = 0; n < sampler->var_cnt; n += MSW_SAMPLER_BLOCK)
+        msw_sampler_block(sampler, chain, (int) msw_sampler_below(&chain->rng, sampler->var_cnt));
+
+    if (++chain->sweeps > MSW_SAMPLER_BURN) {
+        for (v = 0; v < sampler->var_cnt; v++)
+            chain->hits[v] += chain->mine[v];
+
+        if (sampler->interior > 0)
+            chain->interior += (double) (sampler->mines - chain->k) / sampler->interior;
+
+        chain->samples++;
+    }
+}
+
+/* msw_sampler_main è il corpo di un thread: cerca lo schema iniziale delle
+ * proprie catene e le fa avanzare a turno, una passata alla volta, finché
+ * non viene raggiunto uno dei limiti.
+ */
+static void *msw_sampler_main(void *arg) {
+    struct msw_sampler_worker_struct *worker = (struct msw_sampler_worker_struct*) arg;
+    struct msw_sampler_run_struct *run = worker->run;
+    int i, active = 0;
+
+    for (i = worker->first; i < worker->last; i++) {
+        run->chains[i].ready = msw_sampler_solve(run, run->chains + i);
+        active += run->chains[i].ready;
+    }
+
+    while (active > 0 && !msw_sampler_expired(run))
+        for (i = worker->first; i < worker->last; i++) {
+            struct msw_sampler_chain_struct *chain = run->chains + i;
+
+            if (chain->ready) {
+                long before = chain->samples;
+
+                msw_sampler_sweep(run->sampler, chain);
+
+                if (chain->samples > before)
+                    __sync_fetch_and_add(&run->total, chain->samples - before);
+            }
+        }
+
+    return NULL;
+}
+
+/* msw_sampler_order compila run->order, visitando in ampiezza ogni gruppo di
+ * variabili collegate da numeri comuni, e restituisce vero se l'operazione
+ * è avvenuta con successo.
+ */
+static int msw_sampler_order(struct msw_sampler_run_struct *run) {
+    msw_sampler sampler = run->sampler;
+    unsigned char *seen = (unsigned char*) calloc(sampler->var_cnt + 1, 1);
+    int head = 0, tail = 0, v, i;
+
+    run->order = (int*) malloc((sampler->var_cnt + 1) * sizeof(int));
+    if (!seen || !run->order) {
+        free(seen);
+        return 0;
+    }
+
+    for (v = 0; v < sampler->var_cnt; v++)
+        if (!seen[v]) {
+            seen[v] = 1;
+            run->order[tail++] = v;
+
+            while (head < tail) {
+                int u = run->order[head++];
+
+                for (i = sampler->var_adj_start[u]; i < sampler->var_adj_start[u + 1]; i++)
+                    if (!seen[sampler->var_adj[i]]) {
+                        seen[sampler->var_adj[i]] = 1;
+                        run->order[tail++] = sampler->var_adj[i];
+                    }
+            }
+        }
+
+    free(seen);
+
+    return 1;
+}
+
+/* msw_sampler_run campiona gli schemi coerenti finché non sono stati contati
+ * samples schemi oppure non sono trascorsi ms millisecondi (un limite nullo
+ * non viene considerato, ma almeno uno dei due deve essere positivo), con i
+ * flussi casuali delle catene derivati da seed, e compila le frequenze
+ * stimate e il margine di errore. Restituisce vero se è stato contato
+ * almeno uno schema.
+ */
+int msw_sampler_run(msw_sampler sampler, long samples, long ms, uint64_t seed) {
+    struct msw_sampler_run_struct run;
+    struct msw_sampler_worker_struct workers[MSW_PARALLEL_MAX];
+    pthread_t threads[MSW_PARALLEL_MAX];
+    int thread_cnt = msw_thread_count(), started = 0, success = 1, i, v;
+
+    sampler->sample_cnt = 0;
+    sampler->chain_cnt = 0;
+    sampler->error = 1;
+    sampler->interior_freq = (sampler->interior > 0 ? (double) sampler->mines / sampler->interior : 0);
+
+    if ((samples <= 0 && ms <= 0) || sampler->mines < 0 ||
+        sampler->mines > sampler->var_cnt + sampler->interior)
+        return 0;
+
+    /* Senza frontiera, tutte le celle nascoste sono indistinguibili. */
+    if (sampler->var_cnt == 0) {
+        sampler->error = 0;
+        return 1;
+    }
+
+    run.sampler = sampler;
+    run.chain_cnt = (thread_cnt > MSW_SAMPLER_CHAINS ? thread_cnt : MSW_SAMPLER_CHAINS);
+    run.samples = samples;
+    run.deadline = (ms > 0 ? msw_sampler_now() + ms : 0);
+    run.total = 0;
+    run.order = NULL;
+
+    run.chains = (struct msw_sampler_chain_struct*) calloc(run.chain_cnt, sizeof(struct msw_sampler_chain_struct));
+    if (!run.chains || !msw_sampler_order(&run)) {
+        free(run.chains);
+        free(run.order);
+        return 0;
+    }
+
+    for (i = 0; i < run.chain_cnt && success; i++) {
+        struct msw_sampler_chain_struct *chain = run.chains + i;
+
+        chain->rng = seed ^ ((uint64_t) (i + 1) * 0xd1b54a32d192ed03UL);
+        chain->mine = (unsigned char*) calloc(sampler->var_cnt, 1);
+        chain->count = (int*) calloc(sampler->con_cnt + 1, sizeof(int));
+        chain->stamp = (int*) calloc(sampler->con_cnt + 1, sizeof(int));
+        chain->hits = (long*) calloc(sampler->var_cnt, sizeof(long));
+        success = (chain->mine && chain->count && chain->stamp && chain->hits);
+    }
+
+    if (success) {
+        /* Le catene sono divise in intervalli consecutivi; il thread
+         * chiamante esegue l'ultimo, più quelli dei thread non avviati.
+         */
+        for (i = 0; i < thread_cnt; i++) {
+            workers[i].run = &run;
+            workers[i].first = (int) ((long) run.chain_cnt * i / thread_cnt);
+            workers[i].last = (int) ((long) run.chain_cnt * (i + 1) / thread_cnt);
+        }
+
+        while (started + 1 < thread_cnt &&
+               pthread_create(&threads[started], NULL, msw_sampler_main, &workers[started]) == 0)
+            started++;
+
+        workers[thread_cnt - 1].first = workers[started].first;
+        msw_sampler_main(&workers[thread_cnt - 1]);
+
+        for (i = 0; i < started; i++)
+            pthread_join(threads[i], NULL);
+    }
+
+    if (success) {
+        double max_se = 0, interior = 0;
+
+        for (i = 0; i < run.chain_cnt; i++)
+            if (run.chains[i].samples > 0) {
+                sampler->sample_cnt += run.chains[i].samples;
+                sampler->chain_cnt++;
+                interior += run.chains[i].interior;
+            }
+
+        for (v = 0; v < sampler->var_cnt; v++) {
+            long hits = 0;
+            double mean, square = 0;
+
+            for (i = 0; i < run.chain_cnt; i++)
+                hits += run.chains[i].hits[v];
+
+            mean = (sampler->sample_cnt > 0 ? (double) hits / sampler->sample_cnt : 0);
+            sampler->freq[v] = mean;
+
+            /* Errore standard della media tra le catene. */
+            for (i = 0; i < run.chain_cnt; i++)
+                if (run.chains[i].samples > 0) {
+                    double d = (double) run.chains[i].hits[v] / run.chains[i].samples - mean;
+
+                    square += d * d;
+                }
+
+            if (sampler->chain_cnt > 1 && square / (sampler->chain_cnt * (sampler->chain_cnt - 1.0)) > max_se * max_se)
+                max_se = sqrt(square / (sampler->chain_cnt * (sampler->chain_cnt - 1.0)));
+        }
+
+        if (sampler->sample_cnt > 0 && sampler->interior > 0)
+            sampler->interior_freq = interior / sampler->sample_cnt;
+
+        if (sampler->chain_cnt > 1)
+            sampler->error = 2 * max_se;
+
+        success = (sampler->sample_cnt > 0);
+    }
+
+    for (i = 0; i < run.chain_cnt; i++) {
+        free(run.chains[i].mine);
+        free(run.chains[i].count);
+        free(run.chains[i].stamp);
+        free(run.chains[i].hits);
+    }
+    free(run.chains);
+    free(run.order);
+
+    return success;
+}
+
+/* msw_sampler_get restituisce la frequenza stimata con cui la cella nascosta
+ * (x, y) contiene una mina, dopo msw_sampler_run.
+ */
+double msw_sampler_get(msw_sampler sampler, int x, int y) {
+    int v = msw_sampler_find(sampler, (long) y * sampler->width + x);
+
+    return (v >= 0 ? sampler->freq[v] : sampler->interior_freq);
+}
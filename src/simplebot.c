@@ -0,0 +1,119 @@
+#include <stdlib.h> /* malloc, free */
+#include "bot.h"
+
+/* Un bot di esempio per l'arena: applica le due regole elementari a ogni
+ * numero (se le bandiere attorno ad esso sono complete, le altre celle
+ * nascoste sono sicure; se le celle nascoste sono tante quante le mine che
+ * mancano, contengono tutte una mina) e, se nessuna regola si applica,
+ * visita una cella nascosta a caso. Dipende solamente da bot.h.
+ */
+
+/* La struttura che rappresenta lo stato di una partita: il generatore
+ * pseudo-casuale dei tentativi.
+ */
+struct simplebot_struct {
+    unsigned long rng;
+};
+
+/* simplebot_around conta le celle nascoste e le bandiere attorno a (x, y). */
+static void simplebot_around(const struct msw_bot_view_struct *view, int x, int y, int *hidden, int *flags) {
+    int x0, y0;
+
+    *hidden = 0;
+    *flags = 0;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++)
+        for (x0 = x - 1; x0 <= x + 1; x0++)
+            if (x0 >= 0 && y0 >= 0 && x0 < view->width && y0 < view->height) {
+                int state = view->cells[(long) y0 * view->width + x0];
+
+                if (state == BOT_HIDDEN)
+                    (*hidden)++;
+                else if (state == BOT_FLAG)
+                    (*flags)++;
+            }
+}
+
+/* simplebot_hidden cerca una cella nascosta attorno a (x, y) e la assegna a
+ * *action.
+ */
+static void simplebot_hidden(const struct msw_bot_view_struct *view, int x, int y,
+                             struct msw_bot_action_struct *action) {
+    int x0, y0;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++)
+        for (x0 = x - 1; x0 <= x + 1; x0++)
+            if (x0 >= 0 && y0 >= 0 && x0 < view->width && y0 < view->height &&
+                view->cells[(long) y0 * view->width + x0] == BOT_HIDDEN) {
+                action->x = x0;
+                action->y = y0;
+                return;
+            }
+}
+
+const char *msw_bot_name(void) {
+    return "simplebot";
+}
+
+void *msw_bot_start(const struct msw_bot_view_struct *view) {
+    struct simplebot_struct *bot = (struct simplebot_struct*) malloc(sizeof(struct simplebot_struct));
+
+    if (bot)
+        bot->rng = (unsigned long) view->width * 31 + view->height;
+
+    return bot;
+}
+
+int msw_bot_move(void *state, const struct msw_bot_view_struct *view, struct msw_bot_action_struct *action) {
+    struct simplebot_struct *bot = (struct simplebot_struct*) state;
+    long cells = (long) view->width * view->height, hidden_cnt = 0, pick, i;
+    int x, y, hidden, flags;
+
+    if (!bot)
+        return 0;
+
+    for (y = 0; y < view->height; y++)
+        for (x = 0; x < view->width; x++) {
+            int value = view->cells[(long) y * view->width + x];
+
+            if (value == BOT_HIDDEN)
+                hidden_cnt++;
+            else if (value > 0 && value <= 8) {
+                simplebot_around(view, x, y, &hidden, &flags);
+
+                if (hidden > 0 && flags == value) {
+                    action->type = BOT_CHORD;
+                    action->x = x;
+                    action->y = y;
+                    return 1;
+                }
+
+                if (hidden > 0 && hidden + flags == value) {
+                    action->type = BOT_MARK;
+                    simplebot_hidden(view, x, y, action);
+                    return 1;
+                }
+            }
+        }
+
+    if (hidden_cnt == 0)
+        return 0;
+
+    /* Nessuna regola si applica: tentativo su una cella nascosta a caso. */
+    bot->rng = bot->rng * 6364136223846793005UL + 1442695040888963407UL;
+    pick = (long) ((bot->rng >> 33) % (unsigned long) hidden_cnt);
+
+    for (i = 0; i < cells; i++)
+        if (view->cells[i] == BOT_HIDDEN && pick-- == 0) {
+            action->type = BOT_REVEAL;
+            action->x = (int) (i % view->width);
+            action->y = (int) (i / view->width);
+            break;
+        }
+
+    return 1;
+}
+
+void msw_bot_end(void *state) {
+    free(state);
+}
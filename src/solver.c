@@ -0,0 +1,640 @@
+#include <stdlib.h> /* malloc, calloc, realloc, free */
+#include <string.h> /* memset, memcpy */
+#include "minesweeper.h"
+#include "solver.h"
+
+/* msw_solver_trim restringe l'intervallo delle parole non nulle
+ * dell'equazione.
+ */
+static void msw_solver_trim(struct msw_equation_struct *row) {
+    while (row->lo <= row->hi && !(row->pos[row->lo] | row->neg[row->lo]))
+        row->lo++;
+    while (row->hi >= row->lo && !(row->pos[row->hi] | row->neg[row->hi]))
+        row->hi--;
+}
+
+/* msw_solver_push inserisce l'equazione tra quelle da rivalutare, se non vi
+ * si trova già.
+ */
+static void msw_solver_push(msw_solver solver, int index) {
+    if (!solver->rows[index].dirty) {
+        solver->rows[index].dirty = 1;
+        solver->stack[solver->stack_cnt++] = index;
+    }
+}
+
+/* msw_solver_clear svuota il sistema e dimentica tutte le deduzioni. */
+static void msw_solver_clear(msw_solver solver) {
+    long cells = (long) solver->width * solver->height, i;
+
+    for (i = 0; i < solver->row_cnt; i++)
+        free(solver->rows[i].pos);
+
+    memset(solver->known, SOLVER_UNKNOWN, cells);
+    memset(solver->added, 0, cells);
+    for (i = 0; i < cells; i++)
+        solver->column[i] = -1;
+
+    solver->instance = 1;
+    solver->undo_cnt = 0;
+    solver->col_cnt = 0;
+    solver->row_cnt = 0;
+    solver->stack_cnt = 0;
+    solver->global = 0;
+    solver->known_mines = 0;
+    solver->unknown_cnt = cells;
+    solver->interior_cnt = cells;
+    solver->synced = 0;
+}
+
+/* msw_solver_create crea un nuovo risolutore per i campi delle dimensioni di
+ * field, assegna il puntatore a *solverptr (se *solverptr è un puntatore non
+ * nullo, viene prima distrutto il risolutore riferito da esso) e restituisce
+ * vero se la creazione è avvenuta con successo. Il sistema è vuoto fino alla
+ * prima chiamata di msw_solver_update.
+ */
+int msw_solver_create(msw_solver *solverptr, msw_field field) {
+    msw_solver solver = (msw_solver) calloc(1, sizeof(struct msw_solver_struct));
+
+    if (solver) {
+        size_t cells = (size_t) field->width * field->height;
+
+        solver->width = field->width;
+        solver->height = field->height;
+        solver->words = 1;
+        solver->col_cap = 64;
+        solver->row_cap = 16;
+
+        solver->known = (unsigned char*) malloc(cells);
+        solver->added = (unsigned char*) malloc(cells);
+        solver->column = (int*) malloc(cells * sizeof(int));
+        solver->column_cell = (long*) malloc(solver->col_cap * sizeof(long));
+        solver->pivot_row = (int*) malloc(solver->col_cap * sizeof(int));
+        solver->scratch = (int*) malloc(solver->col_cap * sizeof(int));
+        solver->rows = (struct msw_equation_struct*) malloc(solver->row_cap * sizeof(struct msw_equation_struct));
+        solver->stack = (int*) malloc(solver->row_cap * sizeof(int));
+
+        if (solver->known && solver->added && solver->column && solver->column_cell &&
+            solver->pivot_row && solver->scratch && solver->rows && solver->stack) {
+            msw_solver_clear(solver);
+
+            msw_solver_destroy(solverptr);
+            *solverptr = solver;
+
+            return 1;
+        }
+
+        msw_solver_destroy(&solver);
+    }
+
+    return 0;
+}
+
+/* msw_solver_destroy distrugge un risolutore precedentemente creato. */
+void msw_solver_destroy(msw_solver *solverptr) {
+    if (*solverptr) {
+        msw_solver solver = *solverptr;
+        int i;
+
+        for (i = 0; i < solver->row_cnt; i++)
+            free(solver->rows[i].pos);
+
+        free(solver->known);
+        free(solver->added);
+        free(solver->column);
+        free(solver->column_cell);
+        free(solver->pivot_row);
+        free(solver->scratch);
+        free(solver->rows);
+        free(solver->stack);
+        free(solver);
+
+        *solverptr = NULL;
+    }
+}
+
+/* msw_solver_grow raddoppia il numero di variabili rappresentabili,
+ * ricopiando gli insiemi di bit di tutte le equazioni, e restituisce vero se
+ * l'operazione è avvenuta con successo.
+ */
+static int msw_solver_grow(msw_solver solver) {
+    int words = solver->words * 2, cap = words * 64, i;
+    long *column_cell = (long*) realloc(solver->column_cell, cap * sizeof(long));
+    int *pivot_row, *scratch;
+
+    if (!column_cell)
+        return 0;
+    solver->column_cell = column_cell;
+
+    pivot_row = (int*) realloc(solver->pivot_row, cap * sizeof(int));
+    if (!pivot_row)
+        return 0;
+    solver->pivot_row = pivot_row;
+
+    scratch = (int*) realloc(solver->scratch, cap * sizeof(int));
+    if (!scratch)
+        return 0;
+    solver->scratch = scratch;
+
+    for (i = 0; i < solver->row_cnt; i++) {
+        struct msw_equation_struct *row = solver->rows + i;
+        uint64_t *bits = (uint64_t*) calloc(2 * words, sizeof(uint64_t));
+
+        if (!bits)
+            return 0;
+
+        memcpy(bits, row->pos, solver->words * sizeof(uint64_t));
+        memcpy(bits + words, row->neg, solver->words * sizeof(uint64_t));
+        free(row->pos);
+        row->pos = bits;
+        row->neg = bits + words;
+    }
+
+    solver->words = words;
+    solver->col_cap = cap;
+
+    return 1;
+}
+
+/* msw_solver_column restituisce la variabile associata alla cella,
+ * creandola se necessario, oppure -1 in caso di errore.
+ */
+static int msw_solver_column(msw_solver solver, long cell) {
+    if (solver->column[cell] < 0) {
+        if (solver->col_cnt == solver->col_cap && !msw_solver_grow(solver))
+            return -1;
+
+        solver->column[cell] = solver->col_cnt;
+        solver->column_cell[solver->col_cnt] = cell;
+        solver->interior_cnt--;
+        solver->pivot_row[solver->col_cnt] = -1;
+        solver->col_cnt++;
+    }
+
+    return solver->column[cell];
+}
+
+/* msw_solver_new_row aggiunge un'equazione vuota al sistema e ne restituisce
+ * l'indice, oppure -1 in caso di errore.
+ */
+static int msw_solver_new_row(msw_solver solver) {
+    struct msw_equation_struct *row;
+
+    if (solver->row_cnt == solver->row_cap) {
+        int cap = solver->row_cap * 2;
+        struct msw_equation_struct *rows = (struct msw_equation_struct*) realloc(solver->rows, cap * sizeof(struct msw_equation_struct));
+        int *stack;
+
+        if (!rows)
+            return -1;
+        solver->rows = rows;
+
+        stack = (int*) realloc(solver->stack, cap * sizeof(int));
+        if (!stack)
+            return -1;
+        solver->stack = stack;
+
+        solver->row_cap = cap;
+    }
+
+    row = solver->rows + solver->row_cnt;
+    row->pos = (uint64_t*) calloc(2 * solver->words, sizeof(uint64_t));
+    if (!row->pos)
+        return -1;
+
+    row->neg = row->pos + solver->words;
+    row->value = 0;
+    row->pivot = -1;
+    row->lo = solver->words;
+    row->hi = -1;
+    row->dirty = 0;
+
+    return solver->row_cnt++;
+}
+
+/* msw_solver_set_bit aggiunge la variabile col all'equazione con
+ * coefficiente 1.
+ */
+static void msw_solver_set_bit(struct msw_equation_struct *row, int col) {
+    int w = col >> 6;
+
+    row->pos[w] |= (uint64_t) 1 << (col & 63);
+    if (w < row->lo)
+        row->lo = w;
+    if (w > row->hi)
+        row->hi = w;
+}
+
+/* msw_solver_has_bit verifica se la variabile col compare nell'equazione;
+ * l'intervallo delle parole viene controllato per primo, così da non leggere
+ * gli insiemi di bit delle equazioni lontane.
+ */
+static int msw_solver_has_bit(struct msw_equation_struct *row, int col) {
+    int w = col >> 6;
+
+    return w >= row->lo && w <= row->hi && (((row->pos[w] | row->neg[w]) >> (col & 63)) & 1);
+}
+
+/* msw_solver_eliminate elimina la variabile col, pivot di pivot (con
+ * coefficiente 1), dall'equazione row sottraendo o sommando pivot, e
+ * restituisce vero se l'eliminazione è avvenuta. L'eliminazione viene
+ * rifiutata se porterebbe un coefficiente fuori da [-1, 1].
+ */
+static int msw_solver_eliminate(struct msw_equation_struct *row, struct msw_equation_struct *pivot, int col) {
+    uint64_t *sub_pos, *sub_neg;
+    int w, sign;
+
+    if ((row->pos[col >> 6] >> (col & 63)) & 1) {
+        sub_pos = pivot->pos;
+        sub_neg = pivot->neg;
+        sign = 1;
+    } else {
+        sub_pos = pivot->neg;
+        sub_neg = pivot->pos;
+        sign = -1;
+    }
+
+    /* Un coefficiente 1 meno -1 (o -1 meno 1) non è rappresentabile. */
+    for (w = pivot->lo; w <= pivot->hi; w++) {
+        if ((row->pos[w] & sub_neg[w]) | (row->neg[w] & sub_pos[w]))
+            return 0;
+    }
+
+    for (w = pivot->lo; w <= pivot->hi; w++) {
+        uint64_t pos = (row->pos[w] & ~sub_pos[w]) | (sub_neg[w] & ~row->neg[w]);
+        uint64_t neg = (row->neg[w] & ~sub_neg[w]) | (sub_pos[w] & ~row->pos[w]);
+
+        row->pos[w] = pos;
+        row->neg[w] = neg;
+    }
+
+    row->value -= sign * pivot->value;
+    if (pivot->lo < row->lo)
+        row->lo = pivot->lo;
+    if (pivot->hi > row->hi)
+        row->hi = pivot->hi;
+    msw_solver_trim(row);
+
+    return 1;
+}
+
+/* msw_solver_unpivot toglie all'equazione la sua variabile pivot, se questa
+ * non vi compare più.
+ */
+static void msw_solver_unpivot(msw_solver solver, int index) {
+    struct msw_equation_struct *row = solver->rows + index;
+
+    if (row->pivot >= 0 && !msw_solver_has_bit(row, row->pivot)) {
+        solver->pivot_row[row->pivot] = -1;
+        row->pivot = -1;
+    }
+}
+
+/* msw_solver_pivot riduce l'equazione rispetto alle variabili pivot delle
+ * altre equazioni, ne sceglie la variabile pivot tra le rimanenti e la
+ * elimina da tutte le altre equazioni (forma ridotta a scala). Le equazioni
+ * modificate vengono inserite tra quelle da rivalutare.
+ */
+static void msw_solver_pivot(msw_solver solver, int index) {
+    struct msw_equation_struct *row = solver->rows + index;
+    int pass, changed = 1, w, col = -1, i;
+
+    /* Riduzione: poiché le eliminazioni rifiutate lasciano la forma a scala
+     * incompleta, un'eliminazione può introdurre altre variabili pivot, quindi
+     * vengono effettuate più passate.
+     */
+    for (pass = 0; changed && pass < 4; pass++) {
+        changed = 0;
+
+        for (w = row->lo; w <= row->hi; w++) {
+            uint64_t bits = row->pos[w] | row->neg[w];
+
+            while (bits) {
+                int c = w * 64 + __builtin_ctzll(bits), p;
+
+                bits &= bits - 1;
+                p = solver->pivot_row[c];
+
+                if (p >= 0 && p != index && msw_solver_has_bit(row, c) &&
+                    msw_solver_eliminate(row, solver->rows + p, c))
+                    changed = 1;
+            }
+        }
+    }
+
+    /* Scelta della prima variabile che non è pivot di altre equazioni. */
+    for (w = row->lo; w <= row->hi && col < 0; w++) {
+        uint64_t bits = row->pos[w] | row->neg[w];
+
+        while (bits && col < 0) {
+            int c = w * 64 + __builtin_ctzll(bits);
+
+            bits &= bits - 1;
+            if (solver->pivot_row[c] < 0)
+                col = c;
+        }
+    }
+
+    if (col >= 0) {
+        /* La variabile pivot deve avere coefficiente 1. */
+        if ((row->neg[col >> 6] >> (col & 63)) & 1) {
+            for (w = row->lo; w <= row->hi; w++) {
+                uint64_t t = row->pos[w];
+
+                row->pos[w] = row->neg[w];
+                row->neg[w] = t;
+            }
+            row->value = -row->value;
+        }
+
+        row->pivot = col;
+        solver->pivot_row[col] = index;
+
+        for (i = 0; i < solver->row_cnt; i++) {
+            if (i != index && msw_solver_has_bit(solver->rows + i, col) &&
+                msw_solver_eliminate(solver->rows + i, row, col)) {
+                msw_solver_unpivot(solver, i);
+                msw_solver_push(solver, i);
+            }
+        }
+    }
+}
+
+/* msw_solver_assign registra il risultato della deduzione sulla cella e, se
+ * la cella è una variabile del sistema, ne sostituisce il valore in tutte le
+ * equazioni.
+ */
+static void msw_solver_assign(msw_solver solver, long cell, int result) {
+    if (solver->known[cell] == SOLVER_UNKNOWN) {
+        int col = solver->column[cell];
+
+        solver->known[cell] = result;
+        if (result == SOLVER_MINE)
+            solver->known_mines++;
+
+        solver->unknown_cnt--;
+        if (col < 0)
+            solver->interior_cnt--;
+
+        if (col >= 0) {
+            int w = col >> 6, i, value = (result == SOLVER_MINE);
+            uint64_t bit = (uint64_t) 1 << (col & 63);
+
+            for (i = 0; i < solver->row_cnt; i++) {
+                struct msw_equation_struct *row = solver->rows + i;
+
+                if (w >= row->lo && w <= row->hi && ((row->pos[w] | row->neg[w]) & bit)) {
+                    row->value += ((row->pos[w] & bit) ? -value : value);
+                    row->pos[w] &= ~bit;
+                    row->neg[w] &= ~bit;
+                    msw_solver_trim(row);
+                    msw_solver_unpivot(solver, i);
+                    msw_solver_push(solver, i);
+                }
+            }
+
+            solver->pivot_row[col] = -1;
+        }
+    }
+}
+
+/* msw_solver_deduce verifica se il termine noto dell'equazione coincide con
+ * il massimo (tutte le variabili positive sono mine e le negative no) o con
+ * il minimo (il contrario) della sua parte sinistra e, in tal caso, assegna
+ * le variabili.
+ */
+static void msw_solver_deduce(msw_solver solver, int index) {
+    struct msw_equation_struct *row = solver->rows + index;
+    int w, n = 0, pos_cnt = 0, neg_cnt = 0, mine_pos, i;
+
+    for (w = row->lo; w <= row->hi; w++) {
+        pos_cnt += __builtin_popcountll(row->pos[w]);
+        neg_cnt += __builtin_popcountll(row->neg[w]);
+    }
+
+    if (pos_cnt + neg_cnt == 0 || (row->value != pos_cnt && row->value != -neg_cnt))
+        return;
+
+    mine_pos = (row->value == pos_cnt);
+
+    /* Le variabili vengono prima copiate, poiché l'assegnazione modifica
+     * l'equazione stessa.
+     */
+    for (w = row->lo; w <= row->hi; w++) {
+        uint64_t bits = row->pos[w] | row->neg[w];
+
+        while (bits) {
+            int col = w * 64 + __builtin_ctzll(bits);
+            int positive = (row->pos[w] >> (col & 63)) & 1;
+
+            bits &= bits - 1;
+            solver->scratch[n++] = (positive == mine_pos ? col : -col - 1);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (solver->scratch[i] >= 0)
+            msw_solver_assign(solver, solver->column_cell[solver->scratch[i]], SOLVER_MINE);
+        else
+            msw_solver_assign(solver, solver->column_cell[-solver->scratch[i] - 1], SOLVER_SAFE);
+    }
+}
+
+/* msw_solver_process rivaluta le equazioni modificate finché il sistema non
+ * si stabilizza.
+ */
+static void msw_solver_process(msw_solver solver) {
+    while (solver->stack_cnt > 0) {
+        int index = solver->stack[--solver->stack_cnt];
+        struct msw_equation_struct *row = solver->rows + index;
+
+        row->dirty = 0;
+
+        if (row->pivot < 0 && row->lo <= row->hi)
+            msw_solver_pivot(solver, index);
+
+        msw_solver_deduce(solver, index);
+    }
+}
+
+/* msw_solver_add_cell aggiunge al sistema l'equazione del numero visitato
+ * alla posizione (x, y): le celle adiacenti non visitate già dedotte vengono
+ * sostituite subito. Restituisce vero se l'operazione è avvenuta con
+ * successo.
+ */
+static int msw_solver_add_cell(msw_solver solver, msw_field field, int x, int y) {
+    int index = msw_solver_new_row(solver), x0, y0;
+    struct msw_equation_struct *row;
+
+    if (index < 0)
+        return 0;
+
+    row = solver->rows + index;
+    row->value = msw_get_cell(field, x, y)->content;
+
+    for (y0 = y - 1; y0 <= y + 1; y0++)
+        for (x0 = x - 1; x0 <= x + 1; x0++) {
+            if (msw_cell_exists(field, x0, y0) && msw_get_cell(field, x0, y0)->visited <= VISITED_NO) {
+                long cell = (long) y0 * field->width + x0;
+                int col;
+
+                if (solver->known[cell] == SOLVER_MINE)
+                    row->value--;
+                else if (solver->known[cell] == SOLVER_UNKNOWN) {
+                    col = msw_solver_column(solver, cell);
+                    if (col < 0)
+                        return 0;
+
+                    /* msw_solver_column può aver ricopiato gli insiemi di bit. */
+                    row = solver->rows + index;
+                    msw_solver_set_bit(row, col);
+                }
+            }
+        }
+
+    msw_solver_push(solver, index);
+
+    return 1;
+}
+
+/* msw_solver_global applica il vincolo sul numero totale di mine del campo:
+ * se le mine rimanenti sono zero oppure pari alle celle non dedotte, tutte
+ * queste vengono assegnate; se tutte le celle non dedotte sono variabili
+ * (nessuna cella interna lontana dai numeri), il vincolo viene aggiunto al
+ * sistema come equazione. Restituisce vero se l'operazione è avvenuta con
+ * successo. Le celle non dedotte e quelle interne sono contate dai
+ * contatori del risolutore, così che il campo venga scorso solo per
+ * l'assegnazione finale.
+ */
+static int msw_solver_global(msw_solver solver, msw_field field) {
+    long cells = (long) field->width * field->height, unknown = solver->unknown_cnt, left, i;
+    long interior = solver->interior_cnt;
+    int col;
+
+    left = msw_mine_total(field) - solver->known_mines;
+
+    if (unknown > 0 && (left == 0 || left == unknown)) {
+        for (i = 0; i < cells; i++) {
+            if (solver->known[i] == SOLVER_UNKNOWN && msw_get_cell(field, (int) (i % field->width), (int) (i / field->width))->visited <= VISITED_NO)
+                msw_solver_assign(solver, i, (left == 0 ? SOLVER_SAFE : SOLVER_MINE));
+        }
+    } else if (unknown > 0 && interior == 0 && !solver->global) {
+        int index = msw_solver_new_row(solver);
+
+        if (index < 0)
+            return 0;
+
+        solver->rows[index].value = (int) left;
+        for (col = 0; col < solver->col_cnt; col++) {
+            if (solver->known[solver->column_cell[col]] == SOLVER_UNKNOWN)
+                msw_solver_set_bit(solver->rows + index, col);
+        }
+
+        msw_solver_push(solver, index);
+        solver->global = 1;
+    }
+
+    return 1;
+}
+
+/* msw_solver_compact rimuove dal sistema le equazioni rimaste vuote. */
+static void msw_solver_compact(msw_solver solver) {
+    int i, n = 0;
+
+    for (i = 0; i < solver->row_cnt; i++) {
+        struct msw_equation_struct *row = solver->rows + i;
+
+        if (row->lo > row->hi) {
+            if (row->pivot >= 0)
+                solver->pivot_row[row->pivot] = -1;
+            free(row->pos);
+        } else {
+            if (row->pivot >= 0)
+                solver->pivot_row[row->pivot] = n;
+            solver->rows[n++] = *row;
+        }
+    }
+
+    solver->row_cnt = n;
+}
+
+/* msw_solver_visit aggiunge al sistema la cella (x, y), se è visitata e non
+ * ancora aggiunta, e restituisce vero se l'operazione è avvenuta con
+ * successo.
+ */
+static int msw_solver_visit(msw_solver solver, msw_field field, int x, int y) {
+    msw_cell cell = msw_get_cell(field, x, y);
+    long index = (long) y * field->width + x;
+
+    if (cell->visited > VISITED_NO && !solver->added[index]) {
+        solver->added[index] = 1;
+
+        if (cell->content == CONTENT_MINE)
+            msw_solver_assign(solver, index, SOLVER_MINE);
+        else {
+            msw_solver_assign(solver, index, SOLVER_SAFE);
+            return msw_solver_add_cell(solver, field, x, y);
+        }
+    }
+
+    return 1;
+}
+
+/* msw_solver_update aggiorna il sistema con i numeri visitati nel campo
+ * dall'ultimo aggiornamento e ne ricava tutte le deduzioni possibili;
+ * restituisce vero se l'operazione è avvenuta con successo. Il campo deve
+ * avere le dimensioni del campo usato per creare il risolutore. buffer
+ * contiene le modifiche dello stato visibile del campo dall'ultimo
+ * aggiornamento (MSW_DELTA, come registrate da msw_apply), di cui vengono
+ * esaminate solamente le celle; se buffer è NULL o incompleto, oppure se il
+ * sistema è appena stato creato o ricostruito, viene scorso l'intero campo.
+ * Se il campo è tornato indietro (annullamenti), il sistema viene
+ * ricostruito da capo. Il risolutore legge solamente lo stato visibile del
+ * campo.
+ */
+int msw_solver_update(msw_solver solver, msw_field field, const struct msw_delta_buffer_struct *buffer) {
+    int x, y, success = 1;
+    long i;
+
+    if (field->width != solver->width || field->height != solver->height)
+        return 0;
+
+    if (field->undo_cnt != solver->undo_cnt || field->instance < solver->instance)
+        msw_solver_clear(solver);
+
+    solver->undo_cnt = field->undo_cnt;
+    solver->instance = field->instance;
+
+    /* Per ogni cella visitata non ancora aggiunta al sistema... */
+    if (!solver->synced || !buffer || buffer->overflow) {
+        for (y = 0; success && y < field->height; y++)
+            for (x = 0; success && x < field->width; x++)
+                success = msw_solver_visit(solver, field, x, y);
+    } else
+        for (i = 0; success && i < buffer->cnt; i++) {
+            long index = MSW_DELTA_INDEX(buffer->deltas[i]);
+
+            success = msw_solver_visit(solver, field, (int) (index % field->width), (int) (index / field->width));
+        }
+
+    if (success) {
+        msw_solver_process(solver);
+        success = msw_solver_global(solver, field);
+        msw_solver_process(solver);
+        msw_solver_compact(solver);
+    }
+
+    if (success)
+        solver->synced = 1;
+    else
+        msw_solver_clear(solver);
+
+    return success;
+}
+
+/* msw_solver_get restituisce il risultato della deduzione sulla cella
+ * (x, y): SOLVER_SAFE, SOLVER_MINE oppure SOLVER_UNKNOWN.
+ */
+int msw_solver_get(msw_solver solver, int x, int y) {
+    return solver->known[(long) y * solver->width + x];
+}
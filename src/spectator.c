@@ -0,0 +1,69 @@
+#include <stdlib.h> /* NULL */
+#include "minesweeper.h"
+#include "ui.h"
+#include "feed.h"
+
+/* Lo spettatore mostra la partita in corso nel processo di gioco della stessa
+ * macchina: si collega al canale MSW_FEED_NAME, ricostruisce il campo dal
+ * fotogramma chiave e segue le modifiche di ogni mossa, con il cursore
+ * sull'ultima cella modificata. Se viene doppiato, riparte dal fotogramma
+ * chiave.
+ */
+
+/* Il canale della partita seguita. */
+static msw_feed feed = NULL;
+
+/* watch è la funzione di aggiornamento della modalità di visione: applica
+ * alla vista le modifiche pubblicate dall'ultimo aggiornamento e sposta il
+ * cursore sull'ultima cella modificata.
+ */
+static int watch(msw_field view, int *x, int *y) {
+    long last = -1, result = msw_feed_follow(feed, view, &last);
+
+    if (result == FEED_CLOSED)
+        return -1;
+
+    /* La vista ha le dimensioni del canale e non viene ricreata. */
+    if (result == FEED_LAPPED)
+        return msw_feed_sync(feed, &view);
+
+    if (result > 0 && last >= 0) {
+        *x = (int) (last % view->width);
+        *y = (int) (last / view->width);
+    }
+
+    return (result > 0);
+}
+
+int main() {
+    char *options[] = { "Guarda la prossima partita", "Esci" };
+    msw_field view = NULL;
+    int quit = 0;
+
+    ui_start();
+
+    ui_title();
+
+    ui_set_watch(watch);
+
+    do {
+        int x = 0, y = 0;
+
+        /* Collegamento al canale, ricostruzione del campo e visione fino
+         * alla fine della partita.
+         */
+        if (!msw_feed_attach(&feed, MSW_FEED_NAME) || !msw_feed_sync(feed, &view)) {
+            ui_message("Nessuna partita in corso.");
+            quit = 1;
+        } else if (ui_minesweeper(view, &x, &y, UI_WATCH) == ACTION_QUIT ||
+                   ui_select("La partita è terminata.", options, 2) != options[0])
+            quit = 1;
+    } while (!quit);
+
+    ui_end();
+
+    msw_feed_destroy(&feed);
+    msw_destroy(&view);
+
+    return 0;
+}
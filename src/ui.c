@@ -1,8 +1,47 @@
 #include <stdio.h> /* sprintf */
+#include <limits.h> /* LONG_MAX */
+#include <time.h> /* clock_gettime */
+#include <poll.h> /* poll */
+#include <unistd.h> /* STDIN_FILENO */
 #include <ncurses.h> /* Grafica */
 #include "minesweeper.h"
 #include "ui.h"
 
+/* Tempo di gioco accumulato da ui_minesweeper, in millisecondi. */
+static long ui_play_ms = 0;
+
+/* Nella modalità di revisione, la mossa mostrata e il numero di mosse
+ * (impostati da ui_replay_position) e lo spostamento richiesto con
+ * l'ultima ACTION_SEEK.
+ */
+static long ui_replay_step = 0, ui_replay_steps = 0, ui_seek = 0;
+
+/* Nella modalità di visione, la funzione di aggiornamento del campo (impostata
+ * da ui_set_watch).
+ */
+static int (*ui_watch_update)(msw_field, int*, int*) = NULL;
+
+/* Nella modalità di gioco, la funzione chiamata ad ogni risveglio (impostata
+ * da ui_set_idle).
+ */
+static void (*ui_idle)(void) = NULL;
+
+/* Nella modalità di apertura, la funzione che prosegue l'apertura (impostata
+ * da ui_set_reveal).
+ */
+static long (*ui_reveal_update)(msw_field) = NULL;
+
+/* ui_now restituisce il tempo corrente in millisecondi, da un orologio
+ * monotono.
+ */
+static long ui_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
 /* ui_start inizializza ncurses e l'interfaccia utente. */
 void ui_start() {
     initscr();
@@ -207,18 +246,72 @@ void ui_message(char *message) {
     ui_select(message, options, 1);
 }
 
-/* ui_title visualizza la finestra del titolo. */
-void ui_title() {
-    WINDOW *head = ui_window(WND_HEAD);
-
+/* ui_title_draw scrive il titolo nella finestra dell'intestazione. */
+static void ui_title_draw(WINDOW *head) {
     wattron(head, A_BOLD);
     wprintw(head, "MINESWEEPER\n");
     wattroff(head, A_BOLD);
     wprintw(head, "Campo minato di Samuele Casarin");
+}
+
+/* ui_title visualizza la finestra del titolo. */
+void ui_title() {
+    WINDOW *head = ui_window(WND_HEAD);
+
+    /* Con meno di 16 righe di altezza l'intestazione non è visibile. */
+    if (head) {
+        ui_title_draw(head);
 
-    wrefresh(head);
+        wrefresh(head);
 
-    delwin(head);
+        delwin(head);
+    }
+}
+
+/* ui_clock_reset azzera l'orologio di gioco visualizzato da ui_minesweeper. */
+void ui_clock_reset() {
+    ui_play_ms = 0;
+}
+
+/* ui_replay_position imposta la mossa mostrata e il numero di mosse, per
+ * l'intestazione della modalità di revisione di ui_minesweeper.
+ */
+void ui_replay_position(long step, long steps) {
+    ui_replay_step = step;
+    ui_replay_steps = steps;
+}
+
+/* ui_set_watch imposta la funzione di aggiornamento della modalità di
+ * visione di ui_minesweeper: update riceve il campo e il cursore, che può
+ * spostare, e restituisce un valore positivo se il campo è cambiato, 0 se non
+ * è cambiato oppure un valore negativo se la partita è terminata.
+ */
+void ui_set_watch(int (*update)(msw_field, int*, int*)) {
+    ui_watch_update = update;
+}
+
+/* ui_set_idle imposta la funzione chiamata da ui_minesweeper, nella modalità
+ * di gioco, ad ogni risveglio dell'attesa dell'input (almeno una volta al
+ * secondo, con l'orologio); NULL per non chiamare alcuna funzione.
+ */
+void ui_set_idle(void (*idle)(void)) {
+    ui_idle = idle;
+}
+
+/* ui_set_reveal imposta la funzione della modalità di apertura di
+ * ui_minesweeper: update riceve il campo, prosegue l'apertura per un tempo
+ * limitato e restituisce il numero di celle aperte finora, oppure un valore
+ * negativo se l'apertura è completa.
+ */
+void ui_set_reveal(long (*update)(msw_field)) {
+    ui_reveal_update = update;
+}
+
+/* ui_seek_steps restituisce lo spostamento, in mosse (negativo all'indietro),
+ * richiesto con l'ultima ACTION_SEEK restituita da ui_minesweeper.
+ */
+long ui_seek_steps() {
+    return ui_seek;
 }
 
 /* ui_info visualizza la finestra delle informazioni. */
@@ -246,46 +339,64 @@ void ui_info(int info_mask) {
     if (info_mask & INFO_W)
         wprintw(foot, "W: Marca | ");
 
+    if (info_mask & INFO_E)
+        wprintw(foot, "E: Apri attorno | ");
+
     if (info_mask & INFO_ENTER_PAUSE)
         wprintw(foot, "INVIO: Pausa | ");
 
+    if (info_mask & INFO_H)
+        wprintw(foot, "H: Aiuto | ");
+
+    if (info_mask & INFO_R)
+        wprintw(foot, "R: Rivedi | ");
+
+    if (info_mask & INFO_REPLAY)
+        wprintw(foot, ",/.: Mossa | Pag.: %d mosse | R: Torna | ", UI_SEEK_PAGE);
+
+    if (info_mask & INFO_WATCH)
+        wprintw(foot, "Q: Esci | ");
+
     wrefresh(foot);
 
     delwin(foot);
 }
 
 /* ui_main_menu visualizza la finestra del menu principale e restituisce una
- * costante che rappresenta l'opzione del menu selezionata.
+ * costante che rappresenta l'opzione del menu selezionata. L'opzione di
+ * salvataggio è disponibile solamente se save è vero, quella di ripresa della
+ * partita solamente se resume è vero.
  */
-int ui_main_menu(int save) {
+int ui_main_menu(int save, int resume) {
     char *caption = "Cosa vuoi fare?";
-    char *options[] = {
-        "Nuovo",
-        "Carica",
-        "Salva",
-        "Esci"
-    };
+    char *options[5];
+    int actions[5], n = 0, i;
     char *option;
 
-    if (save)
-        option = ui_select(caption, options, 4);
-    else {
-        /* L'opzione di salvataggio non deve essere resa disponibile, dunque basta
-         * copiare il puntatore alla stringa "Esci" al posto del puntatore alla stringa
-         * "Salva" e considerare solamente i primi tre elementi dell'array.
-         */
-        options[2] = options[3];
-        option = ui_select(caption, options, 3);
+    /* Le opzioni di ripresa e di salvataggio vengono rese disponibili
+     * solamente se richiesto.
+     */
+    options[n] = "Nuovo";
+    actions[n++] = ACTION_NEW;
+    if (resume) {
+        options[n] = "Riprendi";
+        actions[n++] = ACTION_RESUME;
     }
+    options[n] = "Carica";
+    actions[n++] = ACTION_LOAD;
+    if (save) {
+        options[n] = "Salva";
+        actions[n++] = ACTION_SAVE;
+    }
+    options[n] = "Esci";
+    actions[n++] = ACTION_QUIT;
 
-    if (option == options[0])
-        return ACTION_NEW;
-    else if (option == options[1])
-        return ACTION_LOAD;
-    else if (option == options[2] && save)
-        return ACTION_SAVE;
-    else
-        return ACTION_QUIT;
+    option = ui_select(caption, options, n);
+
+    for (i = 0; i < n - 1 && option != options[i]; i++)
+        ;
+
+    return actions[i];
 }
 
 /* ui_main_menu visualizza la finestra del menu di gioco del tipo dato e
@@ -325,116 +436,263 @@ int ui_game_menu(int gmenu_type, int lives) {
  * dello spostamento del cursore delle celle e restituisce una costante che
  * rappresenta l'azione scelta da input (modifica dello stato del campo oppure
  * pausa).
- * Se draw_only è vero, ui_minesweeper non attende l'input dell'azione, si
- * limita a disegnare il campo e restituisce -1.
+ * L'input viene letto senza bloccare: ad ogni risveglio vengono consumati
+ * tutti i tasti in attesa, gli spostamenti consecutivi vengono sommati in un
+ * unico aggiornamento del cursore e il campo viene ridisegnato al più una volta
+ * ogni UI_FRAME_MS millisecondi. Nell'attesa, l'intestazione mostra l'orologio
+ * di gioco; un ridimensionamento dello schermo ricostruisce le sole finestre.
+ * La modalità mode può essere UI_PLAY (gioco), UI_DRAW (ui_minesweeper non
+ * attende l'input dell'azione, si limita a disegnare il campo e restituisce
+ * -1) oppure UI_REPLAY (revisione della partita: l'intestazione mostra la
+ * mossa impostata con ui_replay_position al posto dell'orologio, che resta
+ * fermo; i tasti di spostamento tra le mosse vengono sommati come quelli del
+ * cursore e restituiti con ACTION_SEEK, e ACTION_REPLAY indica l'uscita)
+ * oppure UI_WATCH (visione di una partita altrui: ad ogni intervallo di
+ * UI_FRAME_MS millisecondi viene chiamata la funzione impostata con
+ * ui_set_watch, che aggiorna il campo e il cursore; ui_minesweeper
+ * restituisce ACTION_QUIT se viene premuto Q, oppure -1 quando la funzione
+ * segnala la fine della partita) oppure UI_REVEAL (apertura di molte celle:
+ * tra un disegno e l'altro viene chiamata la funzione impostata con
+ * ui_set_reveal e l'intestazione mostra il numero di celle aperte; il
+ * cursore si sposta come nel gioco, INVIO sospende e riprende l'apertura,
+ * l'orologio di gioco avanza solo mentre l'apertura non è sospesa, e
+ * ui_minesweeper restituisce -1 quando l'apertura è completa).
  */
-int ui_minesweeper(msw_field field, int *x, int *y, int draw_only) {
-    int action = 0, w_width, w_height, vb_x = 0, vb_y = 0, vp_x = 0, vp_y = 0, vp_width, vp_height, x0, y0;
-    WINDOW *body = ui_window_size(WND_BODY, &w_width, &w_height);
+int ui_minesweeper(msw_field field, int *x, int *y, int mode) {
+    int action = 0, dirty = 1, paused = 0, w_width = 0, w_height = 0, h_width = 0;
+    int vb_x = 0, vb_y = 0, vp_x = 0, vp_y = 0, vp_width = 0, vp_height = 0, x0, y0;
+    long now = ui_now(), last_frame = now - UI_FRAME_MS, shown = -1, progress = 0;
+    WINDOW *head = NULL, *body = NULL;
 
-    /* Abilitazione dell'ascolto della pressione di tasti speciali (es. tasti
-     * direzionali).
-     */
-    keypad(body, 1);
+    do {
+        /* Costruzione delle finestre, all'inizio e dopo ogni ridimensionamento
+         * dello schermo.
+         */
+        if (!body) {
+            head = ui_window_size(WND_HEAD, &h_width, NULL);
+            if (head)
+                ui_title_draw(head);
+
+            body = ui_window_size(WND_BODY, &w_width, &w_height);
+
+            /* Abilitazione dell'ascolto della pressione di tasti speciali (es.
+             * tasti direzionali) e della lettura senza attesa.
+             */
+            keypad(body, 1);
+            nodelay(body, 1);
+
+            ui_info(mode == UI_REPLAY ? INFO_HARROWS | INFO_VARROWS | INFO_REPLAY :
+                    mode == UI_WATCH ? INFO_WATCH :
+                    mode == UI_REVEAL ? INFO_HARROWS | INFO_VARROWS | INFO_ENTER_PAUSE :
+                    INFO_HARROWS | INFO_VARROWS | INFO_Q | INFO_W | INFO_E | INFO_ENTER_PAUSE | INFO_H | INFO_R);
+
+            /* Riempimento della finestra con simboli che rappresentano l'area della
+             * finestra non utilizzata. Ad ogni refresh della finestra, verranno
+             * riscritti solamente i caratteri all'interno della viewbox.
+             */
+            for (y0 = 0; y0 < w_height; y0++)
+                for (x0 = 0; x0 < w_width; x0++) {
+                    mvwaddch(body, y0, x0, SYMBOL_UNUSED);
+                }
 
-    ui_info(INFO_HARROWS | INFO_VARROWS | INFO_Q | INFO_W | INFO_ENTER_PAUSE);
+            /* Regolazione dell'area della finestra destinata alla visuale del campo
+             * (viewbox) e, in parte, dell'area visibile del campo (viewport).
+             */
+            vb_x = 0;
+            vb_y = 0;
 
-    /* Riempimento della finestra con simboli che rappresentano l'area della
-     * finestra non utilizzata. Ad ogni refresh della finestra, verranno
-     * riscritti solamente i caratteri all'interno della viewbox.
-     */
-    for (y0 = 0; y0 < w_height; y0++)
-        for (x0 = 0; x0 < w_width; x0++) {
-            mvwaddch(body, y0, x0, SYMBOL_UNUSED);
-        }
+            if (field->width <= w_width) {
+                vb_x = w_width / 2 - field->width / 2;
+                vp_width = field->width;
+            } else
+                vp_width = w_width;
 
-    /* Regolazione dell'area della finestra destinata alla visuale del campo
-     * (viewbox) e, in parte, dell'area visibile del campo (viewport).
-     */
-    if (field->width <= w_width) {
-        vb_x = w_width / 2 - field->width / 2;
-        vp_width = field->width;
-    } else
-        vp_width = w_width;
-
-    if (field->height <= w_height) {
-        vb_y = w_height / 2 - field->height / 2;
-        vp_height = field->height;
-    } else
-        vp_height = w_height;
+            if (field->height <= w_height) {
+                vb_y = w_height / 2 - field->height / 2;
+                vp_height = field->height;
+            } else
+                vp_height = w_height;
 
-    do {
-        int refresh = 0;
-
-        /* Regolazione dell'area visibile del campo (viewport). */
-        if (vp_width < field->width) {
-            vp_x = *x - vp_width / 2;
-            if (vp_x < 0)
-                vp_x = 0;
-            else if (vp_x + vp_width > field->width)
-                vp_x = field->width - vp_width;
+            dirty = 1;
+            shown = -1;
         }
 
-        if (vp_height < field->height) {
-            vp_y = *y - vp_height / 2;
-            if (vp_y < 0)
-                vp_y = 0;
-            else if (vp_y + vp_height > field->height)
-                vp_y = field->height - vp_height;
+        /* Disegno del campo solamente se modificato e se è trascorso
+         * l'intervallo minimo dall'ultimo disegno.
+         */
+        if (dirty && now - last_frame >= UI_FRAME_MS) {
+            /* Regolazione dell'area visibile del campo (viewport). */
+            vp_x = 0;
+            vp_y = 0;
+
+            if (vp_width < field->width) {
+                vp_x = *x - vp_width / 2;
+                if (vp_x < 0)
+                    vp_x = 0;
+                else if (vp_x + vp_width > field->width)
+                    vp_x = field->width - vp_width;
+            }
+
+            if (vp_height < field->height) {
+                vp_y = *y - vp_height / 2;
+                if (vp_y < 0)
+                    vp_y = 0;
+                else if (vp_y + vp_height > field->height)
+                    vp_y = field->height - vp_height;
+            }
+
+            /* Disegno della parte di campo all'interno dell'area visibile. */
+            for (y0 = 0; y0 < vp_height; y0++)
+                for (x0 = 0; x0 < vp_width; x0++) {
+                    msw_cell cell = msw_get_cell(field, vp_x + x0, vp_y + y0);
+                    int symbol;
+
+                    if (cell->visited == VISITED_NO)
+                        symbol = SYMBOL_VISITED_NO;
+                    else if (cell->visited == VISITED_FLAG)
+                        symbol = SYMBOL_VISITED_FLAG;
+                    else if (cell->content == CONTENT_EMPTY)
+                        symbol = SYMBOL_CONTENT_EMPTY;
+                    else if (cell->content == CONTENT_MINE)
+                        symbol = SYMBOL_CONTENT_MINE;
+                    else
+                        symbol = ((cell->content + '0') | A_CONTENT_NUMBER);
+
+                    mvwaddch(body, vb_y + y0, vb_x + x0, symbol | (vp_x + x0 == *x && vp_y + y0 == *y ? A_CELL_SELECTED : 0));
+                }
+
+            wnoutrefresh(body);
+
+            dirty = 0;
+            last_frame = now;
         }
 
-        /* Disegno della parte di campo all'interno dell'area visibile. */
-        for (y0 = 0; y0 < vp_height; y0++)
-            for (x0 = 0; x0 < vp_width; x0++) {
-                msw_cell cell = msw_get_cell(field, vp_x + x0, vp_y + y0);
-                int symbol;
-
-                if (cell->visited == VISITED_NO)
-                    symbol = SYMBOL_VISITED_NO;
-                else if (cell->visited == VISITED_FLAG)
-                    symbol = SYMBOL_VISITED_FLAG;
-                else if (cell->content == CONTENT_EMPTY)
-                    symbol = SYMBOL_CONTENT_EMPTY;
-                else if (cell->content == CONTENT_MINE)
-                    symbol = SYMBOL_CONTENT_MINE;
-                else
-                    symbol = ((cell->content + '0') | A_CONTENT_NUMBER);
-
-                mvwaddch(body, vb_y + y0, vb_x + x0, symbol | (vp_x + x0 == *x && vp_y + y0 == *y ? A_CELL_SELECTED : 0));
+        /* Aggiornamento dell'orologio di gioco ad ogni secondo, oppure
+         * visualizzazione della mossa nella modalità di revisione.
+         */
+        if (head && mode == UI_REPLAY) {
+            if (shown < 0) {
+                shown = 0;
+
+                if (h_width > 44)
+                    mvwprintw(head, 0, h_width - 22, "Mossa %7ld/%-7ld", ui_replay_step, ui_replay_steps);
+
+                wnoutrefresh(head);
             }
+        } else if (head && mode == UI_WATCH) {
+            if (shown < 0) {
+                shown = 0;
 
-        wrefresh(body);
+                if (h_width > 44)
+                    mvwprintw(head, 0, h_width - 12, "In diretta");
+
+                wnoutrefresh(head);
+            }
+        } else if (head && mode == UI_REVEAL) {
+            if (shown != (paused ? -2 : progress)) {
+                shown = (paused ? -2 : progress);
+
+                if (h_width > 44) {
+                    if (paused)
+                        mvwprintw(head, 0, h_width - 22, "%20s", "In pausa");
+                    else
+                        mvwprintw(head, 0, h_width - 22, "Aperte %13ld", progress);
+                }
+
+                wnoutrefresh(head);
+            }
+        } else if (head && ui_play_ms / 1000 != shown) {
+            shown = ui_play_ms / 1000;
+
+            if (h_width > 44)
+                mvwprintw(head, 0, h_width - 12, "Tempo %02ld:%02ld", shown / 60, shown % 60);
 
-        /* Se draw_only è vero, salto dell'input dell'azione. */
-        if (!draw_only)
-            do {
-                /* Ascolto e gestione della pressione di un tasto. */
-                int key = wgetch(body);
+            wnoutrefresh(head);
+        }
+
+        doupdate();
+
+        /* In modalità UI_DRAW, salto dell'input dell'azione. */
+        if (mode != UI_DRAW) {
+            int key, pending = 0, resized = 0, dx = 0, dy = 0;
+            long elapsed, seek = 0;
+
+            /* Ascolto e gestione di tutti i tasti in attesa. */
+            while (!action && !resized && (key = wgetch(body)) != ERR) {
+                pending = 1;
+
+                /* Nella modalità di revisione, i tasti delle azioni di gioco
+                 * vengono ignorati.
+                 */
+                if (mode == UI_REPLAY) {
+                    switch (key) {
+                        case ',':
+                            seek--;
+                            key = ERR;
+                        break;
+                        case '.':
+                            seek++;
+                            key = ERR;
+                        break;
+                        case KEY_PPAGE:
+                            seek -= UI_SEEK_PAGE;
+                            key = ERR;
+                        break;
+                        case KEY_NPAGE:
+                            seek += UI_SEEK_PAGE;
+                            key = ERR;
+                        break;
+                        case KEY_HOME:
+                            seek = -(LONG_MAX / 2);
+                            key = ERR;
+                        break;
+                        case KEY_END:
+                            seek = LONG_MAX / 2;
+                            key = ERR;
+                        break;
+                        case 'r':
+                        case 'R':
+                        case '\n':
+                            action = ACTION_REPLAY;
+                            key = ERR;
+                        break;
+                        case KEY_LEFT:
+                        case KEY_RIGHT:
+                        case KEY_UP:
+                        case KEY_DOWN:
+                        case KEY_RESIZE:
+                        break;
+                        default:
+                            key = ERR;
+                    }
+                } else if (mode == UI_WATCH) {
+                    /* Nella visione di una partita altrui, solo l'uscita. */
+                    if (key == 'q' || key == 'Q')
+                        action = ACTION_QUIT;
+                    if (key != KEY_RESIZE)
+                        key = ERR;
+                } else if (mode == UI_REVEAL) {
+                    /* Durante l'apertura, solo gli spostamenti e la pausa. */
+                    if (key == '\n') {
+                        paused = !paused;
+                        key = ERR;
+                    } else if (key != KEY_LEFT && key != KEY_RIGHT && key != KEY_UP && key != KEY_DOWN &&
+                               key != KEY_RESIZE)
+                        key = ERR;
+                }
 
                 switch (key) {
                     case KEY_LEFT:
-                        if (*x > 0) {
-                            (*x)--;
-                            refresh = 1;
-                        }
+                        dx--;
                     break;
                     case KEY_RIGHT:
-                        if (*x < field->width - 1) {
-                            (*x)++;
-                            refresh = 1;
-                        }
+                        dx++;
                     break;
                     case KEY_UP:
-                        if (*y > 0) {
-                            (*y)--;
-                            refresh = 1;
-                        }
+                        dy--;
                     break;
                     case KEY_DOWN:
-                        if (*y < field->height - 1) {
-                            (*y)++;
-                            refresh = 1;
-                        }
+                        dy++;
                     break;
                     case 'q':
                     case 'Q':
@@ -444,14 +702,116 @@ int ui_minesweeper(msw_field field, int *x, int *y, int draw_only) {
                     case 'W':
                         action = ACTION_MARK;
                     break;
+                    case 'e':
+                    case 'E':
+                        action = ACTION_CHORD;
+                    break;
                     case '\n':
                         action = ACTION_PAUSE;
+                    break;
+                    case 'h':
+                    case 'H':
+                        action = ACTION_HINT;
+                    break;
+                    case 'r':
+                    case 'R':
+                        action = ACTION_REPLAY;
+                    break;
+                    case KEY_RESIZE:
+                        resized = 1;
+                }
+            }
+
+            /* Gli spostamenti tra le mosse accumulati vengono restituiti con
+             * un'unica azione.
+             */
+            if (!action && seek != 0) {
+                ui_seek = seek;
+                action = ACTION_SEEK;
+            }
+
+            /* Applicazione degli spostamenti accumulati, entro i limiti del
+             * campo.
+             */
+            if (dx != 0 || dy != 0) {
+                int nx = *x + dx, ny = *y + dy;
+
+                nx = (nx < 0 ? 0 : (nx > field->width - 1 ? field->width - 1 : nx));
+                ny = (ny < 0 ? 0 : (ny > field->height - 1 ? field->height - 1 : ny));
+
+                if (nx != *x || ny != *y) {
+                    *x = nx;
+                    *y = ny;
+                    dirty = 1;
+                }
+            }
+
+            if (resized) {
+                if (head)
+                    delwin(head);
+                delwin(body);
+                head = NULL;
+                body = NULL;
+
+                clear();
+                refresh();
+            } else if (!pending) {
+                /* Attesa di input fino al prossimo disegno o al prossimo secondo
+                 * dell'orologio.
+                 */
+                struct pollfd fds;
+                long timeout = 1000 - ui_play_ms % 1000;
+
+                if (mode == UI_WATCH)
+                    timeout = UI_FRAME_MS;
+                if (mode == UI_REVEAL && !paused)
+                    timeout = 0;
+                if (dirty && UI_FRAME_MS - (now - last_frame) < timeout)
+                    timeout = UI_FRAME_MS - (now - last_frame);
+
+                fds.fd = STDIN_FILENO;
+                fds.events = POLLIN;
+                poll(&fds, 1, (int) (timeout > 0 ? timeout : 0));
+            }
+
+            /* Avanzamento dell'orologio di gioco, fermo durante la revisione e
+             * mentre l'apertura è sospesa.
+             */
+            elapsed = ui_now() - now;
+            if (mode == UI_PLAY || (mode == UI_REVEAL && !paused))
+                ui_play_ms += elapsed;
+            now += elapsed;
+
+            if (mode == UI_PLAY && ui_idle)
+                ui_idle();
+
+            /* Nella visione di una partita altrui, aggiornamento del campo. */
+            if (mode == UI_WATCH && !action) {
+                int update = ui_watch_update(field, x, y);
+
+                if (update < 0)
+                    action = -1;
+                else if (update > 0)
+                    dirty = 1;
+            }
+
+            /* Nell'apertura, prosecuzione fino al prossimo disegno. */
+            if (mode == UI_REVEAL && !action && !paused) {
+                long update = ui_reveal_update(field);
+
+                if (update < 0)
+                    action = -1;
+                else if (update != progress) {
+                    progress = update;
+                    dirty = 1;
                 }
-            } while (!action && !refresh);
-        else
+            }
+        } else
             action = -1;
     } while (!action);
 
+    if (head)
+        delwin(head);
     delwin(body);
 
     return action;